@@ -0,0 +1,29 @@
+# Turns a SPIR-V binary into a header holding it as a uint32_t array, so the
+# shaders are linked into the executable instead of read from the working
+# directory. Run in script mode:
+#   cmake -DINPUT=text_vert.spv -DOUTPUT=text_vert.h -DSYMBOL=text_vert_spv -P embed_spirv.cmake
+
+file(READ ${INPUT} SPIRV_HEX HEX)
+string(LENGTH "${SPIRV_HEX}" SPIRV_HEX_LENGTH)
+math(EXPR SPIRV_WORD_REMAINDER "${SPIRV_HEX_LENGTH} % 8")
+if(SPIRV_HEX_LENGTH EQUAL 0 OR NOT SPIRV_WORD_REMAINDER EQUAL 0)
+    message(FATAL_ERROR "${INPUT} is not a SPIR-V module")
+endif()
+
+# SPIR-V is a stream of little-endian words; swap each group of four bytes into a literal
+string(REGEX REPLACE "([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])"
+       "0x\\4\\3\\2\\1," SPIRV_WORDS "${SPIRV_HEX}")
+string(REGEX REPLACE "(0x[0-9a-f]+,0x[0-9a-f]+,0x[0-9a-f]+,0x[0-9a-f]+,0x[0-9a-f]+,0x[0-9a-f]+,0x[0-9a-f]+,0x[0-9a-f]+,)"
+       "\\1\n    " SPIRV_WORDS "${SPIRV_WORDS}")
+
+get_filename_component(SPIRV_NAME ${INPUT} NAME)
+file(WRITE ${OUTPUT}
+"// Generated from ${SPIRV_NAME} by cmake/embed_spirv.cmake; do not edit
+#pragma once
+
+#include <cstdint>
+
+static const uint32_t ${SYMBOL}[] = {
+    ${SPIRV_WORDS}
+};
+")
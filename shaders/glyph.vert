@@ -0,0 +1,40 @@
+#version 450
+
+// One instance per glyph; see GlyphInstance
+layout(location = 0) in ivec2 inPen;
+layout(location = 1) in uvec2 inSlotFlags;
+layout(location = 2) in vec4 inColor;
+
+layout(location = 0) out vec2 fragTexCoord;
+layout(location = 1) out vec4 fragColor;
+
+// Atlas rectangle and quad offset and size relative to the pen, per slot; see GlyphSlot
+struct GlyphSlot {
+    vec4 texCoords;
+    vec4 rect;
+};
+
+layout(std430, set = 1, binding = 0) readonly buffer GlyphSlots {
+    GlyphSlot slots[];
+};
+
+layout(push_constant) uniform PushConstants {
+    vec2 screenSize;
+} push;
+
+// Same corners as the CPU-built quads: top-left, top-right, bottom-left; top-right, bottom-right, bottom-left
+const vec2 CORNERS[6] = vec2[](vec2(0.0, 0.0), vec2(1.0, 0.0), vec2(0.0, 1.0),
+                               vec2(1.0, 0.0), vec2(1.0, 1.0), vec2(0.0, 1.0));
+
+void main() {
+    GlyphSlot slot = slots[inSlotFlags.x];
+    vec2 corner = CORNERS[gl_VertexIndex];
+    vec2 position = vec2(inPen) + slot.rect.xy + corner * slot.rect.zw;
+    
+    vec2 ndc;
+    ndc.x = (position.x / push.screenSize.x) * 2.0 - 1.0;
+    ndc.y = (position.y / push.screenSize.y) * 2.0 - 1.0; // y down, like the viewport, scissors and damage
+    gl_Position = vec4(ndc, 0.0, 1.0);
+    fragTexCoord = mix(slot.texCoords.xy, slot.texCoords.zw, corner);
+    fragColor = inColor;
+}
@@ -0,0 +1,62 @@
+#version 450
+
+layout(location = 0) in vec2 fragTexCoord;
+layout(location = 1) flat in uint fragGrid;
+
+layout(location = 0) out vec4 outColor;
+
+layout(set = 0, binding = 0) uniform sampler2D gridSampler;
+
+// Mirrors GridState in vulkan_renderer.hpp
+struct GridState {
+    vec4 cells;      // Cell width, height, origin x, y
+    ivec4 selection; // Start column, row, end column, row; end excluded
+    ivec4 match;     // Column, row, length in cells, cursor shape
+    ivec2 cursor;
+    float cursorAlpha;
+    float padding;
+};
+
+layout(std430, set = 1, binding = 1) readonly buffer GridStates {
+    GridState grids[];
+};
+
+const int CURSOR_BLOCK = 0;
+const int CURSOR_UNDERLINE = 1;
+const int CURSOR_BAR = 2;
+const float CURSOR_THICKNESS = 2.0;
+const vec3 MATCH_COLOR = vec3(1.0, 1.0, 0.0);
+
+// Reading order: rows first, then columns
+bool before(ivec2 a, ivec2 b) {
+    return a.y < b.y || (a.y == b.y && a.x < b.x);
+}
+
+// Cursor and highlights are worked out per pixel, so moving them only takes a new state
+void main() {
+    GridState grid = grids[fragGrid];
+    vec3 color = texture(gridSampler, fragTexCoord).rgb;
+    
+    // gl_FragCoord and the origin are both framebuffer pixels, y down
+    vec2 local = gl_FragCoord.xy - grid.cells.zw;
+    ivec2 cell = ivec2(floor(local / grid.cells.xy));
+    vec2 inCell = local - vec2(cell) * grid.cells.xy;
+    
+    if (!before(cell, grid.selection.xy) && before(cell, grid.selection.zw)) {
+        color = vec3(1.0) - color;
+    }
+    if (cell.y == grid.match.y && cell.x >= grid.match.x && cell.x < grid.match.x + grid.match.z) {
+        color = mix(color, MATCH_COLOR, 0.5);
+    }
+    
+    if (cell == grid.cursor && grid.cursorAlpha > 0.0) {
+        if (grid.match.w == CURSOR_BLOCK) {
+            color = mix(color, vec3(1.0) - color, grid.cursorAlpha);
+        } else if ((grid.match.w == CURSOR_UNDERLINE && inCell.y >= grid.cells.y - CURSOR_THICKNESS) ||
+                   (grid.match.w == CURSOR_BAR && inCell.x < CURSOR_THICKNESS)) {
+            color = mix(color, vec3(1.0), grid.cursorAlpha);
+        }
+    }
+    
+    outColor = vec4(color, 1.0);
+}
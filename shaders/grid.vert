@@ -0,0 +1,22 @@
+#version 450
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec2 inTexCoord;
+layout(location = 2) in uint inGrid;
+
+layout(location = 0) out vec2 fragTexCoord;
+layout(location = 1) flat out uint fragGrid;
+
+layout(push_constant) uniform PushConstants {
+    vec2 screenSize;
+} push;
+
+// Pane images, highlighted by grid.frag from the grid state they index
+void main() {
+    vec2 ndc;
+    ndc.x = (inPosition.x / push.screenSize.x) * 2.0 - 1.0;
+    ndc.y = (inPosition.y / push.screenSize.y) * 2.0 - 1.0; // y down, like the viewport, scissors and damage
+    gl_Position = vec4(ndc, 0.0, 1.0);
+    fragTexCoord = inTexCoord;
+    fragGrid = inGrid;
+}
@@ -0,0 +1,19 @@
+#version 450
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec2 inTexCoord;
+
+layout(location = 0) out vec2 fragTexCoord;
+
+layout(push_constant) uniform PushConstants {
+    vec2 screenSize;
+} push;
+
+// Opaque images (background images, pane and row images) drawn with background.frag
+void main() {
+    vec2 ndc;
+    ndc.x = (inPosition.x / push.screenSize.x) * 2.0 - 1.0;
+    ndc.y = (inPosition.y / push.screenSize.y) * 2.0 - 1.0; // y down, like the viewport, scissors and damage
+    gl_Position = vec4(ndc, 0.0, 1.0);
+    fragTexCoord = inTexCoord;
+}
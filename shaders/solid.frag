@@ -0,0 +1,10 @@
+#version 450
+
+layout(location = 0) in vec4 fragColor;
+
+layout(location = 0) out vec4 outColor;
+
+// Rectangles of one color: cursor, selection, menus; nothing to sample
+void main() {
+    outColor = fragColor;
+}
@@ -0,0 +1,18 @@
+#version 450
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec4 inColor;
+
+layout(location = 0) out vec4 fragColor;
+
+layout(push_constant) uniform PushConstants {
+    vec2 screenSize;
+} push;
+
+void main() {
+    vec2 ndc;
+    ndc.x = (inPosition.x / push.screenSize.x) * 2.0 - 1.0;
+    ndc.y = (inPosition.y / push.screenSize.y) * 2.0 - 1.0; // y down, like the viewport, scissors and damage
+    gl_Position = vec4(ndc, 0.0, 1.0);
+    fragColor = inColor;
+}
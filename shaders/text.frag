@@ -7,8 +7,21 @@ layout(location = 0) out vec4 outColor;
 
 layout(binding = 0) uniform sampler2D texSampler;
 
+// One pipeline per mode: 0 = coverage, 1 = signed distance field, 2 = color glyph
+layout(constant_id = 0) const uint SAMPLE_MODE = 0;
+
 void main() {
     vec4 texColor = texture(texSampler, fragTexCoord);
-    outColor = texColor * fragColor;
+    if (SAMPLE_MODE == 1u) {
+        // Distance lives in alpha with the outline at 0.5; fwidth keeps the edge about a pixel wide at any scale
+        float dist = texColor.a;
+        float edge = max(fwidth(dist) * 0.5, 1e-4);
+        texColor = vec4(1.0, 1.0, 1.0, smoothstep(0.5 - edge, 0.5 + edge, dist));
+    }
+    if (SAMPLE_MODE == 2u) {
+        // Color glyphs carry their own colors; only the alpha applies
+        outColor = vec4(texColor.rgb, texColor.a * fragColor.a);
+    } else {
+        outColor = texColor * fragColor;
+    }
 }
-
@@ -16,7 +16,7 @@ void main() {
     // Convert from pixel coordinates to normalized device coordinates
     vec2 ndc;
     ndc.x = (inPosition.x / push.screenSize.x) * 2.0 - 1.0;
-    ndc.y = 1.0 - (inPosition.y / push.screenSize.y) * 2.0; // Flip Y axis
+    ndc.y = (inPosition.y / push.screenSize.y) * 2.0 - 1.0; // y down, like the viewport, scissors and damage
     gl_Position = vec4(ndc, 0.0, 1.0);
     fragTexCoord = inTexCoord;
     fragColor = inColor;
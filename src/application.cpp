@@ -7,7 +7,13 @@
 #include <iostream>
 #include <cstdlib>
 #include <climits>
+#include <cmath>
 #include <algorithm> // Required for std::min, std::max, std::swap
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <poll.h>
+#include <unistd.h>
 
 namespace {
     std::string codepointToUtf8(unsigned int codepoint) {
@@ -55,6 +61,17 @@ namespace {
             return byteToCol[byteOffset];
         }
     };
+    
+    // Cells a UTF-8 string takes, one per codepoint
+    int countCodepoints(const std::string& text) {
+        int count = 0;
+        for (unsigned char byte : text) {
+            if ((byte & 0xC0) != 0x80) {
+                ++count;
+            }
+        }
+        return count;
+    }
 }
 
 Application::Application() : window_(nullptr), isTiled_(false), scrollOffset_(0), 
@@ -77,17 +94,7 @@ bool Application::init() {
 
     try {
         // Initialize settings FIRST (needed by initVulkan)
-        settings_ = std::make_unique<Settings>();
-        const char* homeDir = getenv("HOME");
-        std::string configPath;
-        if (homeDir) {
-            configPath = std::string(homeDir) + "/.hyperterm/config";
-        } else {
-            std::cerr << "Warning: HOME environment variable not set. Using current directory for config." << std::endl;
-            configPath = "./.hyperterm/config";
-        }
-        settings_->load(configPath);
-
+        loadSettings();
         initGraphics();
         initSubsystems();
     } catch (const std::exception& e) {
@@ -105,6 +112,61 @@ bool Application::init() {
     return true;
 }
 
+bool Application::initHeadless(uint32_t width, uint32_t height) {
+    try {
+        loadSettings();
+        renderer_ = std::make_unique<VulkanRenderer>(width, height);
+        applyRenderSettings();
+        renderer_->init();
+        initFonts();
+        initSubsystems();
+    } catch (const std::exception& e) {
+        std::cerr << "Initialization error: " << e.what() << std::endl;
+        cleanup();
+        return false;
+    }
+    return true;
+}
+
+void Application::loadSettings() {
+    settings_ = std::make_unique<Settings>();
+    const char* homeDir = getenv("HOME");
+    std::string configPath;
+    if (homeDir) {
+        configPath = std::string(homeDir) + "/.hyperterm/config";
+    } else {
+        std::cerr << "Warning: HOME environment variable not set. Using current directory for config." << std::endl;
+        configPath = "./.hyperterm/config";
+    }
+    settings_->load(configPath);
+    applyCursorSettings();
+}
+
+void Application::applyRenderSettings() {
+    renderer_->setFramesInFlight(settings_->getFramesInFlight());
+    VkPresentModeKHR presentMode;
+    if (VulkanRenderer::parsePresentMode(settings_->getPresentMode(), presentMode)) {
+        renderer_->setPresentMode(presentMode);
+    } else {
+        std::cerr << "Warning: Unknown render.present_mode: " << settings_->getPresentMode() << std::endl;
+    }
+}
+
+void Application::applyCursorSettings() {
+    std::string shape = settings_->getCursorShape();
+    if (shape == "block") {
+        cursorShape_ = CursorShape::Block;
+    } else if (shape == "bar") {
+        cursorShape_ = CursorShape::Bar;
+    } else {
+        if (shape != "underline") {
+            std::cerr << "Warning: Unknown cursor.shape: " << shape << std::endl;
+        }
+        cursorShape_ = CursorShape::Underline;
+    }
+    cursorBlinkInterval_ = std::max(0.0f, settings_->getCursorBlinkInterval()) / 1000.0;
+}
+
 void Application::initGraphics() {
     initWindow();
     initVulkan();
@@ -115,10 +177,21 @@ void Application::initSubsystems() {
     // Settings already initialized in init() before graphics
     std::cout << "DEBUG: Creating PaneManager..." << std::endl;
     paneManager_ = std::make_unique<PaneManager>(this, renderer_.get(), settings_.get()); // Changed to pass 'this'
+    renderer_->onSwapChainRecreated = [this]() {
+        // Pane images and strips rendered in frames skipped around the recreation may never have been drawn
+        if (paneManager_) {
+            paneManager_->invalidatePanes();
+            paneManager_->clearRowCaches();
+            fitBackgroundImages();
+        }
+    };
     std::cout << "DEBUG: Creating MenuBar..." << std::endl;
     menuBar_ = std::make_unique<MenuBar>();
     std::cout << "DEBUG: Creating WindowTiler..." << std::endl;
     windowTiler_ = std::make_unique<WindowTiler>();
+    perfHud_ = std::make_unique<PerfHud>();
+    perfHud_->setRenderer(renderer_.get());
+    perfHud_->setFontRenderer(fontRenderer_.get());
     std::cout << "DEBUG: Creating SettingsUI..." << std::endl;
     settingsUI_ = std::make_unique<SettingsUI>(settings_.get());
 
@@ -167,10 +240,15 @@ void Application::initWindow() {
 void Application::initVulkan() {
     std::cout << "DEBUG: Creating VulkanRenderer..." << std::endl;
     renderer_ = std::make_unique<VulkanRenderer>(window_);
+    applyRenderSettings();
     std::cout << "DEBUG: Initializing Vulkan..." << std::endl;
     renderer_->init();
     std::cout << "DEBUG: Vulkan initialized" << std::endl;
+    initFonts();
+    std::cout << "DEBUG: initVulkan complete" << std::endl;
+}
 
+void Application::initFonts() {
     std::cout << "DEBUG: Creating FontRenderer..." << std::endl;
     fontRenderer_ = std::make_unique<FontRenderer>(
         renderer_->getDevice(),
@@ -186,18 +264,186 @@ void Application::initVulkan() {
     std::cout << "DEBUG: Font path: " << fontPath << std::endl;
     if (!fontPath.empty()) {
         std::cout << "DEBUG: Loading font..." << std::endl;
+        fontRenderer_->setFallbackFonts(settings_->getFontFallbacks());
+        if (settings_->getFontRenderMode() == "sdf") {
+            fontRenderer_->setRenderMode(GlyphRenderMode::DistanceField);
+        }
         if (!fontRenderer_->loadFont(fontPath, settings_->getFontSize())) {
             std::cerr << "Warning: Failed to load font: " << fontPath << std::endl;
         }
         std::cout << "DEBUG: Font loaded" << std::endl;
     }
-    std::cout << "DEBUG: initVulkan complete" << std::endl;
 }
 
 void Application::run() {
     mainLoop();
 }
 
+double Application::drawHeadlessFrame(TerminalSession& session) {
+    renderer_->beginFrame();
+    fontRenderer_->beginFrame();
+    renderer_->damageAll();
+    auto drawStart = std::chrono::steady_clock::now();
+    drawTerminalContent(&session, 0.0f, 0.0f, static_cast<float>(renderer_->getWidth()), static_cast<float>(renderer_->getHeight()));
+    double drawTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - drawStart).count();
+    renderer_->endFrame();
+    return drawTime;
+}
+
+int Application::runLatencyTest(int iterations) {
+    TerminalSession session(24, 80, renderer_.get(), &settings_->getCurrentColorScheme());
+    if (!session.startShell()) {
+        std::cerr << "Failed to start shell for the latency test" << std::endl;
+        return EXIT_FAILURE;
+    }
+    
+    // Feed whatever the shell printed within timeoutMs; true if anything came
+    auto pump = [&](int timeoutMs) {
+        pollfd pfd{session.getMasterFd(), POLLIN, 0};
+        bool received = false;
+        while (poll(&pfd, 1, received ? 0 : timeoutMs) > 0 && (pfd.revents & POLLIN)) {
+            char buffer[REPLAY_CHUNK];
+            ssize_t bytesRead = read(session.getMasterFd(), buffer, sizeof(buffer));
+            if (bytesRead <= 0) break;
+            session.processOutput(std::string(buffer, bytesRead));
+            received = true;
+        }
+        return received;
+    };
+    auto onScreen = [&](const std::string& marker) {
+        for (const auto& row : session.getCells()) {
+            std::string text;
+            for (const Cell& cell : row) {
+                text.push_back(cell.character < 0x80 ? static_cast<char>(cell.character) : '?');
+            }
+            if (text.find(marker) != std::string::npos) return true;
+        }
+        return false;
+    };
+    
+    // Let the shell start and print its prompt
+    for (int i = 0; i < 50 && !pump(20); ++i) {
+    }
+    while (pump(50)) {
+    }
+    drawHeadlessFrame(session);
+    
+    // Each round: a command goes in, its output is parsed, drawn and the GPU
+    // finishes the frame. The typed command is echoed too, so the marker is
+    // assembled by printf and only appears in the output.
+    RollingStats latency(static_cast<size_t>(iterations));
+    int missed = 0;
+    for (int i = 0; i < iterations; ++i) {
+        std::string marker = "[lat" + std::to_string(i) + "]";
+        auto start = std::chrono::steady_clock::now();
+        session.writeInput("printf '%s%s\\n' '[lat' '" + std::to_string(i) + "]'\n");
+        bool shown = false;
+        while (!shown && std::chrono::steady_clock::now() - start < std::chrono::seconds(2)) {
+            if (pump(1)) {
+                shown = onScreen(marker);
+                drawHeadlessFrame(session);
+            }
+        }
+        if (!shown) {
+            missed++;
+            continue;
+        }
+        vkDeviceWaitIdle(renderer_->getDevice());
+        latency.add(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        while (pump(5)) { // The next prompt
+        }
+    }
+    session.stopShell();
+    
+    std::cout << "Echo latency over " << latency.getCount() << " rounds (" << missed << " timed out), input to frame complete: min "
+              << latency.getMin() << " ms, avg " << latency.getAverage() << " ms, p99 " << latency.getP99() << " ms" << std::endl;
+    return missed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int Application::runBenchmark(const std::string& replayPath, const std::string& capturePath) {
+    std::ifstream file(replayPath, std::ios::binary);
+    if (!file) {
+        std::cerr << "Failed to open replay: " << replayPath << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::string replay((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    
+    TerminalSession session(24, 80, renderer_.get(), &settings_->getCurrentColorScheme());
+    
+    using Clock = std::chrono::steady_clock;
+    auto millisecondsSince = [](Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    };
+    auto drawOnce = [&]() { return drawHeadlessFrame(session); };
+    
+    // One chunk per frame, as the main loop sees a busy PTY
+    std::vector<double> drawTimes;
+    std::vector<double> frameTimes;
+    for (size_t offset = 0; offset < replay.size(); offset += REPLAY_CHUNK) {
+        session.processOutput(replay.substr(offset, REPLAY_CHUNK));
+        auto frameStart = Clock::now();
+        drawTimes.push_back(drawOnce());
+        frameTimes.push_back(millisecondsSince(frameStart));
+    }
+    
+    // Let glyphs still being rasterized land before the final frame is captured
+    for (int i = 0; i < 60 && fontRenderer_->hasPendingGlyphs(); ++i) {
+        drawOnce();
+    }
+    if (!capturePath.empty()) {
+        renderer_->requestCapture();
+        drawOnce();
+        std::vector<uint8_t> pixels;
+        if (renderer_->readCapture(pixels)) {
+            std::ofstream out(capturePath, std::ios::binary);
+            out << "P6\n" << renderer_->getWidth() << " " << renderer_->getHeight() << "\n255\n";
+            for (size_t i = 0; i < pixels.size(); i += 4) {
+                out.write(reinterpret_cast<const char*>(&pixels[i]), 3);
+            }
+            if (!out) {
+                std::cerr << "Warning: Failed to write capture: " << capturePath << std::endl;
+            }
+        }
+    }
+    vkDeviceWaitIdle(renderer_->getDevice());
+    
+    auto report = [](const char* name, std::vector<double>& times) {
+        if (times.empty()) {
+            return;
+        }
+        std::sort(times.begin(), times.end());
+        double total = 0.0;
+        for (double time : times) {
+            total += time;
+        }
+        std::cout << name << ": mean " << total / times.size() << " ms, p50 " << times[times.size() / 2]
+                  << " ms, p99 " << times[std::min(times.size() - 1, times.size() * 99 / 100)]
+                  << " ms, max " << times.back() << " ms" << std::endl;
+    };
+    std::cout << "Replayed " << replay.size() << " bytes in " << frameTimes.size() << " frames at "
+              << renderer_->getWidth() << "x" << renderer_->getHeight() << std::endl;
+    report("drawTerminalContent", drawTimes);
+    report("frame", frameTimes);
+    std::cout << "First frame " << renderer_->getFirstFrameTime() << " ms after start (pipeline cache "
+              << (renderer_->isPipelineCacheWarm() ? "warm" : "cold") << ")" << std::endl;
+    renderer_->dumpMemoryStats(std::cout);
+    if (renderer_->hasGpuTimings()) {
+        // Only the most recent frames, as kept by the renderer
+        for (size_t i = 0; i < static_cast<size_t>(RenderPhase::Count); ++i) {
+            RenderPhase phase = static_cast<RenderPhase>(i);
+            const RollingStats& stats = renderer_->getPhaseStats(phase);
+            if (!stats.empty()) {
+                std::cout << "GPU " << VulkanRenderer::getRenderPhaseName(phase) << ": min " << stats.getMin() << " ms, avg "
+                          << stats.getAverage() << " ms, p99 " << stats.getP99() << " ms" << std::endl;
+            }
+        }
+        const RollingStats& gpuFrame = renderer_->getGpuFrameStats();
+        std::cout << "GPU frame: min " << gpuFrame.getMin() << " ms, avg " << gpuFrame.getAverage() << " ms, p99 "
+                  << gpuFrame.getP99() << " ms" << std::endl;
+    }
+    return EXIT_SUCCESS;
+}
+
 void Application::mainLoop() {
     std::cout << "DEBUG: Starting main loop" << std::endl;
     int frame = 0;
@@ -208,8 +454,18 @@ void Application::mainLoop() {
         handleInput();
         if (frame == 0) std::cout << "DEBUG: update..." << std::endl;
         paneManager_->update();
+        if (settings_->getLateLatch() && isFrameDue()) {
+            // Hold the frame until just before vblank; output and input arriving meanwhile join it
+            waitForLatch();
+            glfwPollEvents();
+            handleInput();
+            paneManager_->update();
+        }
         if (frame == 0) std::cout << "DEBUG: drawFrame..." << std::endl;
-        drawFrame();
+        if (!drawFrame()) {
+            // Nothing changed; sleep until input arrives or the PTYs are due another poll
+            glfwWaitEventsTimeout(IDLE_POLL_INTERVAL);
+        }
         if (frame == 0) std::cout << "DEBUG: Frame 0 complete" << std::endl;
         frame++;
     }
@@ -219,28 +475,166 @@ void Application::mainLoop() {
     std::cout << "DEBUG: Device idle" << std::endl;
 }
 
-void Application::drawFrame() {
-    renderer_->beginFrame();
+bool Application::isFrameDue() const {
+    return renderer_->hasDamage() || paneManager_->hasDirtySessions() || fontRenderer_->hasPendingGlyphs() ||
+           scrollPosition_ != static_cast<float>(scrollOffset_) || !(captureUiState() == drawnUiState_);
+}
+
+void Application::waitForLatch() {
+    double refreshPeriod, lastVblank;
+    if (renderer_->getDisplayTiming(refreshPeriod, lastVblank)) {
+        framePacer_.setRefreshPeriod(refreshPeriod);
+        framePacer_.setVblank(lastVblank);
+    }
+    framePacer_.setMargin(settings_->getLatchMargin() / 1000.0);
+    
+    auto seconds = []() {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    };
+    double latch = framePacer_.getLatchTime(seconds());
+    for (double now = seconds(); now < latch; now = seconds()) {
+        glfwWaitEventsTimeout(latch - now);
+    }
+}
+
+bool Application::drawFrame() {
+    if (renderer_->getImageCache().update()) {
+        // Sessions waiting on these images drew without them
+        renderer_->damageAll();
+        paneManager_->invalidatePanes();
+        fitBackgroundImages();
+    }
+    
+    // Scrolling and zooming re-render every pane; the search bar only needs
+    // recompositing, and the settings dialog only its own rect
+    advanceScroll();
+    UiState uiState = captureUiState();
+    if (!(uiState == drawnUiState_)) {
+        if (uiState.changesOnlySettings(drawnUiState_)) {
+            float dialogX, dialogY, dialogWidth, dialogHeight;
+            settingsUI_->getBounds(static_cast<float>(uiState.width), static_cast<float>(uiState.height),
+                                   dialogX, dialogY, dialogWidth, dialogHeight);
+            renderer_->addDamage(dialogX, dialogY, dialogWidth, dialogHeight);
+        } else {
+            renderer_->damageAll();
+            if (uiState.changesPanes(drawnUiState_)) {
+                paneManager_->invalidatePanes();
+            }
+        }
+    }
+    // Selection, search match and cursor blink only damage the cells they cover
+    paneManager_->updateHighlights();
+    if (perfHud_->isVisible()) {
+        samplePerfHud();
+    }
+    if (!renderer_->hasDamage() && !paneManager_->hasDirtySessions() && !fontRenderer_->hasPendingGlyphs()) {
+        return false;
+    }
+    
+    if (!renderer_->beginFrame()) {
+        // The swap chain was out of date; draw again right away on the new one, so
+        // nothing is taken from the sessions or caches for a frame that is thrown away
+        return true;
+    }
+    double cpuStart = glfwGetTime(); // After the wait for a free frame, which is GPU time
+    // Text drawn with placeholders for missing glyphs is drawn again by itself
+    fontRenderer_->beginFrame();
 
     // Render menu bar
     float width = static_cast<float>(renderer_->getWidth());
     float height = static_cast<float>(renderer_->getHeight());
+    renderer_->setRenderPhase(RenderPhase::MenuBar);
     menuBar_->render(width, height);
 
     // Render panes using PaneManager
+    renderer_->setRenderPhase(RenderPhase::PaneContent);
     paneManager_->render(0.0f, MENU_BAR_HEIGHT, width, height - MENU_BAR_HEIGHT);
 
     // Render settings UI if visible
     if (settingsUI_->isVisible()) {
+        renderer_->setRenderPhase(RenderPhase::Settings);
         settingsUI_->render(width, height);
     }
 
     // Render search UI if active
     if (isSearching_) {
+        renderer_->setRenderPhase(RenderPhase::SearchBar);
         renderSearchUI(width, height);
     }
 
+    // Drawn over everything, so it is redrawn whole whenever anything under it changes
+    if (perfHud_->isVisible()) {
+        float hudX, hudY, hudWidth, hudHeight;
+        perfHud_->getBounds(width, hudX, hudY, hudWidth, hudHeight);
+        renderer_->addDamage(hudX, hudY, hudWidth, hudHeight);
+        renderer_->setRenderPhase(RenderPhase::Hud);
+        perfHud_->render(width, height);
+    }
+
     renderer_->endFrame();
+    
+    double now = glfwGetTime();
+    perfHud_->recordFrame((now - lastDrawnTime_) * 1000.0, (now - cpuStart) * 1000.0);
+    lastDrawnTime_ = now;
+    
+    drawnUiState_ = captureUiState(); // After drawing, which may clamp the scroll offset
+    return true;
+}
+
+Application::UiState Application::captureUiState() const {
+    UiState state;
+    state.width = renderer_->getWidth();
+    state.height = renderer_->getHeight();
+    state.fontSize = fontRenderer_->getFontSize();
+    state.scrollOffset = scrollOffset_;
+    state.scrollPosition = scrollPosition_;
+    state.settingsVisible = settingsUI_->isVisible();
+    state.settingsKey = state.settingsVisible ? settingsUI_->getContentKey() : std::string();
+    state.searching = isSearching_;
+    state.searchQuery = searchQuery_;
+    state.searchResultIndex = currentSearchResultIndex_;
+    state.searchResultCount = searchResultCoords_.size();
+    return state;
+}
+
+void Application::fitBackgroundImages() {
+    // Images are decoded for the window size at the time; a larger window needs a larger copy
+    uint32_t width = renderer_->getWidth();
+    uint32_t height = renderer_->getHeight();
+    paneManager_->forEachSession([&](const Pane& pane) {
+        pane.session->fitBackgroundImage(width, height);
+    });
+}
+
+void Application::samplePerfHud() {
+    std::vector<std::pair<int, const TerminalSession*>> sessions;
+    paneManager_->forEachSession([&](const Pane& pane) {
+        sessions.emplace_back(pane.id, pane.session.get());
+    });
+    
+    // New figures need a redraw; the panel may have grown or shrunk, so its old area is damaged too
+    float width = static_cast<float>(renderer_->getWidth());
+    float x, y, w, h;
+    perfHud_->getBounds(width, x, y, w, h);
+    if (perfHud_->sample(glfwGetTime(), sessions)) {
+        renderer_->addDamage(x, y, w, h);
+        perfHud_->getBounds(width, x, y, w, h);
+        renderer_->addDamage(x, y, w, h);
+    }
+}
+
+void Application::advanceScroll() {
+    double now = glfwGetTime();
+    float elapsed = static_cast<float>(std::min(now - lastFrameTime_, 0.1));
+    lastFrameTime_ = now;
+    
+    // Selections and search matches are placed in whole rows, so they snap the view
+    float target = static_cast<float>(scrollOffset_);
+    if (isSelecting_ || isSearching_ || std::fabs(target - scrollPosition_) < SCROLL_SNAP) {
+        scrollPosition_ = target;
+        return;
+    }
+    scrollPosition_ += (target - scrollPosition_) * (1.0f - std::exp(-elapsed * SCROLL_SMOOTHING));
 }
 
 void Application::renderSearchUI(float windowWidth, float windowHeight) {
@@ -250,12 +644,6 @@ void Application::renderSearchUI(float windowWidth, float windowHeight) {
     float searchUIY = windowHeight - searchUIHeight;
     float padding = 10.0f;
 
-    // Background for search bar
-    renderer_->renderQuad(0, searchUIY, windowWidth, searchUIHeight, VK_NULL_HANDLE, 0.15f, 0.15f, 0.15f, 0.9f);
-
-    // Render search query
-    fontRenderer_->renderString(padding, searchUIY + padding, "Search: " + searchQuery_, 1.0f, 1.0f, 1.0f);
-
     // Render search results count
     std::string resultText = "";
     if (!searchResultCoords_.empty()) {
@@ -264,8 +652,20 @@ void Application::renderSearchUI(float windowWidth, float windowHeight) {
         resultText = "No results";
     }
 
-    float resultTextWidth = fontRenderer_->getTextWidth(resultText);
-    fontRenderer_->renderString(windowWidth - resultTextWidth - padding, searchUIY + padding, resultText, 1.0f, 1.0f, 1.0f);
+    // Recorded again only when the query or the result count changes
+    if (!searchBar_) {
+        searchBar_ = std::make_unique<UiLayer>(renderer_.get(), fontRenderer_.get());
+    }
+    searchBar_->draw(resultText + '\n' + searchQuery_, [&]() {
+        // Background for search bar
+        renderer_->renderQuad(0, searchUIY, windowWidth, searchUIHeight, VK_NULL_HANDLE, 0.15f, 0.15f, 0.15f, 0.9f);
+
+        // Render search query
+        fontRenderer_->renderString(padding, searchUIY + padding, "Search: " + searchQuery_, 1.0f, 1.0f, 1.0f);
+
+        float resultTextWidth = fontRenderer_->getTextWidth(resultText);
+        fontRenderer_->renderString(windowWidth - resultTextWidth - padding, searchUIY + padding, resultText, 1.0f, 1.0f, 1.0f);
+    });
 }
 
 
@@ -274,20 +674,75 @@ void Application::handleInput() {
 }
 
 // drawTerminalContent is called by PaneManager to render a specific session
-void Application::drawTerminalContent(TerminalSession* session, float x, float y, float width, float height) {
-    if (!session || !fontRenderer_) return; 
+bool Application::getCellSize(float& width, float& height) const {
+    if (!fontRenderer_) return false;
+    width = static_cast<float>(fontRenderer_->getTextWidth("M"));
+    height = static_cast<float>(fontRenderer_->getLineHeight());
+    return width > 0.0f && height > 0.0f;
+}
+
+GridState Application::getGridState(const TerminalSession* session, float width, float height, bool active) const {
+    GridState state;
+    uint32_t rows = session->getRows();
+    uint32_t cols = session->getCols();
+    if (cols == 0 || rows == 0) {
+        return state;
+    }
     
-    // Render background image if set
-    const std::string& bgImage = session->getBackgroundImage();
-    if (!bgImage.empty()) {
-        if (!isPathSafe(bgImage)) {
-            std::cerr << "Error: background image path is not safe: " << bgImage << std::endl;
-        } else {
-            VkImageView bgImageView = session->getBackgroundImage_();
-            if (bgImageView != VK_NULL_HANDLE) {
-                renderer_->renderQuad(x, y, width, height, bgImageView, 1.0f, 1.0f, 1.0f, 1.0f);
-            }
+    // The same cells and scroll shift as drawTerminalContent(), so row 0 is the first line drawn
+    state.cellWidth = width / cols;
+    state.cellHeight = height / rows;
+    int scrollbackSize = static_cast<int>(session->getScrollback().size());
+    float position = std::min(scrollPosition_, static_cast<float>(scrollbackSize));
+    float top = scrollbackSize - position;
+    int startLine = static_cast<int>(std::floor(top));
+    state.originY = -std::round((top - startLine) * state.cellHeight);
+    
+    if (active) {
+        // Selections are kept in screen rows, search matches in lines
+        SelectionCoord orderedStart = selectionStart_;
+        SelectionCoord orderedEnd = selectionEnd_;
+        if (orderedStart.row > orderedEnd.row || (orderedStart.row == orderedEnd.row && orderedStart.col > orderedEnd.col)) {
+            std::swap(orderedStart, orderedEnd);
         }
+        state.selectionStart[0] = orderedStart.col;
+        state.selectionStart[1] = orderedStart.row;
+        state.selectionEnd[0] = orderedEnd.col;
+        state.selectionEnd[1] = orderedEnd.row;
+        
+        if (isSearching_ && currentSearchResultIndex_ >= 0 && currentSearchResultIndex_ < static_cast<int>(searchResultCoords_.size())) {
+            const SelectionCoord& match = searchResultCoords_[currentSearchResultIndex_];
+            state.match[0] = match.col;
+            state.match[1] = match.row - startLine;
+            state.matchLength = countCodepoints(searchQuery_);
+        }
+    }
+    
+    // Only shown when not scrolled up; blinks off for every other interval
+    uint32_t cursorRow = session->getCursorRow();
+    uint32_t cursorCol = session->getCursorCol();
+    if (scrollOffset_ == 0 && position == 0.0f && cursorRow < rows && cursorCol < cols) {
+        state.cursor[0] = static_cast<int32_t>(cursorCol);
+        state.cursor[1] = static_cast<int32_t>(cursorRow);
+        state.cursorShape = cursorShape_;
+        bool shown = cursorBlinkInterval_ <= 0.0 ||
+                     std::fmod(glfwGetTime() - cursorBlinkStart_, cursorBlinkInterval_ * 2.0) < cursorBlinkInterval_;
+        state.cursorAlpha = shown ? 1.0f : 0.0f;
+    }
+    return state;
+}
+
+bool Application::drawTerminalContent(TerminalSession* session, float x, float y, float width, float height, RowStripCache* rowCache) {
+    if (!session || !fontRenderer_) return true;
+    uint64_t placeholders = fontRenderer_->getPlaceholderCount();
+    
+    // Render background image if set; its path was checked when the session loaded it
+    const std::string& bgImage = session->getBackgroundImage();
+    VkImageView bgImageView = session->getBackgroundImage_();
+    if (bgImageView != VK_NULL_HANDLE) {
+        renderer_->setRenderPhase(RenderPhase::Background);
+        renderer_->renderQuad(x, y, width, height, bgImageView, 1.0f, 1.0f, 1.0f, 1.0f);
+        renderer_->setRenderPhase(RenderPhase::PaneContent);
     }
     
     // --- Rendering with Scrollback and Selection ---
@@ -297,12 +752,13 @@ void Application::drawTerminalContent(TerminalSession* session, float x, float y
     // Guard against division by zero
     if (cols == 0 || rows == 0) {
         std::cerr << "Warning: Invalid terminal dimensions (rows=" << rows << ", cols=" << cols << ")" << std::endl;
-        return;
+        return true;
     }
 
     float cellWidth = width / cols;
     float cellHeight = height / rows;
     
+    
     const auto& scrollback = session->getScrollback();
     const auto& cells = session->getCells();
     
@@ -313,21 +769,39 @@ void Application::drawTerminalContent(TerminalSession* session, float x, float y
         scrollOffset_ = scrollbackSize;
     }
     
-    // Calculate the starting line in the combined buffer
-    int startLine = scrollbackSize - scrollOffset_;
-
-    // Order selection points
-    SelectionCoord orderedStart = selectionStart_;
-    SelectionCoord orderedEnd = selectionEnd_;
-    if (orderedStart.row > orderedEnd.row || (orderedStart.row == orderedEnd.row && orderedStart.col > orderedEnd.col)) {
-        std::swap(orderedStart, orderedEnd);
+    // While a scroll animates the view sits between lines: the first line is
+    // shifted up by whole pixels and one extra line peeks in at the bottom
+    float position = std::min(scrollPosition_, static_cast<float>(scrollbackSize));
+    float top = scrollbackSize - position;
+    int startLine = static_cast<int>(std::floor(top));
+    float shift = std::round((top - startLine) * cellHeight);
+    uint32_t visibleLines = rows + (shift > 0.0f ? 1 : 0);
+    
+    // Scrollback lines come from cached strips, unless a background image has
+    // to show through them. Cursor and highlights are drawn over the pane's
+    // image by the grid shader, see getGridState().
+    int cachedEnd = startLine;
+    if (rowCache && bgImage.empty()) {
+        cachedEnd = std::min(scrollbackSize, startLine + static_cast<int>(visibleLines));
+        rowCache->begin(static_cast<uint32_t>(std::ceil(width)), cellHeight, fontRenderer_->getGlyphGeneration());
+        if (cachedEnd > startLine) {
+            uint64_t base = session->getScrollbackBase();
+            rowCache->draw(x, y - shift, base + startLine, base + cachedEnd, base + scrollbackSize,
+                [&](uint64_t line, float lineY) {
+                    uint64_t lineStart = fontRenderer_->getPlaceholderCount();
+                    drawTerminalRow(scrollback[line - base], cols, 0.0f, lineY, cellWidth);
+                    return fontRenderer_->getPlaceholderCount() == lineStart;
+                });
+        }
     }
     
-    for (uint32_t i = 0; i < rows; ++i) { // i is the screen row
+    for (uint32_t i = 0; i < visibleLines; ++i) { // i is the screen row
         int lineIndex = startLine + i;
         const std::vector<Cell>* line = nullptr;
         
-        if (lineIndex >= 0 && lineIndex < scrollbackSize) {
+        if (lineIndex < cachedEnd) {
+            continue;
+        } else if (lineIndex >= 0 && lineIndex < scrollbackSize) {
             line = &scrollback[lineIndex];
         } else if (lineIndex >= scrollbackSize && lineIndex < scrollbackSize + (int)rows) {
             line = &cells[lineIndex - scrollbackSize];
@@ -335,88 +809,41 @@ void Application::drawTerminalContent(TerminalSession* session, float x, float y
             continue;
         }
         
-        for (uint32_t j = 0; j < cols && j < line->size(); ++j) { // j is the screen col
-            const auto& cell = (*line)[j];
-            
-            float cellX = x + j * cellWidth;
-            float cellY = y + i * cellHeight;
-            
-            // Check if cell is selected
-            bool isSelected = false;
-            if (isSelecting_ || (selectionStart_.row != selectionEnd_.row || selectionStart_.col != selectionEnd_.col)) {
-                int screenRow = static_cast<int>(i);
-                int screenCol = static_cast<int>(j);
-
-                if (screenRow > orderedStart.row && screenRow < orderedEnd.row) {
-                    isSelected = true;
-                } else if (screenRow == orderedStart.row && screenRow == orderedEnd.row) {
-                    if (screenCol >= orderedStart.col && screenCol < orderedEnd.col) {
-                        isSelected = true;
-                    }
-                } else if (screenRow == orderedStart.row) {
-                    if (screenCol >= orderedStart.col) {
-                        isSelected = true;
-                    }
-                } else if (screenRow == orderedEnd.row) {
-                    if (screenCol < orderedEnd.col) {
-                        isSelected = true;
-                    }
-                }
-            }
-
-            float r = ((cell.fgColor >> 16) & 0xFF) / 255.0f;
-            float g = ((cell.fgColor >> 8) & 0xFF) / 255.0f;
-            float b = (cell.fgColor & 0xFF) / 255.0f;
-
-            bool isSearchMatch = false;
-            if (isSearching_ && currentSearchResultIndex_ != -1 && !searchResultCoords_.empty()) {
-                int matchAbsoluteRow = searchResultCoords_[currentSearchResultIndex_].row;
-                int matchCol = searchResultCoords_[currentSearchResultIndex_].col;
-                // Convert screen row to absolute row for comparison
-                int currentAbsoluteRow = startLine + i;
-
-                if (currentAbsoluteRow == matchAbsoluteRow && (int)j == matchCol) {
-                    isSearchMatch = true;
-                }
-            }
-
-            if (isSelected) {
-                // Render highlight by swapping fg/bg
-                renderer_->renderQuad(cellX, cellY, cellWidth, cellHeight, VK_NULL_HANDLE, r, g, b, 1.0f);
-
-                float bg_r = ((cell.bgColor >> 16) & 0xFF) / 255.0f;
-                float bg_g = ((cell.bgColor >> 8) & 0xFF) / 255.0f;
-                float bg_b = (cell.bgColor & 0xFF) / 255.0f;
-                if (cell.character != ' ' && cell.character != 0) {
-                    fontRenderer_->renderCharacter(cellX, cellY, cell.character, bg_r, bg_g, bg_b);
-                }
-            } else if (isSearchMatch) {
-                // Render search match highlight (e.g., yellow background)
-                renderer_->renderQuad(cellX, cellY, cellWidth, cellHeight, VK_NULL_HANDLE, 1.0f, 1.0f, 0.0f, 0.5f); // Semi-transparent yellow
-                if (cell.character != ' ' && cell.character != 0) {
-                    fontRenderer_->renderCharacter(cellX, cellY, cell.character, r, g, b);
-                }
-            } else {
-                // Render normal background (or nothing if transparent)
-                // Assuming background is handled by the initial clear or background image
+        drawTerminalRow(*line, cols, x, y + i * cellHeight - shift, cellWidth);
+    }
+    return fontRenderer_->getPlaceholderCount() == placeholders;
+}
 
-                // Render character
-                if (cell.character != ' ' && cell.character != 0) {
-                    fontRenderer_->renderCharacter(cellX, cellY, cell.character, r, g, b);
-                }
-            }
-        }
+void Application::drawTerminalRow(const std::vector<Cell>& line, uint32_t cols, float x, float y, float cellWidth) {
+    size_t lineCols = std::min<size_t>(cols, line.size());
+    rowText_.resize(lineCols);
+    rowColors_.resize(lineCols);
+    
+    // Background is handled by the clear or the background image
+    for (uint32_t j = 0; j < lineCols; ++j) { // j is the screen col
+        const auto& cell = line[j];
+        rowText_[j] = cell.character != 0 ? cell.character : U' ';
+        rowColors_[j] = packColor(cell.fgColor);
     }
     
-    // Only render the cursor if we are not scrolled up
-    if (scrollOffset_ == 0) {
-        uint32_t cursorRow = session->getCursorRow();
-        uint32_t cursorCol = session->getCursorCol();
-        if (cursorRow < rows && cursorCol < cols) {
-            float cursorX = x + cursorCol * cellWidth;
-            float cursorY = y + cursorRow * cellHeight + cellHeight - 2.0f;
-            renderer_->renderQuad(cursorX, cursorY, cellWidth, 2.0f, VK_NULL_HANDLE, 1.0f, 1.0f, 1.0f, 1.0f);
+    // Shape runs of equal style; rows that didn't change hit the shaped-run cache
+    size_t runStart = 0;
+    while (runStart < lineCols) {
+        bool bold = line[runStart].bold;
+        size_t runEnd = runStart + 1;
+        while (runEnd < lineCols && line[runEnd].bold == bold) {
+            ++runEnd;
         }
+        
+        const auto& shaped = fontRenderer_->shapeRun(rowText_.data() + runStart, runEnd - runStart, bold ? 1 : 0);
+        for (const ShapedGlyph& glyph : shaped) {
+            size_t col = runStart + glyph.cluster;
+            if (rowText_[col] == U' ') continue;
+            
+            // Glyphs take the colors of the cell their cluster starts in
+            fontRenderer_->renderShapedGlyph(x + col * cellWidth, y, glyph, rowColors_[col]);
+        }
+        runStart = runEnd;
     }
 }
 
@@ -452,6 +879,8 @@ void Application::onTile() {
 void Application::cleanup() {
     // Clean up components that use Vulkan resources BEFORE destroying the renderer
     fontRenderer_.reset(); // This must be destroyed before renderer_
+    perfHud_.reset();
+    searchBar_.reset();
     paneManager_.reset();
     menuBar_.reset();
     settingsUI_.reset();
@@ -465,46 +894,15 @@ void Application::cleanup() {
     glfwTerminate();
 }
 
-bool Application::isPathSafe(const std::string& path) {
-    // Check for empty path
-    if (path.empty()) {
-        return false;
-    }
-
-    // Check path length (prevent extremely long paths)
-    if (path.length() > 4096) {
-        return false;
-    }
-
-    // Check for null bytes (security risk)
-    if (path.find('\0') != std::string::npos) {
-        return false;
-    }
-
-    // Prevent absolute paths
-    if (path.rfind('/', 0) == 0) {
-        return false;
-    }
-
-    // Prevent directory traversal (.., ./.., /.., etc.)
-    if (path.find("..") != std::string::npos) {
-        return false;
-    }
+void Application::zoomFont(int delta) {
+    if (!fontRenderer_) return;
 
-    // Prevent paths starting with ./
-    if (path.rfind("./", 0) == 0) {
-        return false;
-    }
-
-    // Only allow alphanumeric, dash, underscore, dot (for extension), and forward slash
-    for (char c : path) {
-        if (!std::isalnum(static_cast<unsigned char>(c)) &&
-            c != '-' && c != '_' && c != '.' && c != '/') {
-            return false;
-        }
+    int size = delta == 0 ? static_cast<int>(settings_->getFontSize())
+                          : static_cast<int>(fontRenderer_->getFontSize()) + delta;
+    size = std::clamp(size, 8, 72); // Same range as the settings dialog
+    if (!fontRenderer_->setFontSize(static_cast<uint32_t>(size))) {
+        std::cerr << "Warning: Failed to resize font to " << size << std::endl;
     }
-
-    return true;
 }
 
 void Application::keyCallback(GLFWwindow* window, int key, [[maybe_unused]] int scancode, int action, int mods) {
@@ -522,6 +920,12 @@ void Application::keyCallback(GLFWwindow* window, int key, [[maybe_unused]] int
     }
     
     if (action == GLFW_PRESS) {
+        if (key == GLFW_KEY_F12) {
+            app->perfHud_->toggle();
+            app->renderer_->damageAll(); // Shows it, or uncovers what was under it
+            return;
+        }
+        
         // Handle search keybinds
         if (mods == (GLFW_MOD_CONTROL | GLFW_MOD_SHIFT) && key == GLFW_KEY_F) { // Ctrl+Shift+F
             app->toggleSearch();
@@ -578,7 +982,25 @@ void Application::keyCallback(GLFWwindow* window, int key, [[maybe_unused]] int
             }
         }
 
+        // Font zoom
+        if (mods == GLFW_MOD_CONTROL) {
+            if (key == GLFW_KEY_EQUAL || key == GLFW_KEY_KP_ADD) {
+                app->zoomFont(1);
+                return;
+            }
+            if (key == GLFW_KEY_MINUS || key == GLFW_KEY_KP_SUBTRACT) {
+                app->zoomFont(-1);
+                return;
+            }
+            if (key == GLFW_KEY_0) {
+                app->zoomFont(0);
+                return;
+            }
+        }
+
         app->scrollOffset_ = 0; // Reset scroll on key press
+        app->scrollPosition_ = 0.0f;
+        app->cursorBlinkStart_ = glfwGetTime(); // Typing keeps the cursor shown
         if (app->menuBar_->handleKey(key, mods)) {
             return;
         }
@@ -619,6 +1041,8 @@ void Application::charCallback(GLFWwindow* window, unsigned int codepoint) {
     }
 
     app->scrollOffset_ = 0; // Reset scroll on input
+    app->scrollPosition_ = 0.0f;
+    app->cursorBlinkStart_ = glfwGetTime();
     
     if (app->isSearching_) {
         std::string utf8Char = codepointToUtf8(codepoint);
@@ -768,8 +1192,12 @@ void Application::scrollCallback(GLFWwindow* window, [[maybe_unused]] double xof
     TerminalSession* activeSession = app->paneManager_->getActivePane()->session.get(); // Changed
     if (!activeSession) return; 
     
-    // yoffset is typically -1 for scroll down, +1 for scroll up
-    app->scrollOffset_ -= static_cast<int>(yoffset);
+    // yoffset is typically -1 for scroll down, +1 for scroll up; touchpads
+    // report fractions, which add up until they make a whole line
+    app->scrollRemainder_ += yoffset;
+    int lines = static_cast<int>(app->scrollRemainder_);
+    app->scrollRemainder_ -= lines;
+    app->scrollOffset_ -= lines;
     
     // Clamp scrollOffset
     if (app->scrollOffset_ < 0) {
@@ -2,16 +2,22 @@
 
 #include <memory>
 #include <string>
+#include <tuple>
 #include <vector>
 
 // Explicitly include full definitions for all types used directly by Application
 #include "renderer/vulkan_renderer.hpp"
 #include "renderer/font_renderer.hpp"
 #include "renderer/image_loader.hpp" 
+#include "renderer/image_cache.hpp"
+#include "renderer/row_strip_cache.hpp"
+#include "renderer/frame_pacer.hpp"
 #include "terminal/terminal_session.hpp"
 #include "ui/pane_manager.hpp"
 #include "ui/menu_bar.hpp"
 #include "ui/window_tiler.hpp"
+#include "ui/perf_hud.hpp"
+#include "ui/ui_layer.hpp"
 #include "settings/settings.hpp"
 #include "settings/settings_ui.hpp"
 
@@ -33,8 +39,22 @@ public:
     void run();
     void cleanup();
     
+    // Benchmark mode: no window, panes or shell. Replays recorded PTY output
+    // (e.g. from script(1)) through a session, timing every frame, and
+    // optionally writes the final frame to a PPM image.
+    bool initHeadless(uint32_t width, uint32_t height);
+    int runBenchmark(const std::string& replayPath, const std::string& capturePath);
+    // Types commands into a real shell and times each until its output has been drawn
+    int runLatencyTest(int iterations);
+    
 public: // Made public for PaneManager to call
-    void drawTerminalContent(TerminalSession* session, float x, float y, float width, float height);
+    // rowCache, if given, supplies scrollback rows rendered in earlier frames.
+    // Returns false if placeholders stood in for glyphs not rasterized yet.
+    bool drawTerminalContent(TerminalSession* session, float x, float y, float width, float height, RowStripCache* rowCache = nullptr);
+    bool getCellSize(float& width, float& height) const; // Of one character cell at the current font size
+    // Cursor and highlights of a pane the given size, drawn over its image by the grid
+    // shader; selection and search only show in the active pane
+    GridState getGridState(const TerminalSession* session, float width, float height, bool active) const;
     
 private:
     GLFWwindow* window_;
@@ -42,6 +62,8 @@ private:
     std::unique_ptr<WindowTiler> windowTiler_;
     std::unique_ptr<SettingsUI> settingsUI_;
     std::unique_ptr<MenuBar> menuBar_;
+    std::unique_ptr<PerfHud> perfHud_;
+    std::unique_ptr<UiLayer> searchBar_; // Created on the first renderSearchUI()
     std::unique_ptr<PaneManager> paneManager_;
     std::unique_ptr<FontRenderer> fontRenderer_;
     std::unique_ptr<VulkanRenderer> renderer_; // MUST be last - destroyed last!
@@ -49,24 +71,84 @@ private:
     bool isTiled_;
     std::vector<TileRect> tileRects_; // TileRect is defined in window_tiler.hpp
     int scrollOffset_;
+    float scrollPosition_ = 0.0f;  // Shown offset in lines, eased toward scrollOffset_
+    double scrollRemainder_ = 0.0; // Wheel motion short of a whole line
+    double lastFrameTime_ = 0.0;
+    double lastDrawnTime_ = 0.0; // When the last frame was drawn, for the HUD's frame times
+    FramePacer framePacer_;      // Used with render.late_latch
     
     bool isSelecting_;
     SelectionCoord selectionStart_;
     SelectionCoord selectionEnd_;
     
+    CursorShape cursorShape_ = CursorShape::Underline; // From cursor.shape
+    double cursorBlinkInterval_ = 0.0; // Seconds on, then off; 0 for a steady cursor
+    double cursorBlinkStart_ = 0.0;    // Input restarts the blink with the cursor shown
+    
+    // Per-row scratch for shaping, reused across rows and frames
+    std::vector<char32_t> rowText_;
+    std::vector<uint32_t> rowColors_; // Glyph colors, packed RGBA8
+    
+    // State outside the terminal grids that shows on screen; any change redraws everything.
+    // Selections, search matches and the cursor are drawn per pane, see getGridState().
+    struct UiState {
+        uint32_t width = 0, height = 0;
+        uint32_t fontSize = 0;
+        int scrollOffset = 0;
+        float scrollPosition = 0.0f;
+        bool settingsVisible = false;
+        std::string settingsKey;
+        bool searching = false;
+        std::string searchQuery;
+        int searchResultIndex = -1;
+        size_t searchResultCount = 0;
+        bool operator==(const UiState& other) const {
+            return std::tie(width, height, fontSize, scrollOffset, scrollPosition, settingsVisible, settingsKey, searching,
+                            searchQuery, searchResultIndex, searchResultCount) ==
+                   std::tie(other.width, other.height, other.fontSize, other.scrollOffset, other.scrollPosition, other.settingsVisible,
+                            other.settingsKey, other.searching, other.searchQuery, other.searchResultIndex, other.searchResultCount);
+        }
+        // Whether only the settings dialog was opened, closed or edited
+        bool changesOnlySettings(const UiState& other) const {
+            UiState rest = other;
+            rest.settingsVisible = settingsVisible;
+            rest.settingsKey = settingsKey;
+            return *this == rest;
+        }
+        // Whether the pane images themselves are out of date, not just the UI around them
+        bool changesPanes(const UiState& other) const {
+            return std::tie(width, height, fontSize, scrollOffset, scrollPosition) !=
+                   std::tie(other.width, other.height, other.fontSize, other.scrollOffset, other.scrollPosition);
+        }
+    };
+    UiState drawnUiState_;
+    
     bool isSearching_;
     std::string searchQuery_;
     std::vector<SelectionCoord> searchResultCoords_;
     int currentSearchResultIndex_;
     
+    void loadSettings();
+    void applyCursorSettings();
+    void applyRenderSettings();
     void initWindow();
     void initVulkan();
+    void initFonts();
     void initGraphics();
     void initSubsystems();
     void mainLoop();
-    void drawFrame();
+    bool drawFrame(); // False if nothing changed and the frame was skipped
+    bool isFrameDue() const;
+    void waitForLatch();
+    double drawHeadlessFrame(TerminalSession& session); // Returns the time spent in drawTerminalContent
+    UiState captureUiState() const;
+    void advanceScroll();
+    void samplePerfHud();
+    void fitBackgroundImages();
+    void drawTerminalRow(const std::vector<Cell>& line, uint32_t cols, float x, float y, float cellWidth);
     void handleInput();
     void renderSearchUI(float windowWidth, float windowHeight);
+    void zoomFont(int delta); // 0 restores the configured size
 
     std::string getSelectedText();
     void toggleSearch();
@@ -85,7 +167,10 @@ private:
     void onQuit();
     void onSettings();
     void onTile();
-    bool isPathSafe(const std::string& path);
 
     static constexpr float MENU_BAR_HEIGHT = 30.0f;
+    static constexpr double IDLE_POLL_INTERVAL = 0.004; // Seconds between PTY polls while nothing redraws
+    static constexpr float SCROLL_SMOOTHING = 18.0f;     // Per second; how fast the view catches up with the scroll offset
+    static constexpr float SCROLL_SNAP = 0.02f;          // Lines; closer than this the view snaps into place
+    static constexpr size_t REPLAY_CHUNK = 4096;         // Bytes fed per benchmark frame, as much as one PTY read
 };
\ No newline at end of file
@@ -1,9 +1,65 @@
 #include <iostream>
 #include <exception>
+#include <cstdio>
+#include <cstring>
+#include <string>
 
 #include "application.hpp"
 
-int main() {
+namespace {
+    int runBenchmark(int argc, char** argv) {
+        std::string replayPath;
+        std::string capturePath;
+        int latencyRounds = 0;
+        unsigned width = 1024, height = 768;
+        for (int i = 1; i < argc; ++i) {
+            if (std::strcmp(argv[i], "--benchmark") == 0 && i + 1 < argc) {
+                replayPath = argv[++i];
+            } else if (std::strcmp(argv[i], "--latency-test") == 0) {
+                latencyRounds = 100;
+                if (i + 1 < argc && std::sscanf(argv[i + 1], "%d", &latencyRounds) == 1) {
+                    ++i;
+                }
+                if (latencyRounds <= 0) {
+                    std::cerr << "Invalid round count: " << argv[i] << std::endl;
+                    return EXIT_FAILURE;
+                }
+            } else if (std::strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+                if (std::sscanf(argv[++i], "%ux%u", &width, &height) != 2 || width == 0 || height == 0) {
+                    std::cerr << "Invalid size: " << argv[i] << std::endl;
+                    return EXIT_FAILURE;
+                }
+            } else if (std::strcmp(argv[i], "--capture") == 0 && i + 1 < argc) {
+                capturePath = argv[++i];
+            } else {
+                std::cerr << "Usage: hyperterm --benchmark <replay> [--size WxH] [--capture out.ppm]\n"
+                          << "       hyperterm --latency-test [rounds] [--size WxH]" << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+
+        Application app;
+        if (!app.initHeadless(width, height)) {
+            std::cerr << "Failed to initialize headless renderer" << std::endl;
+            return EXIT_FAILURE;
+        }
+        try {
+            if (latencyRounds > 0) {
+                return app.runLatencyTest(latencyRounds);
+            }
+            return app.runBenchmark(replayPath, capturePath);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1) {
+        return runBenchmark(argc, argv);
+    }
+
     Application app;
     if (!app.init()) {
         std::cerr << "Failed to initialize application" << std::endl;
@@ -18,4 +74,4 @@ int main() {
     }
 
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
@@ -0,0 +1,143 @@
+#include "atlas_cache.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const std::string& path) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+        ::close(fd);
+        return false;
+    }
+
+    void* mapping = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // The mapping stays valid after the descriptor is closed
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+
+    data_ = mapping;
+    size_ = static_cast<size_t>(info.st_size);
+    return true;
+}
+
+void MappedFile::close() {
+    if (data_) {
+        munmap(data_, size_);
+        data_ = nullptr;
+        size_ = 0;
+    }
+}
+
+void ByteWriter::putBytes(const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    bytes_.insert(bytes_.end(), bytes, bytes + size);
+}
+
+bool ByteReader::getBytes(void* out, size_t size) {
+    const uint8_t* src = view(size);
+    if (!src) {
+        return false;
+    }
+    memcpy(out, src, size);
+    return true;
+}
+
+const uint8_t* ByteReader::view(size_t size) {
+    if (size > size_ - offset_) {
+        return nullptr;
+    }
+    const uint8_t* src = data_ + offset_;
+    offset_ += size;
+    return src;
+}
+
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed) {
+    // 64-bit FNV-1a
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+std::string getCacheDirectory() {
+    const char* homeDir = getenv("HOME");
+    return std::string(homeDir ? homeDir : ".") + "/.hyperterm/cache";
+}
+
+namespace {
+    bool ensureDirectory(const std::string& path) {
+        // Create each missing path component
+        for (size_t pos = path.find('/', 1); ; pos = path.find('/', pos + 1)) {
+            std::string component = path.substr(0, pos);
+            if (mkdir(component.c_str(), 0755) != 0 && errno != EEXIST) {
+                return false;
+            }
+            if (pos == std::string::npos) {
+                return true;
+            }
+        }
+    }
+}
+
+std::string getAtlasCachePath(const std::vector<std::string>& fontPaths, uint32_t fontSize, uint64_t options) {
+    // stat() rather than reading the fonts: a replaced or edited file changes size or mtime
+    uint64_t key = hashBytes(nullptr, 0);
+    for (const auto& fontPath : fontPaths) {
+        struct stat info;
+        if (stat(fontPath.c_str(), &info) != 0) {
+            return "";
+        }
+        int64_t stamp[] = {static_cast<int64_t>(info.st_size), static_cast<int64_t>(info.st_mtime),
+                           static_cast<int64_t>(info.st_mtim.tv_nsec)};
+        key = hashBytes(fontPath.data(), fontPath.size() + 1, key);
+        key = hashBytes(stamp, sizeof(stamp), key);
+    }
+
+    key = hashBytes(&fontSize, sizeof(fontSize), key);
+    key = hashBytes(&options, sizeof(options), key);
+
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.atlas", static_cast<unsigned long long>(key));
+    return getCacheDirectory() + "/" + name;
+}
+
+bool writeCacheFile(const std::string& path, const std::vector<uint8_t>& bytes) {
+    size_t slash = path.find_last_of('/');
+    if (slash != std::string::npos && !ensureDirectory(path.substr(0, slash))) {
+        return false;
+    }
+
+    std::string tempPath = path + ".tmp";
+    FILE* file = fopen(tempPath.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+
+    bool written = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    written = fclose(file) == 0 && written;
+    if (!written || rename(tempPath.c_str(), path.c_str()) != 0) {
+        remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
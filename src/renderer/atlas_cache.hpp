@@ -0,0 +1,79 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+// Read-only memory mapping of a whole file
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    // Non-copyable
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+
+    const uint8_t* data() const { return static_cast<const uint8_t*>(data_); }
+    size_t size() const { return size_; }
+
+private:
+    void* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// Append-only binary writer for cache files. Values are stored in host byte
+// order; caches are per machine, so no endianness conversion is done.
+class ByteWriter {
+public:
+    template <typename T>
+    void put(const T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "only plain data can be serialized");
+        putBytes(&value, sizeof(T));
+    }
+    void putBytes(const void* data, size_t size);
+
+    const std::vector<uint8_t>& getBytes() const { return bytes_; }
+
+private:
+    std::vector<uint8_t> bytes_;
+};
+
+// Bounds-checked reader over a byte range, typically a MappedFile
+class ByteReader {
+public:
+    ByteReader(const uint8_t* data, size_t size) : data_(data), size_(size), offset_(0) {}
+
+    template <typename T>
+    bool get(T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "only plain data can be serialized");
+        return getBytes(&value, sizeof(T));
+    }
+    bool getBytes(void* out, size_t size);
+
+    // Returns a pointer to the next `size` bytes without copying, or nullptr if truncated
+    const uint8_t* view(size_t size);
+
+private:
+    const uint8_t* data_;
+    size_t size_;
+    size_t offset_;
+};
+
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 14695981039346656037ull);
+
+// ~/.hyperterm/cache, or ./.hyperterm/cache without HOME
+std::string getCacheDirectory();
+
+// Cache file for a font under ~/.hyperterm/cache, keyed by the path, size and
+// modification time of every font file in the fallback chain, pixel size and
+// rendering options. Empty if a font can't be found.
+std::string getAtlasCachePath(const std::vector<std::string>& fontPaths, uint32_t fontSize, uint64_t options);
+
+// Write via a temporary file and rename, so readers never see a partial cache
+bool writeCacheFile(const std::string& path, const std::vector<uint8_t>& bytes);
@@ -0,0 +1,32 @@
+#include "batch_order.hpp"
+
+namespace {
+    bool overlaps(const BatchBounds& a, const BatchBounds& b) {
+        return a.x0 < b.x1 && b.x0 < a.x1 && a.y0 < b.y1 && b.y0 < a.y1;
+    }
+}
+
+std::vector<uint32_t> orderBatches(const std::vector<BatchBounds>& batches, size_t window) {
+    std::vector<uint32_t> order;
+    order.reserve(batches.size());
+    for (uint32_t i = 0; i < batches.size(); ++i) {
+        const BatchBounds& batch = batches[i];
+        size_t insertAt = order.size();
+        size_t stop = order.size() > window ? order.size() - window : 0;
+        for (size_t j = order.size(); j > stop; --j) {
+            const BatchBounds& placed = batches[order[j - 1]];
+            if (placed.group != batch.group) {
+                break;
+            }
+            if (placed.state == batch.state) {
+                insertAt = j;
+                break;
+            }
+            if (overlaps(placed, batch)) {
+                break; // Has to stay on top of this one
+            }
+        }
+        order.insert(order.begin() + insertAt, i);
+    }
+    return order;
+}
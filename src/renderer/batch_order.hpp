@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// What reordering needs to know about a run of quads drawn together
+struct BatchBounds {
+    uint32_t state; // Batches with the same state share pipeline and texture
+    uint32_t group; // Never moved past a batch of another group
+    float x0, y0, x1, y1;
+};
+
+// Draw order for batches that were submitted in order. Each batch moves up
+// to just behind the latest earlier batch with the same state, as long as
+// none of the batches it jumps over overlaps it. The image stays the same
+// while equal states end up next to each other. Only the last `window`
+// batches placed are searched.
+std::vector<uint32_t> orderBatches(const std::vector<BatchBounds>& batches, size_t window = 32);
@@ -0,0 +1,111 @@
+#include "damage_region.hpp"
+#include <algorithm>
+
+namespace {
+    bool overlaps(const DamageRect& a, const DamageRect& b) {
+        return a.x < b.x + b.width && b.x < a.x + a.width &&
+               a.y < b.y + b.height && b.y < a.y + a.height;
+    }
+
+    DamageRect unite(const DamageRect& a, const DamageRect& b) {
+        int32_t x0 = std::min(a.x, b.x);
+        int32_t y0 = std::min(a.y, b.y);
+        int32_t x1 = std::max(a.x + a.width, b.x + b.width);
+        int32_t y1 = std::max(a.y + a.height, b.y + b.height);
+        return {x0, y0, x1 - x0, y1 - y0};
+    }
+}
+
+DamageRegion::DamageRegion(size_t maxRects)
+    : maxRects_(std::max<size_t>(1, maxRects)), boundsWidth_(0), boundsHeight_(0), full_(false) {
+}
+
+void DamageRegion::setBounds(int32_t width, int32_t height) {
+    boundsWidth_ = width;
+    boundsHeight_ = height;
+    clear();
+}
+
+void DamageRegion::add(int32_t x, int32_t y, int32_t width, int32_t height) {
+    if (full_) {
+        return;
+    }
+
+    int32_t x0 = std::max(x, 0);
+    int32_t y0 = std::max(y, 0);
+    int32_t x1 = std::min(x + width, boundsWidth_);
+    int32_t y1 = std::min(y + height, boundsHeight_);
+    if (x0 >= x1 || y0 >= y1) {
+        return;
+    }
+
+    // Absorb every rectangle the new one touches; the union can reach further ones
+    DamageRect rect{x0, y0, x1 - x0, y1 - y0};
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        for (size_t i = 0; i < rects_.size(); ++i) {
+            if (overlaps(rect, rects_[i])) {
+                rect = unite(rect, rects_[i]);
+                rects_[i] = rects_.back();
+                rects_.pop_back();
+                merged = true;
+                break;
+            }
+        }
+    }
+    rects_.push_back(rect);
+
+    if (rects_.size() > maxRects_) {
+        DamageRect bounds = getBounds();
+        rects_.assign(1, bounds);
+    }
+    const DamageRect& first = rects_.front();
+    full_ = rects_.size() == 1 && first.width == boundsWidth_ && first.height == boundsHeight_;
+}
+
+void DamageRegion::add(const DamageRegion& other) {
+    if (other.full_) {
+        addAll();
+        return;
+    }
+    for (const auto& rect : other.rects_) {
+        add(rect.x, rect.y, rect.width, rect.height);
+    }
+}
+
+void DamageRegion::addAll() {
+    rects_.clear();
+    full_ = boundsWidth_ > 0 && boundsHeight_ > 0;
+    if (full_) {
+        rects_.push_back({0, 0, boundsWidth_, boundsHeight_});
+    }
+}
+
+void DamageRegion::clear() {
+    rects_.clear();
+    full_ = false;
+}
+
+DamageRect DamageRegion::getBounds() const {
+    if (rects_.empty()) {
+        return {0, 0, 0, 0};
+    }
+    DamageRect bounds = rects_.front();
+    for (const auto& rect : rects_) {
+        bounds = unite(bounds, rect);
+    }
+    return bounds;
+}
+
+bool DamageRegion::intersects(float x0, float y0, float x1, float y1) const {
+    if (full_) {
+        return true;
+    }
+    for (const auto& rect : rects_) {
+        if (x0 < rect.x + rect.width && x1 > rect.x && y0 < rect.y + rect.height && y1 > rect.y) {
+            return true;
+        }
+    }
+    return false;
+}
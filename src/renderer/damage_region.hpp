@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct DamageRect {
+    int32_t x;
+    int32_t y;
+    int32_t width;
+    int32_t height;
+};
+
+// Set of pixel rectangles that changed since some earlier frame, clamped to
+// the surface. Overlapping rectangles are merged so the set stays disjoint
+// (blended quads redrawn once per rectangle must not overlap themselves), and
+// past maxRects the set collapses into its bounding box.
+class DamageRegion {
+public:
+    explicit DamageRegion(size_t maxRects = 16);
+
+    void setBounds(int32_t width, int32_t height);
+    void add(int32_t x, int32_t y, int32_t width, int32_t height);
+    void add(const DamageRegion& other);
+    void addAll();
+    void clear();
+
+    bool empty() const { return rects_.empty(); }
+    bool isFull() const { return full_; }
+    const std::vector<DamageRect>& getRects() const { return rects_; }
+    DamageRect getBounds() const;
+
+    // Whether the box from (x0, y0) to (x1, y1) overlaps any rectangle
+    bool intersects(float x0, float y0, float x1, float y1) const;
+
+private:
+    size_t maxRects_;
+    int32_t boundsWidth_;
+    int32_t boundsHeight_;
+    bool full_;
+    std::vector<DamageRect> rects_;
+};
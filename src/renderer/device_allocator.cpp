@@ -0,0 +1,189 @@
+#include "device_allocator.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+void DeviceAllocator::init(VkDevice device, VkPhysicalDevice physicalDevice) {
+    device_ = device;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties_);
+
+    // Small heaps (integrated GPUs, the host-visible BAR window) get smaller blocks
+    pools_.assign(memoryProperties_.memoryTypeCount * 2, Pool());
+    for (uint32_t type = 0; type < memoryProperties_.memoryTypeCount; ++type) {
+        VkDeviceSize heapSize = memoryProperties_.memoryHeaps[memoryProperties_.memoryTypes[type].heapIndex].size;
+        VkDeviceSize blockSize = std::min(DEFAULT_BLOCK_SIZE, std::max<VkDeviceSize>(heapSize / 8, 1024 * 1024));
+        pools_[type * 2].blockSize = blockSize;
+        pools_[type * 2 + 1].blockSize = blockSize;
+    }
+}
+
+void DeviceAllocator::cleanup() {
+    for (auto& pool : pools_) {
+        for (auto& block : pool.blocks) {
+            if (block.memory != VK_NULL_HANDLE) {
+                vkFreeMemory(device_, block.memory, nullptr); // Implicitly unmaps
+            }
+        }
+    }
+    pools_.clear();
+    dedicatedCount_ = 0;
+    dedicatedBytes_ = 0;
+    allocationCount_ = 0;
+}
+
+MemoryAllocation DeviceAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool optimalImage) {
+    uint32_t memoryType = findMemoryType(requirements.memoryTypeBits, properties);
+    uint32_t poolIndex = memoryType * 2 + (optimalImage ? 1 : 0);
+    Pool& pool = pools_[poolIndex];
+
+    MemoryAllocation allocation;
+    allocation.pool = poolIndex;
+    allocation.size = requirements.size;
+
+    if (requirements.size > pool.blockSize / 2) {
+        allocation.memory = allocateMemory(requirements.size, memoryType, &allocation.mapped);
+        allocation.block = DEDICATED_BLOCK;
+        dedicatedCount_++;
+        dedicatedBytes_ += requirements.size;
+        allocationCount_++;
+        return allocation;
+    }
+
+    // First block with room, else a new block in the first free slot
+    uint32_t blockIndex = 0;
+    for (; blockIndex < pool.blocks.size(); ++blockIndex) {
+        Block& block = pool.blocks[blockIndex];
+        if (block.memory != VK_NULL_HANDLE && block.ranges.allocate(requirements.size, requirements.alignment, allocation.offset)) {
+            break;
+        }
+    }
+    if (blockIndex == pool.blocks.size()) {
+        Block block;
+        block.memory = allocateMemory(pool.blockSize, memoryType, &block.mapped);
+        block.ranges = RangeAllocator(pool.blockSize);
+        block.ranges.allocate(requirements.size, requirements.alignment, allocation.offset);
+
+        auto slot = std::find_if(pool.blocks.begin(), pool.blocks.end(),
+            [](const Block& candidate) { return candidate.memory == VK_NULL_HANDLE; });
+        blockIndex = static_cast<uint32_t>(slot - pool.blocks.begin());
+        if (slot == pool.blocks.end()) {
+            pool.blocks.push_back(std::move(block));
+        } else {
+            *slot = std::move(block);
+        }
+    }
+
+    Block& block = pool.blocks[blockIndex];
+    allocation.memory = block.memory;
+    allocation.block = blockIndex;
+    if (block.mapped) {
+        allocation.mapped = static_cast<char*>(block.mapped) + allocation.offset;
+    }
+    allocationCount_++;
+    return allocation;
+}
+
+void DeviceAllocator::free(const MemoryAllocation& allocation) {
+    if (allocation.memory == VK_NULL_HANDLE) {
+        return;
+    }
+    allocationCount_--;
+
+    if (allocation.block == DEDICATED_BLOCK) {
+        vkFreeMemory(device_, allocation.memory, nullptr);
+        dedicatedCount_--;
+        dedicatedBytes_ -= allocation.size;
+        return;
+    }
+
+    Pool& pool = pools_[allocation.pool];
+    Block& block = pool.blocks[allocation.block];
+    block.ranges.free(allocation.offset, allocation.size);
+
+    // Give empty blocks back to the driver, but keep one around so a pool
+    // that empties and refills every frame doesn't churn allocations
+    if (block.ranges.empty()) {
+        size_t live = std::count_if(pool.blocks.begin(), pool.blocks.end(),
+            [](const Block& candidate) { return candidate.memory != VK_NULL_HANDLE; });
+        if (live > 1) {
+            vkFreeMemory(device_, block.memory, nullptr);
+            block = Block();
+        }
+    }
+}
+
+MemoryStats DeviceAllocator::getStats() const {
+    MemoryStats stats;
+    stats.dedicated = dedicatedCount_;
+    stats.allocations = allocationCount_;
+    stats.reserved = dedicatedBytes_;
+    stats.used = dedicatedBytes_;
+
+    VkDeviceSize freeBytes = 0;
+    VkDeviceSize largestFree = 0;
+    for (const auto& pool : pools_) {
+        for (const auto& block : pool.blocks) {
+            if (block.memory == VK_NULL_HANDLE) {
+                continue;
+            }
+            stats.blocks++;
+            stats.reserved += block.ranges.getSize();
+            stats.used += block.ranges.getUsed();
+            freeBytes += block.ranges.getSize() - block.ranges.getUsed();
+            largestFree = std::max<VkDeviceSize>(largestFree, block.ranges.getLargestFree());
+        }
+    }
+    if (freeBytes > 0) {
+        stats.fragmentation = 1.0f - static_cast<float>(largestFree) / static_cast<float>(freeBytes);
+    }
+    return stats;
+}
+
+void DeviceAllocator::dumpStats(std::ostream& out) const {
+    MemoryStats stats = getStats();
+    out << "Device memory: " << stats.allocations << " allocations in " << stats.blocks << " blocks + "
+        << stats.dedicated << " dedicated, " << (stats.used >> 10) << " / " << (stats.reserved >> 10)
+        << " KiB used, fragmentation " << static_cast<int>(stats.fragmentation * 100.0f) << "%" << std::endl;
+
+    for (size_t i = 0; i < pools_.size(); ++i) {
+        for (size_t b = 0; b < pools_[i].blocks.size(); ++b) {
+            const Block& block = pools_[i].blocks[b];
+            if (block.memory == VK_NULL_HANDLE) {
+                continue;
+            }
+            out << "  type " << i / 2 << (i % 2 ? " images" : " buffers") << " block " << b << ": "
+                << (block.ranges.getUsed() >> 10) << " / " << (block.ranges.getSize() >> 10) << " KiB, "
+                << block.ranges.getFreeRangeCount() << " free ranges" << std::endl;
+        }
+    }
+}
+
+uint32_t DeviceAllocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+    for (uint32_t i = 0; i < memoryProperties_.memoryTypeCount; i++) {
+        if ((typeFilter & (1 << i)) && (memoryProperties_.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+
+    throw std::runtime_error("failed to find suitable memory type!");
+}
+
+VkDeviceMemory DeviceAllocator::allocateMemory(VkDeviceSize size, uint32_t memoryType, void** mapped) {
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = size;
+    allocInfo.memoryTypeIndex = memoryType;
+
+    VkDeviceMemory memory;
+    if (vkAllocateMemory(device_, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate device memory!");
+    }
+
+    *mapped = nullptr;
+    if (memoryProperties_.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        if (vkMapMemory(device_, memory, 0, VK_WHOLE_SIZE, 0, mapped) != VK_SUCCESS) {
+            vkFreeMemory(device_, memory, nullptr);
+            throw std::runtime_error("failed to map device memory!");
+        }
+    }
+    return memory;
+}
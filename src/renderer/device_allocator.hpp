@@ -0,0 +1,70 @@
+#pragma once
+
+#include "range_allocator.hpp"
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// A piece of device memory handed out by DeviceAllocator. Host-visible
+// memory comes persistently mapped; `mapped` already points at the offset.
+struct MemoryAllocation {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    void* mapped = nullptr;
+    uint32_t pool = 0;
+    uint32_t block = 0; // DEDICATED_BLOCK for allocations with memory of their own
+};
+
+struct MemoryStats {
+    uint32_t blocks = 0;
+    uint32_t dedicated = 0;
+    uint64_t allocations = 0;
+    VkDeviceSize reserved = 0;  // Held from the driver, blocks and dedicated allocations
+    VkDeviceSize used = 0;
+    float fragmentation = 0.0f; // 1 - largest free range / free bytes, over all blocks
+};
+
+// Suballocates buffers and images from large blocks, one pool of blocks per
+// memory type, so the driver sees a handful of vkAllocateMemory calls instead
+// of one per resource. Optimal-tiling images get pools of their own, which
+// keeps them clear of bufferImageGranularity conflicts with buffers.
+// Resources larger than half a block get a dedicated allocation.
+class DeviceAllocator {
+public:
+    static constexpr uint32_t DEDICATED_BLOCK = UINT32_MAX;
+
+    void init(VkDevice device, VkPhysicalDevice physicalDevice);
+    void cleanup();
+
+    MemoryAllocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool optimalImage);
+    void free(const MemoryAllocation& allocation);
+
+    MemoryStats getStats() const;
+    void dumpStats(std::ostream& out) const;
+
+private:
+    struct Block {
+        VkDeviceMemory memory = VK_NULL_HANDLE; // Null for a slot whose block was released
+        void* mapped = nullptr;
+        RangeAllocator ranges;
+    };
+
+    struct Pool {
+        VkDeviceSize blockSize = 0;
+        std::vector<Block> blocks;
+    };
+
+    VkDevice device_ = VK_NULL_HANDLE;
+    VkPhysicalDeviceMemoryProperties memoryProperties_{};
+    std::vector<Pool> pools_; // Two per memory type: buffers, then optimal images
+    uint32_t dedicatedCount_ = 0;
+    VkDeviceSize dedicatedBytes_ = 0;
+    uint64_t allocationCount_ = 0;
+
+    uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+    VkDeviceMemory allocateMemory(VkDeviceSize size, uint32_t memoryType, void** mapped);
+
+    static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64ull * 1024 * 1024;
+};
@@ -1,179 +1,650 @@
 #include "font_renderer.hpp"
 #include "vulkan_renderer.hpp"
+#include "atlas_cache.hpp"
+#include FT_ADVANCES_H
+#ifdef HYPERTERM_HAS_HARFBUZZ
+#include <hb.h>
+#include <hb-ft.h>
+#endif
+#include <iostream>
 #include <stdexcept>
 #include <algorithm>
 #include <cstring>
 
+namespace {
+    constexpr uint32_t ATLAS_PAGE_SIZE = 1024;
+    constexpr uint32_t ATLAS_MAX_PAGES = 4;
+    constexpr uint32_t COLOR_ATLAS_MAX_PAGES = 2;
+    constexpr uint32_t GLYPH_PADDING = 1; // Transparent border so linear filtering doesn't bleed
+    constexpr uint32_t SDF_REFERENCE_SIZE = 48; // Pixel size distance fields are rasterized at
+    constexpr uint32_t MAX_SYNC_RASTERIZATIONS = 16; // Late glyphs rasterized on the spot per frame; the rest wait
+    
+    // Bump when the cache layout or anything that changes rasterized output changes
+    constexpr uint32_t ATLAS_CACHE_MAGIC = 0x43415448; // "HTAC"
+    constexpr uint32_t ATLAS_CACHE_VERSION = 4;
+    constexpr uint64_t ATLAS_CACHE_OPTIONS = (uint64_t(ATLAS_CACHE_VERSION) << 32) | (ATLAS_PAGE_SIZE << 8) | GLYPH_PADDING;
+    constexpr uint64_t ATLAS_CACHE_DISTANCE_FIELD = uint64_t(1) << 63;
+    
+    uint64_t makeGlyphKey(uint32_t face, uint32_t glyphIndex) {
+        return (uint64_t(face) << 32) | glyphIndex;
+    }
+}
+
 FontRenderer::FontRenderer(VkDevice device, VkPhysicalDevice physicalDevice, VkQueue graphicsQueue, VkCommandPool commandPool)
     : device_(device), physicalDevice_(physicalDevice), graphicsQueue_(graphicsQueue), commandPool_(commandPool), 
-      fontSize_(16), lineHeight_(20), ftLibrary_(nullptr), ftFace_(nullptr), renderer_(nullptr),
-      atlasImage_(VK_NULL_HANDLE), atlasMemory_(VK_NULL_HANDLE), atlasView_(VK_NULL_HANDLE),
-      atlasWidth_(1024), atlasHeight_(1024), atlasX_(0), atlasY_(0), atlasRowHeight_(0) {
+      fontSize_(16), lineHeight_(20), renderMode_(GlyphRenderMode::Bitmap), rasterSize_(16), baseLineHeight_(20), baseAscent_(16), scale_(1.0f),
+      ftLibrary_(nullptr), renderer_(nullptr),
+      grayAtlas_(ATLAS_PAGE_SIZE, ATLAS_MAX_PAGES, VK_FORMAT_R8_UNORM, 1),
+      colorAtlas_(ATLAS_PAGE_SIZE, COLOR_ATLAS_MAX_PAGES, VK_FORMAT_R8G8B8A8_UNORM, 4) {
     if (FT_Init_FreeType(&ftLibrary_)) {
         throw std::runtime_error("Failed to initialize FreeType");
     }
-    initAtlas();
+    rasterizer_ = std::make_unique<GlyphRasterizer>();
+    blankGlyph_.page = NO_ATLAS_PAGE;
+    blankGlyph_.slot = NO_GLYPH_SLOT;
+#ifdef HYPERTERM_HAS_HARFBUZZ
+    hbBuffer_ = hb_buffer_create();
+#endif
 }
 
 FontRenderer::~FontRenderer() {
+    rasterizer_.reset(); // Join workers before tearing down
+    saveAtlasCache();
     cleanup();
-    if (ftFace_) {
-        FT_Done_Face(ftFace_);
-    }
+    closeFaces();
+#ifdef HYPERTERM_HAS_HARFBUZZ
+    hb_buffer_destroy(hbBuffer_);
+#endif
     FT_Done_FreeType(ftLibrary_);
 }
 
+void FontRenderer::closeFaces() {
+#ifdef HYPERTERM_HAS_HARFBUZZ
+    for (hb_font_t* font : hbFonts_) {
+        hb_font_destroy(font);
+    }
+    hbFonts_.clear();
+#endif
+    for (FT_Face face : ftFaces_) {
+        FT_Done_Face(face);
+    }
+    ftFaces_.clear();
+    facePaths_.clear();
+}
+
 bool FontRenderer::loadFont(const std::string& fontPath, uint32_t fontSize) {
+    saveAtlasCache(); // Keep what the previous font rasterized this session
+    
     fontPath_ = fontPath;
     fontSize_ = fontSize;
     
-    if (ftFace_) {
-        FT_Done_Face(ftFace_);
-        ftFace_ = nullptr;
-    }
+    bool distanceField = renderMode_ == GlyphRenderMode::DistanceField && GLYPH_SDF_SUPPORTED;
+    rasterSize_ = distanceField ? SDF_REFERENCE_SIZE : fontSize;
+    grayAtlas_.distanceField = distanceField;
     
-    // Clear existing glyphs and reset atlas
-    cleanup(); // Clean up old atlas, if any
-    initAtlas(); // Create new atlas
-    atlasX_ = 0;
-    atlasY_ = 0;
-    atlasRowHeight_ = 0;
-    glyphs_.clear(); // Clear old glyphs
+    closeFaces();
     
-    if (FT_New_Face(ftLibrary_, fontPath.c_str(), 0, &ftFace_)) {
+    // Clear existing glyphs and atlas pages; pages are recreated on demand
+    cleanup();
+    
+    FT_Face face = nullptr;
+    if (FT_New_Face(ftLibrary_, fontPath.c_str(), 0, &face)) {
         return false;
     }
+    ftFaces_.push_back(face);
+    facePaths_.push_back(fontPath);
+    
+    for (const auto& path : fallbackPaths_) {
+        if (path == fontPath) continue;
+        if (FT_New_Face(ftLibrary_, path.c_str(), 0, &face)) {
+            std::cerr << "Warning: Failed to load fallback font: " << path << std::endl;
+            continue;
+        }
+        ftFaces_.push_back(face);
+        facePaths_.push_back(path);
+    }
+    
+    for (FT_Face loaded : ftFaces_) {
+        setFacePixelSize(loaded, rasterSize_);
+#ifdef HYPERTERM_HAS_HARFBUZZ
+        hbFonts_.push_back(hb_ft_font_create_referenced(loaded));
+#endif
+    }
+    baseLineHeight_ = (ftFaces_[0]->size->metrics.height >> 6);
+    baseAscent_ = (ftFaces_[0]->size->metrics.ascender >> 6);
+    updateScale();
     
-    FT_Set_Pixel_Sizes(ftFace_, 0, fontSize);
-    lineHeight_ = (ftFace_->size->metrics.height >> 6);
+    rasterizer_->setFont(facePaths_, rasterSize_, distanceField);
     
+    // Distance-field atlases don't depend on the display size, so every size shares one cache
+    cacheOptions_ = ATLAS_CACHE_OPTIONS | (distanceField ? ATLAS_CACHE_DISTANCE_FIELD : 0);
+    cachePath_ = getAtlasCachePath(facePaths_, rasterSize_, cacheOptions_);
+    if (loadAtlasCache()) {
+        return true;
+    }
+    
+    // ASCII is needed immediately by the UI, so rasterize it here rather than on the pool
     for (char32_t c = 32; c < 127; c++) {
-        getGlyph(c);
+        GlyphSource source = resolveGlyph(c);
+        rasterizeNow(c, source.face, source.glyphIndex);
     }
     
     return true;
 }
 
+void FontRenderer::setRenderer(VulkanRenderer* renderer) {
+    renderer_ = renderer;
+    
+    // Pages stay put while any frame that may still be executing could sample them
+    if (renderer_) {
+        grayAtlas_.atlas.setSafeFrames(renderer_->getFramesInFlight());
+        colorAtlas_.atlas.setSafeFrames(renderer_->getFramesInFlight());
+    }
+}
+
+bool FontRenderer::setFontSize(uint32_t fontSize) {
+    if (fontSize == fontSize_) {
+        return true;
+    }
+    
+    if (!ftFaces_.empty() && grayAtlas_.distanceField) {
+        fontSize_ = fontSize;
+        updateScale();
+        return true;
+    }
+    return loadFont(fontPath_, fontSize);
+}
+
+void FontRenderer::updateScale() {
+    scale_ = static_cast<float>(fontSize_) / static_cast<float>(rasterSize_);
+    lineHeight_ = static_cast<uint32_t>(baseLineHeight_ * scale_ + 0.5f);
+    
+    // Slots hold scaled metrics, so every placed glyph's slot changes with the scale
+    for (const auto& [key, glyph] : glyphsById_) {
+        writeSlot(glyph);
+    }
+    glyphGeneration_++;
+}
+
+void FontRenderer::beginFrame() {
+    grayAtlas_.atlas.beginFrame();
+    colorAtlas_.atlas.beginFrame();
+    syncRasterizations_ = 0;
+    
+    // Glyphs that found every page in flight get another try now that a frame retired
+    if (!deferredGlyphs_.empty()) {
+        std::unordered_map<uint64_t, RasterizedGlyph> deferred;
+        deferred.swap(deferredGlyphs_);
+        for (const auto& [key, rasterized] : deferred) {
+            insertGlyph(rasterized);
+        }
+    }
+    
+    // Glyphs finished by the pool since last frame go into this frame's upload batch
+    completedGlyphs_.clear();
+    rasterizer_->collect(completedGlyphs_);
+    for (const auto& rasterized : completedGlyphs_) {
+        uint64_t key = makeGlyphKey(rasterized.face, rasterized.glyphIndex);
+        if (rasterized.codepoint != NO_CODEPOINT) {
+            pendingGlyphs_.erase(rasterized.codepoint);
+        } else {
+            pendingGlyphIds_.erase(key);
+        }
+        // Late glyphs were already rasterized on the spot, see getGlyph()
+        if (glyphsById_.count(key) == 0) {
+            // Counted on arrival, when it is known which atlas the glyph lands in
+            (rasterized.color ? colorAtlas_ : grayAtlas_).atlas.recordMiss();
+        }
+        insertGlyph(rasterized);
+    }
+}
+
+void FontRenderer::touchPages(const std::vector<VkImageView>& views) {
+    for (AtlasSet* set : {&grayAtlas_, &colorAtlas_}) {
+        for (uint32_t page = 0; page < set->pages.size(); ++page) {
+            if (std::find(views.begin(), views.end(), set->pages[page].view) != views.end()) {
+                set->atlas.touch(page);
+            }
+        }
+    }
+}
+
 AtlasGlyph* FontRenderer::getGlyph(char32_t codepoint) {
-    if (glyphs_.find(codepoint) == glyphs_.end()) {
-        createGlyph(codepoint);
+    AtlasGlyph* glyph = glyphs_.find(codepoint);
+    if (glyph) {
+        (glyph->color ? colorAtlas_ : grayAtlas_).atlas.recordHit();
+        return glyph;
+    }
+    if (ftFaces_.empty()) {
+        return nullptr;
+    }
+    
+    // Another codepoint already placed this glyph (e.g. the shared .notdef box)
+    GlyphSource source = resolveGlyph(codepoint);
+    auto placed = glyphsById_.find(makeGlyphKey(source.face, source.glyphIndex));
+    if (placed != glyphsById_.end()) {
+        pendingGlyphs_.erase(codepoint);
+        (placed->second.color ? colorAtlas_ : grayAtlas_).atlas.recordHit();
+        return &glyphs_.insert(codepoint, placed->second);
+    }
+    if (deferredGlyphs_.count(makeGlyphKey(source.face, source.glyphIndex))) {
+        return getPlaceholder();
+    }
+    
+    // Misses are rasterized on the worker pool and a placeholder is drawn meanwhile,
+    // for one frame: a glyph still missing after that is rasterized here, up to
+    // MAX_SYNC_RASTERIZATIONS per frame so a screenful of new script can't stall one
+    uint64_t frame = grayAtlas_.atlas.getFrame();
+    auto pending = pendingGlyphs_.find(codepoint);
+    if (pending == pendingGlyphs_.end()) {
+        pendingGlyphs_.emplace(codepoint, frame);
+        rasterizer_->request(codepoint, source.face, source.glyphIndex);
+        return getPlaceholder();
+    }
+    if (pending->second == frame || syncRasterizations_ >= MAX_SYNC_RASTERIZATIONS) {
+        return getPlaceholder();
+    }
+    pendingGlyphs_.erase(pending);
+    return rasterizeMiss(codepoint, source.face, source.glyphIndex);
+}
+
+const AtlasGlyph* FontRenderer::getGlyphById(uint32_t face, uint32_t glyphIndex) {
+    uint64_t key = makeGlyphKey(face, glyphIndex);
+    auto it = glyphsById_.find(key);
+    if (it != glyphsById_.end()) {
+        (it->second.color ? colorAtlas_ : grayAtlas_).atlas.recordHit();
+        return &it->second;
+    }
+    if (face >= ftFaces_.size()) {
+        return nullptr;
+    }
+    if (deferredGlyphs_.count(key)) {
+        return getPlaceholder();
+    }
+    
+    // Same as getGlyph(): a placeholder for one frame, then rasterized here
+    uint64_t frame = grayAtlas_.atlas.getFrame();
+    auto pending = pendingGlyphIds_.find(key);
+    if (pending == pendingGlyphIds_.end()) {
+        pendingGlyphIds_.emplace(key, frame);
+        rasterizer_->request(NO_CODEPOINT, face, glyphIndex);
+        return getPlaceholder();
+    }
+    if (pending->second == frame || syncRasterizations_ >= MAX_SYNC_RASTERIZATIONS) {
+        return getPlaceholder();
+    }
+    pendingGlyphIds_.erase(pending);
+    return rasterizeMiss(NO_CODEPOINT, face, glyphIndex);
+}
+
+AtlasGlyph* FontRenderer::getPlaceholder() {
+    placeholderCount_++;
+    
+    // The primary face's .notdef box, or nothing while it waits for atlas space itself
+    uint64_t key = makeGlyphKey(0, 0);
+    auto it = glyphsById_.find(key);
+    if (it != glyphsById_.end()) {
+        return &it->second;
+    }
+    AtlasGlyph* notdef = deferredGlyphs_.count(key) ? nullptr : rasterizeNow(NO_CODEPOINT, 0, 0);
+    return notdef ? notdef : &blankGlyph_;
+}
+
+AtlasGlyph* FontRenderer::rasterizeMiss(char32_t codepoint, uint32_t face, uint32_t glyphIndex) {
+    syncRasterizations_++;
+    AtlasGlyph* glyph = rasterizeNow(codepoint, face, glyphIndex);
+    if (!glyph) {
+        return getPlaceholder();
+    }
+    (glyph->color ? colorAtlas_ : grayAtlas_).atlas.recordMiss();
+    return glyph;
+}
+
+AtlasGlyph* FontRenderer::rasterizeNow(char32_t codepoint, uint32_t face, uint32_t glyphIndex) {
+    RasterizedGlyph rasterized;
+    rasterized.codepoint = codepoint;
+    rasterized.face = face;
+    rasterizeGlyph(ftFaces_[face], glyphIndex, rasterized, grayAtlas_.distanceField);
+    insertGlyph(rasterized);
+    auto it = glyphsById_.find(makeGlyphKey(face, glyphIndex));
+    return it != glyphsById_.end() ? &it->second : nullptr;
+}
+
+const std::vector<ShapedGlyph>& FontRenderer::shapeRun(const char32_t* codepoints, size_t count, uint32_t style) {
+    const std::vector<ShapedGlyph>* cached = shapedRuns_.find(codepoints, count, style);
+    if (cached) {
+        return *cached;
+    }
+    
+    std::vector<ShapedGlyph> glyphs;
+    glyphs.reserve(count);
+    if (!ftFaces_.empty()) {
+#ifdef HYPERTERM_HAS_HARFBUZZ
+        shapeWithHarfBuzz(codepoints, count, glyphs);
+#else
+        shapeNominal(codepoints, count, glyphs);
+#endif
+    }
+    return shapedRuns_.insert(codepoints, count, style, std::move(glyphs));
+}
+
+void FontRenderer::shapeNominal(const char32_t* codepoints, size_t count, std::vector<ShapedGlyph>& out) {
+    // One glyph per codepoint; combining marks join the preceding cluster and
+    // are drawn after its advance, where fonts design zero-width marks to sit
+    uint32_t cluster = 0;
+    float pen = 0.0f;
+    for (size_t i = 0; i < count; ++i) {
+        GlyphSource source = resolveGlyph(codepoints[i]);
+        if (i == 0 || !isCombiningMark(codepoints[i])) {
+            cluster = static_cast<uint32_t>(i);
+            pen = 0.0f;
+        }
+        out.push_back({codepoints[i], source.face, source.glyphIndex, cluster, pen, 0.0f});
+        
+        if (i + 1 < count && isCombiningMark(codepoints[i + 1])) {
+            FT_Fixed advance = 0;
+            FT_Get_Advance(ftFaces_[source.face], source.glyphIndex, FT_LOAD_DEFAULT, &advance);
+            pen += advance / 65536.0f;
+        }
     }
-    return &glyphs_[codepoint];
 }
 
-void FontRenderer::createGlyph(char32_t codepoint) {
-    if (!ftFace_) {
+#ifdef HYPERTERM_HAS_HARFBUZZ
+void FontRenderer::shapeWithHarfBuzz(const char32_t* codepoints, size_t count, std::vector<ShapedGlyph>& out) {
+    size_t start = 0;
+    while (start < count) {
+        // Split the run where the covering face changes; marks stay with their base if it has them
+        uint32_t face = resolveGlyph(codepoints[start]).face;
+        size_t end = start + 1;
+        while (end < count) {
+            char32_t codepoint = codepoints[end];
+            if (resolveGlyph(codepoint).face != face &&
+                !(isCombiningMark(codepoint) && FT_Get_Char_Index(ftFaces_[face], codepoint) != 0)) {
+                break;
+            }
+            end++;
+        }
+        
+        hb_buffer_clear_contents(hbBuffer_);
+        hb_buffer_add_codepoints(hbBuffer_, reinterpret_cast<const hb_codepoint_t*>(codepoints),
+                                 static_cast<int>(count), static_cast<unsigned int>(start), static_cast<int>(end - start));
+        hb_buffer_guess_segment_properties(hbBuffer_);
+        hb_shape(hbFonts_[face], hbBuffer_, nullptr, 0);
+        
+        unsigned int glyphCount = 0;
+        const hb_glyph_info_t* infos = hb_buffer_get_glyph_infos(hbBuffer_, &glyphCount);
+        const hb_glyph_position_t* positions = hb_buffer_get_glyph_positions(hbBuffer_, &glyphCount);
+        
+        // Pen positions are 26.6 and restart at each cluster so text stays on the cell grid
+        hb_position_t pen = 0;
+        hb_position_t clusterPen = 0;
+        uint32_t cluster = UINT32_MAX;
+        for (unsigned int i = 0; i < glyphCount; ++i) {
+            if (infos[i].cluster != cluster) {
+                cluster = infos[i].cluster;
+                clusterPen = pen;
+            }
+            GlyphSource nominal = resolveGlyph(codepoints[cluster]);
+            bool isNominal = nominal.face == face && nominal.glyphIndex == infos[i].codepoint;
+            out.push_back({isNominal ? codepoints[cluster] : NO_CODEPOINT, face, infos[i].codepoint, cluster,
+                           (pen - clusterPen + positions[i].x_offset) / 64.0f, positions[i].y_offset / 64.0f});
+            pen += positions[i].x_advance;
+        }
+        start = end;
+    }
+}
+#endif
+
+void FontRenderer::renderShapedGlyph(float x, float y, const ShapedGlyph& glyph, uint32_t color) {
+    // Nominal glyphs go through the direct codepoint table
+    const AtlasGlyph* atlasGlyph = glyph.codepoint != NO_CODEPOINT ? getGlyph(glyph.codepoint)
+                                                                     : getGlyphById(glyph.face, glyph.glyphIndex);
+    if (atlasGlyph) {
+        // Shaping offsets point up, screen y down
+        renderGlyph(x + glyph.x * scale_, y - glyph.y * scale_, *atlasGlyph, color);
+    }
+}
+
+FontRenderer::GlyphSource FontRenderer::resolveGlyph(char32_t codepoint) {
+    const GlyphSource* cached = glyphSources_.find(codepoint);
+    if (cached) {
+        return *cached;
+    }
+    
+    // First face in the chain that maps the codepoint, else the primary face's .notdef box
+    GlyphSource source{0, 0};
+    for (uint32_t i = 0; i < ftFaces_.size(); ++i) {
+        FT_UInt glyphIndex = FT_Get_Char_Index(ftFaces_[i], codepoint);
+        if (glyphIndex != 0) {
+            source = {i, glyphIndex};
+            break;
+        }
+    }
+    glyphSources_.insert(codepoint, source);
+    return source;
+}
+
+void FontRenderer::insertGlyph(const RasterizedGlyph& rasterized) {
+    char32_t codepoint = rasterized.codepoint;
+    uint64_t key = makeGlyphKey(rasterized.face, rasterized.glyphIndex);
+    
+    auto placed = glyphsById_.find(key);
+    if (placed != glyphsById_.end()) {
+        storeGlyph(codepoint, key, placed->second);
         return;
     }
     
-    if (FT_Load_Char(ftFace_, codepoint, FT_LOAD_RENDER)) {
+    if (!rasterized.loaded) {
+        // Nothing to sample; kept out of the atlas cache so it is retried next run
         AtlasGlyph glyph{};
         glyph.u0 = 0.0f; glyph.v0 = 0.0f; glyph.u1 = 0.0f; glyph.v1 = 0.0f;
-        glyph.width = fontSize_ / 2;
-        glyph.height = fontSize_;
+        glyph.width = rasterSize_ / 2;
+        glyph.height = rasterSize_;
         glyph.bearingX = 0;
-        glyph.bearingY = fontSize_;
-        glyph.advance = fontSize_;
-        glyphs_[codepoint] = glyph;
+        glyph.bearingY = rasterSize_;
+        glyph.advance = rasterSize_;
+        glyph.page = NO_ATLAS_PAGE;
+        glyph.face = rasterized.face;
+        glyph.glyphIndex = rasterized.glyphIndex;
+        glyph.slot = NO_GLYPH_SLOT;
+        storeGlyph(codepoint, key, glyph);
         return;
     }
     
-    FT_GlyphSlot slot = ftFace_->glyph;
-    FT_Bitmap& bitmap = slot->bitmap;
-
-    if (bitmap.width == 0 || bitmap.rows == 0) {
+    if (rasterized.width == 0 || rasterized.height == 0) {
         AtlasGlyph glyph{};
+        glyph.face = rasterized.face;
+        glyph.glyphIndex = rasterized.glyphIndex;
+        glyph.slot = NO_GLYPH_SLOT;
         glyph.width = 0;
         glyph.height = 0;
-        glyph.bearingX = slot->bitmap_left;
-        glyph.bearingY = slot->bitmap_top;
-        glyph.advance = slot->advance.x >> 6;
-        glyphs_[codepoint] = glyph;
+        glyph.bearingX = rasterized.bearingX;
+        glyph.bearingY = rasterized.bearingY;
+        glyph.advance = rasterized.advance;
+        storeGlyph(codepoint, key, glyph);
         return;
     }
 
-    if (atlasX_ + bitmap.width > atlasWidth_) {
-        atlasX_ = 0;
-        atlasY_ += atlasRowHeight_;
-        atlasRowHeight_ = 0;
+    AtlasSet& set = rasterized.color ? colorAtlas_ : grayAtlas_;
+    
+    AtlasRegion region;
+    evictedKeys_.clear();
+    uint32_t paddedWidth = rasterized.width + GLYPH_PADDING * 2;
+    uint32_t paddedHeight = rasterized.height + GLYPH_PADDING * 2;
+    bool allocated = set.atlas.allocate(key, paddedWidth, paddedHeight, region, evictedKeys_);
+    forgetEvictedGlyphs();
+    bool fitsPage = paddedWidth <= set.atlas.getPageSize() && paddedHeight <= set.atlas.getPageSize();
+    if (!allocated && fitsPage) {
+        // Every page is still in use by a frame in flight; placed once one retires, see beginFrame()
+        deferredGlyphs_.emplace(key, rasterized);
+        return;
     }
-    if (atlasY_ + bitmap.rows > atlasHeight_) {
+    if (!allocated || !ensureAtlasPage(set, region.page)) {
+        // Larger than a page, or nothing to upload to; keep metrics so layout stays correct
         AtlasGlyph glyph{};
-        glyphs_[codepoint] = glyph; 
+        glyph.page = NO_ATLAS_PAGE;
+        glyph.face = rasterized.face;
+        glyph.glyphIndex = rasterized.glyphIndex;
+        glyph.slot = NO_GLYPH_SLOT;
+        glyph.bearingX = rasterized.bearingX;
+        glyph.bearingY = rasterized.bearingY;
+        glyph.advance = rasterized.advance;
+        storeGlyph(codepoint, key, glyph);
         return;
     }
 
-    std::vector<uint8_t> rgbaBitmap(bitmap.width * bitmap.rows * 4);
-    for (uint32_t y = 0; y < bitmap.rows; ++y) {
-        for (uint32_t x = 0; x < bitmap.width; ++x) {
-            uint8_t alpha = bitmap.buffer[y * bitmap.pitch + x];
-            rgbaBitmap[(y * bitmap.width + x) * 4 + 0] = 255;
-            rgbaBitmap[(y * bitmap.width + x) * 4 + 1] = 255;
-            rgbaBitmap[(y * bitmap.width + x) * 4 + 2] = 255;
-            rgbaBitmap[(y * bitmap.width + x) * 4 + 3] = alpha;
-        }
+    // Copy into a buffer with a zeroed border so stale pixels of evicted glyphs never show
+    std::vector<uint8_t> pixels(paddedWidth * paddedHeight * set.bytesPerPixel, 0);
+    size_t rowBytes = rasterized.width * set.bytesPerPixel;
+    for (uint32_t y = 0; y < rasterized.height; ++y) {
+        memcpy(pixels.data() + ((y + GLYPH_PADDING) * paddedWidth + GLYPH_PADDING) * set.bytesPerPixel,
+               rasterized.pixels.data() + y * rowBytes, rowBytes);
     }
     
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    renderer_->createBuffer(bitmap.width * bitmap.rows * 4, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-
-    void* data;
-    vkMapMemory(device_, stagingBufferMemory, 0, bitmap.width * bitmap.rows * 4, 0, &data);
-    memcpy(data, rgbaBitmap.data(), bitmap.width * bitmap.rows * 4);
-    vkUnmapMemory(device_, stagingBufferMemory);
+    // Recorded into the frame's command buffer together with every other miss of this frame
+    AtlasPage& page = set.pages[region.page];
+    renderer_->queueImageUpload(page.image, region.x, region.y, paddedWidth, paddedHeight, pixels.data(), set.bytesPerPixel);
+    
+    size_t pageStride = set.atlas.getPageSize() * set.bytesPerPixel;
+    size_t paddedRowBytes = paddedWidth * set.bytesPerPixel;
+    for (uint32_t y = 0; y < paddedHeight; ++y) {
+        memcpy(page.pixels.data() + (region.y + y) * pageStride + region.x * set.bytesPerPixel,
+               pixels.data() + y * paddedRowBytes, paddedRowBytes);
+    }
+    cacheDirty_ = true;
+    
+    float pageSize = static_cast<float>(set.atlas.getPageSize());
+    uint32_t innerX = region.x + GLYPH_PADDING;
+    uint32_t innerY = region.y + GLYPH_PADDING;
+    
+    AtlasGlyph glyph{};
+    glyph.u0 = innerX / pageSize;
+    glyph.v0 = innerY / pageSize;
+    glyph.u1 = (innerX + rasterized.width) / pageSize;
+    glyph.v1 = (innerY + rasterized.height) / pageSize;
+    glyph.width = rasterized.width;
+    glyph.height = rasterized.height;
+    glyph.bearingX = rasterized.bearingX;
+    glyph.bearingY = rasterized.bearingY;
+    glyph.advance = rasterized.advance;
+    glyph.page = region.page;
+    glyph.face = rasterized.face;
+    glyph.glyphIndex = rasterized.glyphIndex;
+    glyph.color = rasterized.color;
+    
+    // Bitmap fonts come in fixed strikes; scale them down to the line height
+    bool fixedStrike = !FT_IS_SCALABLE(ftFaces_[rasterized.face]);
+    if ((glyph.color || fixedStrike) && glyph.height > baseLineHeight_ && baseLineHeight_ > 0) {
+        float scale = static_cast<float>(baseLineHeight_) / glyph.height;
+        glyph.width = static_cast<uint32_t>(glyph.width * scale);
+        glyph.height = baseLineHeight_;
+        glyph.bearingX = static_cast<int32_t>(glyph.bearingX * scale);
+        glyph.bearingY = static_cast<int32_t>(glyph.bearingY * scale);
+        glyph.advance = static_cast<uint32_t>(glyph.advance * scale);
+    }
+    glyph.slot = allocateSlot();
+    writeSlot(glyph);
+    storeGlyph(codepoint, key, glyph);
+}
 
-    VkCommandBuffer cmd = renderer_->beginSingleTimeCommands();
-    VkBufferImageCopy region{};
-    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    region.imageSubresource.layerCount = 1;
-    region.imageOffset = { (int32_t)atlasX_, (int32_t)atlasY_, 0 };
-    region.imageExtent = { bitmap.width, bitmap.rows, 1 };
-    vkCmdCopyBufferToImage(cmd, stagingBuffer, atlasImage_, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-    renderer_->endSingleTimeCommands(cmd);
+void FontRenderer::storeGlyph(char32_t codepoint, uint64_t key, const AtlasGlyph& glyph) {
+    glyphsById_[key] = glyph;
+    if (codepoint != NO_CODEPOINT) {
+        glyphs_.insert(codepoint, glyph);
+    }
+}
 
-    vkDestroyBuffer(device_, stagingBuffer, nullptr);
-    vkFreeMemory(device_, stagingBufferMemory, nullptr);
+void FontRenderer::forgetEvictedGlyphs() {
+    if (evictedKeys_.empty()) {
+        return;
+    }
+    glyphGeneration_++;
     
-    AtlasGlyph glyph{};
-    glyph.u0 = (float)atlasX_ / atlasWidth_;
-    glyph.v0 = (float)atlasY_ / atlasHeight_;
-    glyph.u1 = (float)(atlasX_ + bitmap.width) / atlasWidth_;
-    glyph.v1 = (float)(atlasY_ + bitmap.rows) / atlasHeight_;
-    glyph.width = bitmap.width;
-    glyph.height = bitmap.rows;
-    glyph.bearingX = slot->bitmap_left;
-    glyph.bearingY = slot->bitmap_top;
-    glyph.advance = slot->advance.x >> 6;
-    glyphs_[codepoint] = glyph;
+    for (uint64_t key : evictedKeys_) {
+        auto it = glyphsById_.find(key);
+        if (it == glyphsById_.end()) {
+            continue;
+        }
+        if (it->second.slot != NO_GLYPH_SLOT) {
+            freeSlots_.push_back(it->second.slot);
+        }
+        glyphsById_.erase(it);
+    }
+    
+    // Several codepoints can share an atlas entry, so sweep the table. Evictions
+    // only happen once every page is full, so this stays off the common path.
+    std::unordered_set<uint64_t> evicted(evictedKeys_.begin(), evictedKeys_.end());
+    std::vector<char32_t> stale;
+    glyphs_.forEach([&](char32_t codepoint, const AtlasGlyph& glyph) {
+        if (glyph.width > 0 && glyph.page != NO_ATLAS_PAGE && evicted.count(makeGlyphKey(glyph.face, glyph.glyphIndex))) {
+            stale.push_back(codepoint);
+        }
+    });
+    for (char32_t codepoint : stale) {
+        glyphs_.erase(codepoint);
+    }
+}
 
-    atlasX_ += bitmap.width;
-    atlasRowHeight_ = std::max(atlasRowHeight_, bitmap.rows);
+uint32_t FontRenderer::allocateSlot() {
+    if (!freeSlots_.empty()) {
+        uint32_t slot = freeSlots_.back();
+        freeSlots_.pop_back();
+        return slot;
+    }
+    // Without a slot the glyph is skipped like one that didn't fit into the atlas
+    return nextSlot_ < MAX_GLYPH_SLOTS ? nextSlot_++ : NO_GLYPH_SLOT;
+}
+
+void FontRenderer::writeSlot(const AtlasGlyph& glyph) {
+    if (!renderer_ || glyph.slot == NO_GLYPH_SLOT) {
+        return;
+    }
+    GlyphSlot data{};
+    data.u0 = glyph.u0;
+    data.v0 = glyph.v0;
+    data.u1 = glyph.u1;
+    data.v1 = glyph.v1;
+    // Pens are at the top of the line; the glyph's top is bearingY above the baseline
+    data.x = glyph.bearingX * scale_;
+    data.y = (static_cast<float>(baseAscent_) - glyph.bearingY) * scale_;
+    data.width = glyph.width * scale_;
+    data.height = glyph.height * scale_;
+    renderer_->setGlyphSlot(glyph.slot, data);
 }
 
 void FontRenderer::renderCharacter(float x, float y, char32_t c, float r, float g, float b) {
     if (!renderer_) return;
     
     AtlasGlyph* glyph = getGlyph(c);
-    if (glyph && glyph->width > 0 && glyph->height > 0) {
-        float glyphX = x + glyph->bearingX;
-        float glyphY = y - (glyph->height - glyph->bearingY);
-        
-        renderer_->renderQuad(
-            glyphX, glyphY,
-            static_cast<float>(glyph->width),
-            static_cast<float>(glyph->height),
-            atlasView_, // Use the atlas texture view
-            r, g, b, 1.0f,
-            glyph->u0, glyph->v0, glyph->u1, glyph->v1 // Pass texture coordinates
-        );
+    if (glyph) {
+        renderGlyph(x, y, *glyph, r, g, b);
     }
 }
 
+void FontRenderer::renderGlyph(float x, float y, const AtlasGlyph& glyph, float r, float g, float b) {
+    renderGlyph(x, y, glyph, packColor(r, g, b));
+}
+
+void FontRenderer::renderGlyph(float x, float y, const AtlasGlyph& glyph, uint32_t color) {
+    if (!renderer_ || glyph.width == 0 || glyph.height == 0 || glyph.slot == NO_GLYPH_SLOT) {
+        return;
+    }
+    
+    AtlasSet& set = glyph.color ? colorAtlas_ : grayAtlas_;
+    if (glyph.page >= set.pages.size()) {
+        return;
+    }
+    set.atlas.touch(glyph.page);
+    
+    // Color glyphs keep their own colors: their atlas is drawn with the color glyph pipeline, which ignores the tint
+    renderer_->renderGlyph(x, y, glyph.slot, set.pages[glyph.page].view, color);
+}
+
 void FontRenderer::renderString(float x, float y, const std::string& text, float r, float g, float b) {
     if (!renderer_) return;
     
     float currentX = x;
+    uint32_t color = packColor(r, g, b);
     
     for (char c : text) {
         // This is not UTF-8 safe, but it's what the old code did.
@@ -182,8 +653,8 @@ void FontRenderer::renderString(float x, float y, const std::string& text, float
         // For now, we assume ASCII for renderString for UI elements.
         AtlasGlyph* glyph = getGlyph(static_cast<char32_t>(c));
         if (glyph) {
-            renderCharacter(currentX, y, static_cast<char32_t>(c), r, g, b);
-            currentX += glyph->advance;
+            renderGlyph(currentX, y, *glyph, color);
+            currentX += glyph->advance * scale_;
         }
     }
 }
@@ -191,28 +662,196 @@ void FontRenderer::renderString(float x, float y, const std::string& text, float
 uint32_t FontRenderer::getTextWidth(const std::string& text) const {
     uint32_t width = 0;
     for (char c : text) {
-        auto it = glyphs_.find(static_cast<char32_t>(c));
-        if (it != glyphs_.end()) {
-            width += it->second.advance;
+        const AtlasGlyph* glyph = glyphs_.find(static_cast<char32_t>(c));
+        if (glyph) {
+            width += glyph->advance;
         }
     }
-    return width;
+    return static_cast<uint32_t>(width * scale_ + 0.5f);
 }
 
-void FontRenderer::initAtlas() {
-    if (!renderer_) return;
-    std::vector<unsigned char> emptyData(atlasWidth_ * atlasHeight_ * 4, 0); // Transparent black
-    renderer_->createTexture(atlasWidth_, atlasHeight_, emptyData.data(), atlasImage_, atlasMemory_, atlasView_);
+bool FontRenderer::ensureAtlasPage(AtlasSet& set, uint32_t page) {
+    if (!renderer_) return false;
+    if (page < set.pages.size()) return true;
+    
+    uint32_t pageSize = set.atlas.getPageSize();
+    std::vector<unsigned char> emptyData(pageSize * pageSize * set.bytesPerPixel, 0); // Transparent black
+    while (set.pages.size() <= page) {
+        AtlasPage newPage;
+        renderer_->createTexture(pageSize, pageSize, emptyData.data(), newPage.image, newPage.memory, newPage.view, set.format);
+        if (set.distanceField) {
+            renderer_->setTextureMode(newPage.view, TextureMode::DistanceField);
+        }
+        newPage.pixels = emptyData;
+        set.pages.push_back(std::move(newPage));
+    }
+    return true;
 }
 
-void FontRenderer::cleanup() {
-    if (renderer_ && atlasView_ != VK_NULL_HANDLE) {
-        renderer_->destroyTexture(atlasImage_, atlasMemory_, atlasView_);
-        atlasImage_ = VK_NULL_HANDLE;
-        atlasMemory_ = VK_NULL_HANDLE;
-        atlasView_ = VK_NULL_HANDLE;
+void FontRenderer::destroyAtlasPages(AtlasSet& set) {
+    if (renderer_) {
+        // Released once the frames in flight that may still sample them are done
+        for (auto& page : set.pages) {
+            renderer_->destroyTexture(page.image, page.memory, page.view);
+        }
     }
+    set.pages.clear();
+    set.atlas.clear();
+}
+
+void FontRenderer::cleanup() {
+    destroyAtlasPages(grayAtlas_);
+    destroyAtlasPages(colorAtlas_);
     glyphs_.clear();
+    glyphSources_.clear();
+    glyphsById_.clear();
+    shapedRuns_.clear();
+    pendingGlyphs_.clear();
+    pendingGlyphIds_.clear();
+    deferredGlyphs_.clear();
+    freeSlots_.clear();
+    nextSlot_ = 0;
+    glyphGeneration_++;
+}
+
+bool FontRenderer::loadAtlasCache() {
+    if (cachePath_.empty() || !renderer_) {
+        return false;
+    }
+    
+    MappedFile file;
+    if (!file.open(cachePath_)) {
+        return false;
+    }
+    
+    ByteReader reader(file.data(), file.size());
+    uint32_t magic, version, fontSize, lineHeight;
+    uint64_t options;
+    if (!reader.get(magic) || !reader.get(version) || !reader.get(options) || !reader.get(fontSize) || !reader.get(lineHeight) ||
+        magic != ATLAS_CACHE_MAGIC || version != ATLAS_CACHE_VERSION || options != cacheOptions_ || fontSize != rasterSize_) {
+        return false;
+    }
+    
+    uint32_t glyphCount;
+    if (!loadAtlasSet(grayAtlas_, reader) || !loadAtlasSet(colorAtlas_, reader) || !reader.get(glyphCount)) {
+        cleanup();
+        return false;
+    }
+    
+    // Glyphs by (face, glyph id), shaped ones included
+    for (uint32_t i = 0; i < glyphCount; ++i) {
+        AtlasGlyph glyph;
+        if (!reader.get(glyph) || glyph.face >= ftFaces_.size()) {
+            cleanup();
+            return false;
+        }
+        // Slots aren't kept across runs; updateScale() below writes them all
+        glyph.slot = glyph.width > 0 && glyph.height > 0 ? allocateSlot() : NO_GLYPH_SLOT;
+        glyphsById_[makeGlyphKey(glyph.face, glyph.glyphIndex)] = glyph;
+    }
+    
+    // Then the codepoints that map to them, which also carry their face resolution
+    uint32_t codepointCount;
+    if (!reader.get(codepointCount)) {
+        cleanup();
+        return false;
+    }
+    for (uint32_t i = 0; i < codepointCount; ++i) {
+        uint32_t codepoint;
+        GlyphSource source;
+        if (!reader.get(codepoint) || !reader.get(source)) {
+            cleanup();
+            return false;
+        }
+        auto placed = glyphsById_.find(makeGlyphKey(source.face, source.glyphIndex));
+        if (placed == glyphsById_.end()) {
+            cleanup();
+            return false;
+        }
+        glyphs_.insert(static_cast<char32_t>(codepoint), placed->second);
+        glyphSources_.insert(static_cast<char32_t>(codepoint), source);
+    }
+    
+    baseLineHeight_ = lineHeight;
+    updateScale();
+    cacheDirty_ = false;
+    return true;
 }
 
+bool FontRenderer::loadAtlasSet(AtlasSet& set, ByteReader& reader) {
+    uint32_t pageCount;
+    if (!set.atlas.load(reader) || !reader.get(pageCount) || pageCount != set.atlas.getPageCount()) {
+        return false;
+    }
+    
+    uint32_t pageSize = set.atlas.getPageSize();
+    size_t pageBytes = static_cast<size_t>(pageSize) * pageSize * set.bytesPerPixel;
+    for (uint32_t i = 0; i < pageCount; ++i) {
+        const uint8_t* pixels = reader.view(pageBytes);
+        if (!pixels) {
+            return false;
+        }
+        
+        // Uploaded straight from the mapping in a single copy
+        AtlasPage page;
+        renderer_->createTexture(pageSize, pageSize, pixels, page.image, page.memory, page.view, set.format);
+        if (set.distanceField) {
+            renderer_->setTextureMode(page.view, TextureMode::DistanceField);
+        }
+        page.pixels.assign(pixels, pixels + pageBytes);
+        set.pages.push_back(std::move(page));
+    }
+    return true;
+}
 
+void FontRenderer::saveAtlasCache() {
+    if (!cacheDirty_ || cachePath_.empty()) {
+        return;
+    }
+    cacheDirty_ = false;
+    
+    ByteWriter writer;
+    writer.put(ATLAS_CACHE_MAGIC);
+    writer.put(ATLAS_CACHE_VERSION);
+    writer.put(cacheOptions_);
+    writer.put(rasterSize_);
+    writer.put(baseLineHeight_);
+    
+    for (AtlasSet* set : {&grayAtlas_, &colorAtlas_}) {
+        set->atlas.save(writer);
+        writer.put(static_cast<uint32_t>(set->pages.size()));
+        for (const auto& page : set->pages) {
+            writer.putBytes(page.pixels.data(), page.pixels.size());
+        }
+    }
+    
+    // Every glyph by (face, glyph id), so shaped runs (ligatures) needn't be rasterized
+    // again either. Glyphs that didn't fit into the atlas are left out so they get
+    // another chance next run.
+    uint32_t glyphCount = 0;
+    for (const auto& [key, glyph] : glyphsById_) {
+        glyphCount += glyph.page != NO_ATLAS_PAGE;
+    }
+    writer.put(glyphCount);
+    for (const auto& [key, glyph] : glyphsById_) {
+        if (glyph.page != NO_ATLAS_PAGE) {
+            writer.put(glyph);
+        }
+    }
+    
+    uint32_t codepointCount = 0;
+    glyphs_.forEach([&](char32_t, const AtlasGlyph& glyph) {
+        codepointCount += glyph.page != NO_ATLAS_PAGE;
+    });
+    writer.put(codepointCount);
+    glyphs_.forEach([&](char32_t codepoint, const AtlasGlyph& glyph) {
+        if (glyph.page != NO_ATLAS_PAGE) {
+            writer.put(static_cast<uint32_t>(codepoint));
+            writer.put(GlyphSource{glyph.face, glyph.glyphIndex});
+        }
+    });
+    
+    if (!writeCacheFile(cachePath_, writer.getBytes())) {
+        std::cerr << "Warning: failed to write glyph atlas cache " << cachePath_ << std::endl;
+    }
+}
@@ -1,14 +1,34 @@
 #pragma once
 
 #include <vulkan/vulkan.h>
+#include "device_allocator.hpp"
+#include "glyph_atlas.hpp"
+#include "glyph_rasterizer.hpp"
+#include "glyph_table.hpp"
+#include "text_shaper.hpp"
 #include <ft2build.h>
 #include FT_FREETYPE_H
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
+#include <memory>
 #include <vector>
 #include <cstdint>
 
 class VulkanRenderer;
+class ByteReader;
+#ifdef HYPERTERM_HAS_HARFBUZZ
+struct hb_font_t;
+struct hb_buffer_t;
+#endif
+
+constexpr uint32_t NO_ATLAS_PAGE = UINT32_MAX;
+constexpr uint32_t NO_GLYPH_SLOT = UINT32_MAX;
+
+enum class GlyphRenderMode {
+    Bitmap,         // Rasterized at the display size; crispest at small sizes
+    DistanceField   // Rasterized once at a reference size, edges rebuilt in the shader at any scale
+};
 
 struct AtlasGlyph {
     float u0, v0, u1, v1; // Texture coordinates in the atlas
@@ -17,6 +37,11 @@ struct AtlasGlyph {
     int32_t bearingX;
     int32_t bearingY;
     uint32_t advance;
+    uint32_t page;        // Atlas page holding the bitmap, NO_ATLAS_PAGE if it didn't fit
+    uint32_t face;        // Face in the fallback chain the glyph came from
+    uint32_t glyphIndex;  // Glyph id within that face; (face, glyphIndex) keys the atlas
+    uint32_t slot;        // In the renderer's glyph slot table while placed, else NO_GLYPH_SLOT
+    bool color;           // Lives in the RGBA color atlas rather than the coverage atlas
 };
 
 class FontRenderer {
@@ -27,14 +52,56 @@ public:
     bool loadFont(const std::string& fontPath, uint32_t fontSize);
     void cleanup();
     
+    // Faces tried in order for codepoints the primary font lacks; takes effect on the next loadFont()
+    void setFallbackFonts(const std::vector<std::string>& fontPaths) { fallbackPaths_ = fontPaths; }
+    
+    // Takes effect on the next loadFont()
+    void setRenderMode(GlyphRenderMode mode) { renderMode_ = mode; }
+    GlyphRenderMode getRenderMode() const { return renderMode_; }
+    
+    // Distance-field fonts are rescaled in place; bitmap fonts are reloaded at the new size
+    bool setFontSize(uint32_t fontSize);
+    uint32_t getFontSize() const { return fontSize_; }
+    
     AtlasGlyph* getGlyph(char32_t codepoint);
     void renderString(float x, float y, const std::string& text, float r = 1.0f, float g = 1.0f, float b = 1.0f);
     void renderCharacter(float x, float y, char32_t c, float r = 1.0f, float g = 1.0f, float b = 1.0f);
+    void renderGlyph(float x, float y, const AtlasGlyph& glyph, float r = 1.0f, float g = 1.0f, float b = 1.0f);
+    // Color packed as RGBA8, see packColor()
+    void renderGlyph(float x, float y, const AtlasGlyph& glyph, uint32_t color);
+    
+    // Glyphs produced by shaping rather than by codepoint (ligatures, conjuncts)
+    const AtlasGlyph* getGlyphById(uint32_t face, uint32_t glyphIndex);
+    
+    // Shape a run of codepoints that share one style. Results are cached, so
+    // rows that didn't change reuse last frame's glyphs and positions.
+    const std::vector<ShapedGlyph>& shapeRun(const char32_t* codepoints, size_t count, uint32_t style = 0);
+    void renderShapedGlyph(float x, float y, const ShapedGlyph& glyph, uint32_t color);
     
     uint32_t getTextWidth(const std::string& text) const;
     uint32_t getLineHeight() const { return lineHeight_; }
     
-    void setRenderer(VulkanRenderer* renderer) { renderer_ = renderer; }
+    void setRenderer(VulkanRenderer* renderer);
+    
+    // Advances the glyph usage stamp and takes in glyphs the pool finished;
+    // call once per frame before rendering
+    void beginFrame();
+    bool hasPendingGlyphs() const { return !pendingGlyphs_.empty() || !pendingGlyphIds_.empty() || !deferredGlyphs_.empty(); }
+    // Placeholders drawn so far for glyphs still being rasterized. Text drawn
+    // while this went up should be drawn again next frame, when its glyphs
+    // have either arrived or are rasterized on the spot, a few per frame.
+    uint64_t getPlaceholderCount() const { return placeholderCount_; }
+    // Text and color atlases are counted apart, so color page thrash doesn't hide behind text hits
+    GlyphCacheStats getGlyphCacheStats() const { return grayAtlas_.atlas.getStats(); }
+    GlyphCacheStats getColorGlyphCacheStats() const { return colorAtlas_.atlas.getStats(); }
+    
+    // Changes whenever glyphs drawn earlier may look different if drawn again:
+    // glyphs were evicted, rescaled or reloaded. Recorded draws are stale after
+    // it. Glyphs arriving don't change it; see getPlaceholderCount().
+    uint64_t getGlyphGeneration() const { return glyphGeneration_; }
+    // Keeps the atlas pages behind these views from eviction, for glyphs drawn
+    // this frame without going through renderGlyph()
+    void touchPages(const std::vector<VkImageView>& views);
     
 private:
     VkDevice device_;
@@ -42,27 +109,105 @@ private:
     VkQueue graphicsQueue_;
     VkCommandPool commandPool_;
     
-    std::unordered_map<char32_t, AtlasGlyph> glyphs_;
+    // Glyph metrics are stored at rasterSize_ and scaled by scale_ when drawn
+    GlyphTable<AtlasGlyph> glyphs_;
     uint32_t fontSize_;
     uint32_t lineHeight_;
+    GlyphRenderMode renderMode_;
+    uint32_t rasterSize_;
+    uint32_t baseLineHeight_;
+    int32_t baseAscent_; // Baseline below the top of the line, at rasterSize_
+    float scale_;
     std::string fontPath_;
+    std::vector<std::string> fallbackPaths_;
     
     FT_Library ftLibrary_;
-    FT_Face ftFace_;
+    std::vector<FT_Face> ftFaces_;       // Primary face first, then the fallbacks that loaded
+    std::vector<std::string> facePaths_; // Paths of ftFaces_, as handed to the rasterizer pool
     VulkanRenderer* renderer_;
     
+    struct GlyphSource {
+        uint32_t face;
+        uint32_t glyphIndex;
+    };
+    
+    // Codepoint to face resolution, probed once per codepoint for the life of the font
+    GlyphTable<GlyphSource> glyphSources_;
+    // Every glyph by (face, glyph id), shared by all codepoints that map to it
+    std::unordered_map<uint64_t, AtlasGlyph> glyphsById_;
+    
+    ShapedRunCache shapedRuns_;
+#ifdef HYPERTERM_HAS_HARFBUZZ
+    std::vector<hb_font_t*> hbFonts_; // One per entry of ftFaces_
+    hb_buffer_t* hbBuffer_ = nullptr;
+#endif
+    
     // Glyph atlas members
-    VkImage atlasImage_;
-    VkDeviceMemory atlasMemory_;
-    VkImageView atlasView_;
-    uint32_t atlasWidth_;
-    uint32_t atlasHeight_;
-    uint32_t atlasX_;
-    uint32_t atlasY_;
-    uint32_t atlasRowHeight_;
-    
-    void createGlyph(char32_t codepoint);
-    void createImage(uint32_t width, uint32_t height, const void* data, VkImage& image, VkDeviceMemory& memory, VkImageView& view);
-    void initAtlas();
+    struct AtlasPage {
+        VkImage image = VK_NULL_HANDLE;
+        MemoryAllocation memory;
+        VkImageView view = VK_NULL_HANDLE;
+        std::vector<uint8_t> pixels; // CPU copy, persisted by the on-disk atlas cache
+    };
+    
+    // Text glyphs are stored as 8-bit coverage; color glyphs (emoji) get their own RGBA pages
+    struct AtlasSet {
+        GlyphAtlas atlas;
+        VkFormat format;
+        uint32_t bytesPerPixel;
+        bool distanceField = false;
+        std::vector<AtlasPage> pages;
+        
+        AtlasSet(uint32_t pageSize, uint32_t maxPages, VkFormat format, uint32_t bytesPerPixel)
+            : atlas(pageSize, maxPages), format(format), bytesPerPixel(bytesPerPixel) {}
+    };
+    
+    AtlasSet grayAtlas_;
+    AtlasSet colorAtlas_;
+    std::vector<uint64_t> evictedKeys_;
+    
+    // Slots of placed glyphs; released on eviction and reused
+    std::vector<uint32_t> freeSlots_;
+    uint32_t nextSlot_ = 0;
+    uint64_t glyphGeneration_ = 0;
+    
+    // Misses in flight on the rasterizer pool, with the frame they were requested in
+    std::unique_ptr<GlyphRasterizer> rasterizer_;
+    std::unordered_map<char32_t, uint64_t> pendingGlyphs_;
+    std::unordered_map<uint64_t, uint64_t> pendingGlyphIds_;
+    std::vector<RasterizedGlyph> completedGlyphs_;
+    uint64_t placeholderCount_ = 0;
+    uint32_t syncRasterizations_ = 0; // This frame, see MAX_SYNC_RASTERIZATIONS
+    
+    // Rasterized glyphs waiting for a page that no frame in flight uses; drawn as placeholders
+    std::unordered_map<uint64_t, RasterizedGlyph> deferredGlyphs_;
+    AtlasGlyph blankGlyph_{}; // Placeholder while .notdef itself is deferred
+    
+    // On-disk atlas cache for the current font
+    std::string cachePath_;
+    uint64_t cacheOptions_ = 0;
+    bool cacheDirty_ = false;
+    
+    bool loadAtlasCache();
+    void saveAtlasCache();
+    bool loadAtlasSet(AtlasSet& set, ByteReader& reader);
+    AtlasGlyph* getPlaceholder();
+    AtlasGlyph* rasterizeMiss(char32_t codepoint, uint32_t face, uint32_t glyphIndex);
+    AtlasGlyph* rasterizeNow(char32_t codepoint, uint32_t face, uint32_t glyphIndex);
+    void insertGlyph(const RasterizedGlyph& rasterized);
+    void storeGlyph(char32_t codepoint, uint64_t key, const AtlasGlyph& glyph);
+    void forgetEvictedGlyphs();
+    uint32_t allocateSlot();
+    void writeSlot(const AtlasGlyph& glyph);
+    void shapeNominal(const char32_t* codepoints, size_t count, std::vector<ShapedGlyph>& out);
+#ifdef HYPERTERM_HAS_HARFBUZZ
+    void shapeWithHarfBuzz(const char32_t* codepoints, size_t count, std::vector<ShapedGlyph>& out);
+#endif
+    GlyphSource resolveGlyph(char32_t codepoint);
+    void closeFaces();
+    void updateScale();
+    void createImage(uint32_t width, uint32_t height, const void* data, VkImage& image, MemoryAllocation& memory, VkImageView& view);
+    bool ensureAtlasPage(AtlasSet& set, uint32_t page);
+    void destroyAtlasPages(AtlasSet& set);
 };
 
@@ -0,0 +1,26 @@
+#include "frame_pacer.hpp"
+#include <cmath>
+
+FramePacer::FramePacer(double refreshPeriod, double margin) : period_(refreshPeriod), margin_(margin) {
+}
+
+void FramePacer::setRefreshPeriod(double seconds) {
+    if (seconds > 0.0) {
+        period_ = seconds;
+    }
+}
+
+void FramePacer::setVblank(double time) {
+    vblank_ = time;
+    hasVblank_ = true;
+}
+
+double FramePacer::getLatchTime(double now) const {
+    if (!hasVblank_ || period_ <= 0.0) {
+        return now;
+    }
+    // Whole refresh periods from the known vblank to the first usable one; the
+    // slack keeps a latch time that is exactly now from rounding a period later
+    double periods = std::ceil((now + margin_ - vblank_) / period_ - 1e-6);
+    return vblank_ + periods * period_ - margin_;
+}
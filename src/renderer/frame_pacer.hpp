@@ -0,0 +1,30 @@
+#pragma once
+
+// Decides when to start recording a frame so it is built as late as possible
+// before the vblank it is meant for ("late latch"). PTY output and input that
+// arrive while waiting still make it into that frame. Times are in seconds
+// on one monotonic clock.
+class FramePacer {
+public:
+    explicit FramePacer(double refreshPeriod = 1.0 / 60.0, double margin = 0.004);
+
+    void setRefreshPeriod(double seconds);
+    // Time needed to record, submit and render a frame before its vblank
+    void setMargin(double seconds) { margin_ = seconds; }
+    double getMargin() const { return margin_; }
+
+    // A time the display is known to have refreshed at, e.g. an actual present time
+    void setVblank(double time);
+    bool hasVblank() const { return hasVblank_; }
+
+    // Margin before the first vblank that is at least a margin away. Without a
+    // known vblank the phase is unknown and waiting would only add latency, so
+    // the answer is now.
+    double getLatchTime(double now) const;
+
+private:
+    double period_;
+    double margin_;
+    double vblank_ = 0.0;
+    bool hasVblank_ = false;
+};
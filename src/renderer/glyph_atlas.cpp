@@ -0,0 +1,249 @@
+#include "glyph_atlas.hpp"
+#include "atlas_cache.hpp"
+#include <algorithm>
+#include <limits>
+
+SkylinePacker::SkylinePacker(uint32_t width, uint32_t height)
+    : width_(width), height_(height), usedArea_(0) {
+    reset();
+}
+
+void SkylinePacker::reset() {
+    skyline_.clear();
+    skyline_.push_back({0, 0, width_});
+    usedArea_ = 0;
+}
+
+bool SkylinePacker::fits(size_t index, uint32_t width, uint32_t height, uint32_t& outY) const {
+    uint32_t x = skyline_[index].x;
+    if (x + width > width_) {
+        return false;
+    }
+
+    // The rectangle rests on the highest segment it spans
+    uint32_t y = 0;
+    uint32_t remaining = width;
+    for (size_t i = index; i < skyline_.size() && remaining > 0; ++i) {
+        y = std::max(y, skyline_[i].y);
+        if (y + height > height_) {
+            return false;
+        }
+        remaining -= std::min(remaining, skyline_[i].width);
+    }
+
+    outY = y;
+    return true;
+}
+
+bool SkylinePacker::pack(uint32_t width, uint32_t height, uint32_t& outX, uint32_t& outY) {
+    if (width == 0 || height == 0 || width > width_ || height > height_) {
+        return false;
+    }
+
+    size_t bestIndex = skyline_.size();
+    uint32_t bestBottom = std::numeric_limits<uint32_t>::max();
+    uint32_t bestWidth = std::numeric_limits<uint32_t>::max();
+    uint32_t bestY = 0;
+
+    for (size_t i = 0; i < skyline_.size(); ++i) {
+        uint32_t y;
+        if (!fits(i, width, height, y)) {
+            continue;
+        }
+        uint32_t bottom = y + height;
+        if (bottom < bestBottom || (bottom == bestBottom && skyline_[i].width < bestWidth)) {
+            bestIndex = i;
+            bestBottom = bottom;
+            bestWidth = skyline_[i].width;
+            bestY = y;
+        }
+    }
+
+    if (bestIndex == skyline_.size()) {
+        return false;
+    }
+
+    outX = skyline_[bestIndex].x;
+    outY = bestY;
+
+    // Raise the skyline under the new rectangle
+    Segment placed{outX, bestY + height, width};
+    skyline_.insert(skyline_.begin() + bestIndex, placed);
+
+    for (size_t i = bestIndex + 1; i < skyline_.size();) {
+        Segment& prev = skyline_[i - 1];
+        Segment& cur = skyline_[i];
+        uint32_t prevEnd = prev.x + prev.width;
+        if (cur.x >= prevEnd) {
+            break;
+        }
+        uint32_t shrink = prevEnd - cur.x;
+        if (cur.width <= shrink) {
+            skyline_.erase(skyline_.begin() + i);
+            continue;
+        }
+        cur.x += shrink;
+        cur.width -= shrink;
+        break;
+    }
+
+    // Merge neighbours at the same height
+    for (size_t i = 0; i + 1 < skyline_.size();) {
+        if (skyline_[i].y == skyline_[i + 1].y) {
+            skyline_[i].width += skyline_[i + 1].width;
+            skyline_.erase(skyline_.begin() + i + 1);
+        } else {
+            ++i;
+        }
+    }
+
+    usedArea_ += static_cast<uint64_t>(width) * height;
+    return true;
+}
+
+void SkylinePacker::save(ByteWriter& writer) const {
+    writer.put(usedArea_);
+    writer.put(static_cast<uint32_t>(skyline_.size()));
+    for (const auto& segment : skyline_) {
+        writer.put(segment);
+    }
+}
+
+bool SkylinePacker::load(ByteReader& reader) {
+    uint32_t count;
+    if (!reader.get(usedArea_) || !reader.get(count) || count == 0 || count > width_) {
+        return false;
+    }
+
+    skyline_.resize(count);
+    uint32_t expectedX = 0;
+    for (auto& segment : skyline_) {
+        // Segments must tile the page width left to right
+        if (!reader.get(segment) || segment.x != expectedX || segment.y > height_ || segment.width > width_ - expectedX) {
+            reset();
+            return false;
+        }
+        expectedX += segment.width;
+    }
+    if (expectedX != width_) {
+        reset();
+        return false;
+    }
+    return true;
+}
+
+GlyphAtlas::GlyphAtlas(uint32_t pageSize, uint32_t maxPages, uint32_t safeFrames)
+    : pageSize_(pageSize), maxPages_(std::max(1u, maxPages)), safeFrames_(safeFrames), frame_(0) {
+    stats_.maxPages = maxPages_;
+}
+
+bool GlyphAtlas::allocate(uint64_t key, uint32_t width, uint32_t height, AtlasRegion& out, std::vector<uint64_t>& evicted) {
+    if (width > pageSize_ || height > pageSize_) {
+        return false;
+    }
+
+    auto place = [&](uint32_t pageIndex) {
+        Page& page = pages_[pageIndex];
+        uint32_t x, y;
+        if (!page.packer.pack(width, height, x, y)) {
+            return false;
+        }
+        page.keys.push_back(key);
+        page.lastUsed = frame_;
+        out = {pageIndex, x, y, width, height};
+        return true;
+    };
+
+    // Prefer the most recently opened pages; older pages are mostly full
+    for (size_t i = pages_.size(); i-- > 0;) {
+        if (place(static_cast<uint32_t>(i))) {
+            return true;
+        }
+    }
+
+    if (pages_.size() < maxPages_) {
+        pages_.emplace_back(pageSize_);
+        return place(static_cast<uint32_t>(pages_.size() - 1));
+    }
+
+    int victim = findEvictablePage();
+    if (victim < 0) {
+        return false; // Every page is still in use by a frame in flight
+    }
+
+    Page& page = pages_[victim];
+    evicted.insert(evicted.end(), page.keys.begin(), page.keys.end());
+    stats_.evictions += page.keys.size();
+    page.keys.clear();
+    page.packer.reset();
+
+    return place(static_cast<uint32_t>(victim));
+}
+
+int GlyphAtlas::findEvictablePage() const {
+    int victim = -1;
+    uint64_t oldest = std::numeric_limits<uint64_t>::max();
+    for (size_t i = 0; i < pages_.size(); ++i) {
+        const Page& page = pages_[i];
+        if (page.lastUsed + safeFrames_ >= frame_) {
+            continue;
+        }
+        if (page.lastUsed < oldest) {
+            oldest = page.lastUsed;
+            victim = static_cast<int>(i);
+        }
+    }
+    return victim;
+}
+
+void GlyphAtlas::clear() {
+    pages_.clear();
+}
+
+void GlyphAtlas::save(ByteWriter& writer) const {
+    writer.put(pageSize_);
+    writer.put(static_cast<uint32_t>(pages_.size()));
+    for (const auto& page : pages_) {
+        page.packer.save(writer);
+        writer.put(static_cast<uint32_t>(page.keys.size()));
+        writer.putBytes(page.keys.data(), page.keys.size() * sizeof(uint64_t));
+    }
+}
+
+bool GlyphAtlas::load(ByteReader& reader) {
+    clear();
+
+    uint32_t pageSize, pageCount;
+    if (!reader.get(pageSize) || !reader.get(pageCount) || pageSize != pageSize_ || pageCount > maxPages_) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < pageCount; ++i) {
+        Page page(pageSize_);
+        uint32_t keyCount;
+        if (!page.packer.load(reader) || !reader.get(keyCount)) {
+            clear();
+            return false;
+        }
+        page.keys.resize(keyCount);
+        if (!reader.getBytes(page.keys.data(), keyCount * sizeof(uint64_t))) {
+            clear();
+            return false;
+        }
+        pages_.push_back(std::move(page));
+    }
+    return true;
+}
+
+GlyphCacheStats GlyphAtlas::getStats() const {
+    GlyphCacheStats stats = stats_;
+    stats.pages = static_cast<uint32_t>(pages_.size());
+
+    uint64_t used = 0;
+    for (const auto& page : pages_) {
+        used += page.packer.getUsedArea();
+    }
+    uint64_t total = static_cast<uint64_t>(pageSize_) * pageSize_ * pages_.size();
+    stats.occupancy = total > 0 ? static_cast<float>(used) / static_cast<float>(total) : 0.0f;
+    return stats;
+}
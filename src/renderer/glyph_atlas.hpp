@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ByteWriter;
+class ByteReader;
+
+// Bottom-left skyline rectangle packer for a single atlas page
+class SkylinePacker {
+public:
+    SkylinePacker(uint32_t width, uint32_t height);
+
+    bool pack(uint32_t width, uint32_t height, uint32_t& outX, uint32_t& outY);
+    void reset();
+
+    uint64_t getUsedArea() const { return usedArea_; }
+    
+    void save(ByteWriter& writer) const;
+    bool load(ByteReader& reader);
+
+private:
+    struct Segment {
+        uint32_t x;
+        uint32_t y;
+        uint32_t width;
+    };
+
+    uint32_t width_;
+    uint32_t height_;
+    uint64_t usedArea_;
+    std::vector<Segment> skyline_;
+
+    bool fits(size_t index, uint32_t width, uint32_t height, uint32_t& outY) const;
+};
+
+struct AtlasRegion {
+    uint32_t page;
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+    uint32_t height;
+};
+
+struct GlyphCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    uint32_t pages = 0;
+    uint32_t maxPages = 0;
+    float occupancy = 0.0f; // Used area / allocated page area, 0..1
+};
+
+// Multi-page glyph atlas. Pages are packed with a skyline packer and evicted
+// as a whole, least recently used first, once every page is full. A page is
+// only evicted if none of its glyphs were touched in the last `safeFrames`
+// frames, so regions still referenced by in-flight command buffers are
+// never overwritten.
+class GlyphAtlas {
+public:
+    GlyphAtlas(uint32_t pageSize = 1024, uint32_t maxPages = 4, uint32_t safeFrames = 2);
+
+    // Reserve space for a glyph. Keys of glyphs dropped to make room are
+    // appended to `evicted`; the caller must forget them.
+    bool allocate(uint64_t key, uint32_t width, uint32_t height, AtlasRegion& out, std::vector<uint64_t>& evicted);
+
+    void beginFrame() { frame_++; }
+    void setSafeFrames(uint32_t safeFrames) { safeFrames_ = safeFrames; }
+    void touch(uint32_t page) { pages_[page].lastUsed = frame_; }
+    uint64_t getFrame() const { return frame_; }
+
+    void clear();
+
+    // Packing state and glyph keys of every page, for the on-disk atlas cache.
+    // Usage stamps and statistics are not persisted.
+    void save(ByteWriter& writer) const;
+    bool load(ByteReader& reader);
+
+    uint32_t getPageSize() const { return pageSize_; }
+    uint32_t getPageCount() const { return static_cast<uint32_t>(pages_.size()); }
+
+    void recordHit() { stats_.hits++; }
+    void recordMiss() { stats_.misses++; }
+    GlyphCacheStats getStats() const;
+
+private:
+    struct Page {
+        SkylinePacker packer;
+        std::vector<uint64_t> keys;
+        uint64_t lastUsed;
+
+        explicit Page(uint32_t size) : packer(size, size), lastUsed(0) {}
+    };
+
+    uint32_t pageSize_;
+    uint32_t maxPages_;
+    uint32_t safeFrames_;
+    uint64_t frame_;
+    std::vector<Page> pages_;
+    GlyphCacheStats stats_;
+
+    int findEvictablePage() const;
+};
@@ -0,0 +1,223 @@
+#include "glyph_rasterizer.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+void setFacePixelSize(FT_Face face, uint32_t pixelSize) {
+    if (FT_IS_SCALABLE(face) || !FT_HAS_FIXED_SIZES(face)) {
+        FT_Set_Pixel_Sizes(face, 0, pixelSize);
+        return;
+    }
+    
+    // Nearest strike, the larger one on a tie so glyphs are scaled down rather than up
+    int target = static_cast<int>(pixelSize);
+    FT_Int best = 0;
+    int bestDistance = INT32_MAX;
+    for (FT_Int i = 0; i < face->num_fixed_sizes; ++i) {
+        int size = static_cast<int>((face->available_sizes[i].y_ppem + 32) >> 6);
+        int distance = std::abs(size - target);
+        if (distance < bestDistance || (distance == bestDistance && size > target)) {
+            best = i;
+            bestDistance = distance;
+        }
+    }
+    FT_Select_Size(face, best);
+}
+
+void rasterizeGlyph(FT_Face face, uint32_t glyphIndex, RasterizedGlyph& out, bool distanceField) {
+    out.glyphIndex = glyphIndex;
+    out.loaded = false;
+    out.pixels.clear();
+
+    if (!face) {
+        return;
+    }
+
+    bool sdf = distanceField && GLYPH_SDF_SUPPORTED;
+    FT_Int32 loadFlags = sdf ? FT_LOAD_DEFAULT : FT_LOAD_RENDER;
+    if (FT_HAS_COLOR(face)) {
+        loadFlags |= FT_LOAD_COLOR;
+    }
+
+    if (FT_Load_Glyph(face, glyphIndex, loadFlags)) {
+        return;
+    }
+
+    FT_GlyphSlot slot = face->glyph;
+#if FREETYPE_MAJOR > 2 || (FREETYPE_MAJOR == 2 && FREETYPE_MINOR >= 11)
+    // Color bitmaps stay as they are; outlines and plain bitmaps become distance fields
+    bool colorBitmap = slot->format == FT_GLYPH_FORMAT_BITMAP && slot->bitmap.pixel_mode == FT_PIXEL_MODE_BGRA;
+    if (sdf && !colorBitmap && FT_Render_Glyph(slot, FT_RENDER_MODE_SDF)) {
+        return;
+    }
+#endif
+    FT_Bitmap& bitmap = slot->bitmap;
+
+    out.loaded = true;
+    out.color = bitmap.pixel_mode == FT_PIXEL_MODE_BGRA;
+    out.width = bitmap.width;
+    out.height = bitmap.rows;
+    out.bearingX = slot->bitmap_left;
+    out.bearingY = slot->bitmap_top;
+    out.advance = slot->advance.x >> 6;
+
+    if (bitmap.width == 0 || bitmap.rows == 0) {
+        return;
+    }
+
+    uint32_t bytesPerPixel = out.color ? 4 : 1;
+    out.pixels.resize(static_cast<size_t>(bitmap.width) * bitmap.rows * bytesPerPixel);
+
+    for (uint32_t y = 0; y < bitmap.rows; ++y) {
+        const uint8_t* src = bitmap.buffer + static_cast<ptrdiff_t>(y) * bitmap.pitch;
+        uint8_t* dst = out.pixels.data() + static_cast<size_t>(y) * bitmap.width * bytesPerPixel;
+
+        if (bitmap.pixel_mode == FT_PIXEL_MODE_MONO) {
+            for (uint32_t x = 0; x < bitmap.width; ++x) {
+                dst[x] = (src[x >> 3] & (0x80 >> (x & 7))) ? 255 : 0;
+            }
+        } else if (out.color) {
+            // FreeType color bitmaps are premultiplied BGRA; the pipeline blends straight RGBA
+            for (uint32_t x = 0; x < bitmap.width; ++x) {
+                uint8_t alpha = src[x * 4 + 3];
+                for (int c = 0; c < 3; ++c) {
+                    uint8_t value = src[x * 4 + 2 - c];
+                    dst[x * 4 + c] = alpha ? static_cast<uint8_t>(std::min(255, value * 255 / alpha)) : 0;
+                }
+                dst[x * 4 + 3] = alpha;
+            }
+        } else {
+            memcpy(dst, src, bitmap.width);
+        }
+    }
+}
+
+GlyphRasterizer::GlyphRasterizer(uint32_t workerCount) {
+    if (workerCount == 0) {
+        // Leave a core for the render thread; glyph bursts rarely need more than a few workers
+        uint32_t cores = std::thread::hardware_concurrency();
+        workerCount = std::clamp(cores > 1 ? cores - 1 : 1u, 1u, 4u);
+    }
+
+    for (uint32_t i = 0; i < workerCount; ++i) {
+        workers_.emplace_back(&GlyphRasterizer::workerLoop, this);
+    }
+}
+
+GlyphRasterizer::~GlyphRasterizer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    condition_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+void GlyphRasterizer::setFont(const std::vector<std::string>& fontPaths, uint32_t pixelSize, bool distanceField) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    fontPaths_ = fontPaths;
+    pixelSize_ = pixelSize;
+    distanceField_ = distanceField;
+    generation_++;
+    jobs_.clear();
+    results_.clear();
+}
+
+void GlyphRasterizer::request(char32_t codepoint, uint32_t face, uint32_t glyphIndex) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        jobs_.push_back({codepoint, face, glyphIndex, generation_});
+    }
+    condition_.notify_one();
+}
+
+void GlyphRasterizer::collect(std::vector<RasterizedGlyph>& out) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& result : results_) {
+        if (result.generation == generation_) {
+            out.push_back(std::move(result));
+        }
+    }
+    results_.clear();
+}
+
+void GlyphRasterizer::workerLoop() {
+    FT_Library library = nullptr;
+    std::vector<std::string> fontPaths;
+    std::vector<FT_Face> faces; // Opened on first use, null if the font failed to load
+    std::vector<bool> opened;
+    uint64_t faceGeneration = 0;
+
+    if (FT_Init_FreeType(&library)) {
+        return;
+    }
+
+    while (true) {
+        Job job;
+        uint32_t pixelSize;
+        bool distanceField;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            condition_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+            if (stopping_) {
+                break;
+            }
+            job = jobs_.front();
+            jobs_.pop_front();
+            if (job.generation != generation_) {
+                continue;
+            }
+            if (faceGeneration != job.generation) {
+                fontPaths = fontPaths_;
+            }
+            pixelSize = pixelSize_;
+            distanceField = distanceField_;
+        }
+
+        // Drop the old chain when the font changed since this worker last ran
+        if (faceGeneration != job.generation) {
+            for (FT_Face face : faces) {
+                if (face) {
+                    FT_Done_Face(face);
+                }
+            }
+            faces.assign(fontPaths.size(), nullptr);
+            opened.assign(fontPaths.size(), false);
+            faceGeneration = job.generation;
+        }
+
+        // Fallback faces are only opened once a glyph actually resolves to them
+        FT_Face face = nullptr;
+        if (job.face < faces.size()) {
+            if (!opened[job.face]) {
+                opened[job.face] = true;
+                if (FT_New_Face(library, fontPaths[job.face].c_str(), 0, &faces[job.face]) == 0) {
+                    setFacePixelSize(faces[job.face], pixelSize);
+                } else {
+                    faces[job.face] = nullptr;
+                }
+            }
+            face = faces[job.face];
+        }
+
+        RasterizedGlyph result;
+        result.codepoint = job.codepoint;
+        result.face = job.face;
+        result.generation = job.generation;
+        rasterizeGlyph(face, job.glyphIndex, result, distanceField);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (job.generation == generation_) {
+            results_.push_back(std::move(result));
+        }
+    }
+
+    for (FT_Face face : faces) {
+        if (face) {
+            FT_Done_Face(face);
+        }
+    }
+    FT_Done_FreeType(library);
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+// CPU-side result of rasterizing one glyph. Pixels are tightly packed: one
+// coverage byte per pixel, or straight (non-premultiplied) RGBA for color glyphs.
+struct RasterizedGlyph {
+    char32_t codepoint = 0;
+    uint32_t face = 0;        // Index into the font's fallback chain
+    uint32_t glyphIndex = 0;
+    uint64_t generation = 0;
+    bool loaded = false;  // False if FreeType could not load the glyph
+    bool color = false;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    int32_t bearingX = 0;
+    int32_t bearingY = 0;
+    uint32_t advance = 0;
+    std::vector<uint8_t> pixels;
+};
+
+// FT_RENDER_MODE_SDF first shipped with FreeType 2.11
+#if FREETYPE_MAJOR > 2 || (FREETYPE_MAJOR == 2 && FREETYPE_MINOR >= 11)
+constexpr bool GLYPH_SDF_SUPPORTED = true;
+#else
+constexpr bool GLYPH_SDF_SUPPORTED = false;
+#endif
+
+// Size a face for rasterizing at pixelSize. Bitmap-only faces such as color
+// emoji fonts come in fixed strikes and can't be scaled, so the strike nearest
+// to pixelSize is selected instead; the glyphs are scaled when placed.
+void setFacePixelSize(FT_Face face, uint32_t pixelSize);
+
+// Rasterize a single glyph by index from an already sized face. With
+// `distanceField` set, non-color glyphs are rendered as 8-bit signed distance
+// fields (edge at 128, inside brighter) instead of coverage.
+void rasterizeGlyph(FT_Face face, uint32_t glyphIndex, RasterizedGlyph& out, bool distanceField = false);
+
+// Pool of worker threads that rasterize glyph misses off the render thread.
+// Every worker owns its own FT_Library and faces, since FreeType objects
+// must not be shared between threads. Results are handed back through
+// collect(); results for a font that has since been replaced are dropped.
+class GlyphRasterizer {
+public:
+    explicit GlyphRasterizer(uint32_t workerCount = 0); // 0 picks a count from the hardware
+    ~GlyphRasterizer();
+
+    // Non-copyable
+    GlyphRasterizer(const GlyphRasterizer&) = delete;
+    GlyphRasterizer& operator=(const GlyphRasterizer&) = delete;
+
+    // Switch fonts; queued requests for the old font are discarded. `fontPaths`
+    // is the fallback chain, primary face first.
+    void setFont(const std::vector<std::string>& fontPaths, uint32_t pixelSize, bool distanceField = false);
+
+    // `face` indexes the fallback chain; the codepoint is passed back untouched
+    void request(char32_t codepoint, uint32_t face, uint32_t glyphIndex);
+    void collect(std::vector<RasterizedGlyph>& out);
+
+    uint32_t getWorkerCount() const { return static_cast<uint32_t>(workers_.size()); }
+
+private:
+    struct Job {
+        char32_t codepoint;
+        uint32_t face;
+        uint32_t glyphIndex;
+        uint64_t generation;
+    };
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    std::deque<Job> jobs_;
+    std::vector<RasterizedGlyph> results_;
+    std::vector<std::string> fontPaths_;
+    uint32_t pixelSize_ = 0;
+    bool distanceField_ = false;
+    uint64_t generation_ = 0;
+    bool stopping_ = false;
+
+    void workerLoop();
+};
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+
+// Codepoint-indexed table for per-cell glyph lookups. The BMP is split into
+// 256-entry blocks indexed directly by the high byte: block 0 (ASCII and
+// Latin-1) always exists, the others are allocated on first insert. Only
+// astral-plane codepoints go through a hash map, so the common lookup is a
+// block pointer load plus an entry load.
+template <typename T>
+class GlyphTable {
+public:
+    GlyphTable() { blocks_[0] = std::make_unique<Block>(); }
+
+    // Non-copyable
+    GlyphTable(const GlyphTable&) = delete;
+    GlyphTable& operator=(const GlyphTable&) = delete;
+
+    T* find(char32_t codepoint) {
+        return const_cast<T*>(static_cast<const GlyphTable*>(this)->find(codepoint));
+    }
+
+    const T* find(char32_t codepoint) const {
+        if (codepoint < BMP_END) {
+            const Block* block = blocks_[codepoint >> 8].get();
+            uint32_t index = codepoint & 0xFF;
+            return block && block->present[index] ? &block->values[index] : nullptr;
+        }
+        auto it = astral_.find(codepoint);
+        return it != astral_.end() ? &it->second : nullptr;
+    }
+
+    // Inserts or overwrites
+    T& insert(char32_t codepoint, const T& value) {
+        if (codepoint < BMP_END) {
+            std::unique_ptr<Block>& block = blocks_[codepoint >> 8];
+            if (!block) {
+                block = std::make_unique<Block>();
+            }
+            uint32_t index = codepoint & 0xFF;
+            if (!block->present[index]) {
+                block->present[index] = true;
+                size_++;
+            }
+            block->values[index] = value;
+            return block->values[index];
+        }
+        auto result = astral_.insert_or_assign(codepoint, value);
+        size_ += result.second;
+        return result.first->second;
+    }
+
+    void erase(char32_t codepoint) {
+        if (codepoint < BMP_END) {
+            Block* block = blocks_[codepoint >> 8].get();
+            uint32_t index = codepoint & 0xFF;
+            if (block && block->present[index]) {
+                block->present[index] = false;
+                size_--;
+            }
+            return;
+        }
+        size_ -= astral_.erase(codepoint);
+    }
+
+    // Keeps block 0 so the Latin-1 fast path never needs reallocating
+    void clear() {
+        blocks_[0]->present.reset();
+        for (size_t i = 1; i < blocks_.size(); ++i) {
+            blocks_[i].reset();
+        }
+        astral_.clear();
+        size_ = 0;
+    }
+
+    size_t size() const { return size_; }
+
+    // Calls fn(codepoint, value) for every entry, BMP first in codepoint order
+    template <typename Fn>
+    void forEach(Fn&& fn) const {
+        for (size_t high = 0; high < blocks_.size(); ++high) {
+            const Block* block = blocks_[high].get();
+            if (!block || block->present.none()) {
+                continue;
+            }
+            for (uint32_t index = 0; index < 256; ++index) {
+                if (block->present[index]) {
+                    fn(static_cast<char32_t>((high << 8) | index), block->values[index]);
+                }
+            }
+        }
+        for (const auto& entry : astral_) {
+            fn(entry.first, entry.second);
+        }
+    }
+
+private:
+    static constexpr char32_t BMP_END = 0x10000;
+
+    struct Block {
+        std::array<T, 256> values{};
+        std::bitset<256> present;
+    };
+
+    std::array<std::unique_ptr<Block>, 256> blocks_;
+    std::unordered_map<char32_t, T> astral_;
+    size_t size_ = 0;
+};
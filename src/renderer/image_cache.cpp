@@ -0,0 +1,223 @@
+#include "image_cache.hpp"
+#include "vulkan_renderer.hpp"
+#include <sys/stat.h>
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+#include <stdexcept>
+
+ImageCache::ImageCache(VulkanRenderer* renderer) : renderer_(renderer) {
+    worker_ = std::thread(&ImageCache::workerLoop, this);
+}
+
+ImageCache::~ImageCache() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    condition_.notify_all();
+    worker_.join();
+    clear();
+}
+
+bool ImageCache::isPathSafe(const std::string& path) {
+    // Check for empty path
+    if (path.empty()) {
+        return false;
+    }
+
+    // Check path length (prevent extremely long paths)
+    if (path.length() > 4096) {
+        return false;
+    }
+
+    // Check for null bytes (security risk)
+    if (path.find('\0') != std::string::npos) {
+        return false;
+    }
+
+    // Prevent absolute paths
+    if (path.rfind('/', 0) == 0) {
+        return false;
+    }
+
+    // Prevent directory traversal (.., ./.., /.., etc.)
+    if (path.find("..") != std::string::npos) {
+        return false;
+    }
+
+    // Prevent paths starting with ./
+    if (path.rfind("./", 0) == 0) {
+        return false;
+    }
+
+    // Only allow alphanumeric, dash, underscore, dot (for extension), and forward slash
+    for (char c : path) {
+        if (!std::isalnum(static_cast<unsigned char>(c)) &&
+            c != '-' && c != '_' && c != '.' && c != '/') {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+uint32_t ImageCache::acquire(const std::string& path, uint32_t maxWidth, uint32_t maxHeight) {
+    if (!isPathSafe(path)) {
+        std::cerr << "Error: background image path is not safe: " << path << std::endl;
+        return 0;
+    }
+
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) {
+        std::cerr << "Error: cannot open image: " << path << std::endl;
+        return 0;
+    }
+
+    // A file rewritten in place gets a new entry; the old one lives on until released
+    uint32_t bound = getSizeBucket(std::max(maxWidth, maxHeight));
+    std::string key = path + '\n' + std::to_string(static_cast<long long>(info.st_mtime)) + '\n' + std::to_string(bound);
+    auto found = index_.find(key);
+    if (found != index_.end()) {
+        entries_[found->second].refs++;
+        return found->second;
+    }
+
+    uint32_t id = nextId_++;
+    Entry& entry = entries_[id];
+    entry.key = key;
+    entry.bound = bound;
+    entry.refs = 1;
+    index_[key] = id;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        jobs_.push_back({id, path, bound, bound});
+    }
+    condition_.notify_one();
+    return id;
+}
+
+void ImageCache::release(uint32_t id) {
+    auto it = entries_.find(id);
+    if (it == entries_.end() || --it->second.refs > 0) {
+        return;
+    }
+
+    // A queued decode is cancelled; one already running is dropped when its result arrives
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        jobs_.erase(std::remove_if(jobs_.begin(), jobs_.end(), [id](const Job& job) { return job.id == id; }), jobs_.end());
+    }
+    index_.erase(it->second.key);
+    destroyEntry(it->second);
+    entries_.erase(it);
+}
+
+bool ImageCache::covers(uint32_t id, uint32_t width, uint32_t height) const {
+    auto it = entries_.find(id);
+    if (it == entries_.end()) {
+        return false;
+    }
+    // Nothing larger than the device limit can be created anyway
+    uint32_t bound = it->second.bound;
+    return bound >= maxDimension_ || (width <= bound && height <= bound);
+}
+
+uint32_t ImageCache::getSizeBucket(uint32_t size) {
+    if (maxDimension_ == 0) {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(renderer_->getPhysicalDevice(), &properties);
+        maxDimension_ = properties.limits.maxImageDimension2D;
+    }
+    uint32_t bucket = 512;
+    while (bucket < size && bucket < maxDimension_) {
+        bucket *= 2;
+    }
+    return std::min(bucket, maxDimension_);
+}
+
+VkImageView ImageCache::getView(uint32_t id) const {
+    auto it = entries_.find(id);
+    return it != entries_.end() ? it->second.view : VK_NULL_HANDLE;
+}
+
+bool ImageCache::update() {
+    std::vector<Result> results;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (results_.empty()) {
+            return false;
+        }
+        results.swap(results_);
+    }
+
+    bool uploaded = false;
+    for (const auto& result : results) {
+        auto it = entries_.find(result.id);
+        if (it == entries_.end() || !result.loaded) {
+            continue;
+        }
+        Entry& entry = it->second;
+        renderer_->createTexture(result.width, result.height, result.pixels.data(), entry.image, entry.memory, entry.view,
+                                 VK_FORMAT_R8G8B8A8_UNORM, result.levels);
+        if (result.opaque) {
+            renderer_->setTextureMode(entry.view, TextureMode::Opaque);
+        }
+        uploaded = true;
+    }
+    return uploaded;
+}
+
+void ImageCache::clear() {
+    for (auto& entry : entries_) {
+        destroyEntry(entry.second);
+    }
+    entries_.clear();
+    index_.clear();
+}
+
+void ImageCache::destroyEntry(Entry& entry) {
+    if (entry.view != VK_NULL_HANDLE) {
+        renderer_->destroyTexture(entry.image, entry.memory, entry.view);
+        entry.image = VK_NULL_HANDLE;
+        entry.memory = MemoryAllocation();
+        entry.view = VK_NULL_HANDLE;
+    }
+}
+
+void ImageCache::workerLoop() {
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            condition_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+            if (stopping_) {
+                break;
+            }
+            job = std::move(jobs_.front());
+            jobs_.pop_front();
+        }
+
+        Result result{job.id, false, 0, 0, 0, false, {}};
+        try {
+            ImageData image = ImageLoader::downscale(ImageLoader::loadImage(job.path), job.maxWidth, job.maxHeight);
+            result.width = image.width;
+            result.height = image.height;
+            result.pixels = ImageLoader::buildMipChain(image, result.levels);
+            result.opaque = true;
+            for (size_t i = 3; i < image.pixels.size(); i += 4) {
+                if (image.pixels[i] != 255) {
+                    result.opaque = false;
+                    break;
+                }
+            }
+            result.loaded = true;
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        results_.push_back(std::move(result));
+    }
+}
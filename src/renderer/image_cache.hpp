@@ -0,0 +1,92 @@
+#pragma once
+
+#include "device_allocator.hpp"
+#include "image_loader.hpp"
+#include <vulkan/vulkan.h>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class VulkanRenderer;
+
+// Images shared by everyone showing the same file, owned by the renderer.
+// Entries are keyed by path, modification time and size bucket, and reference
+// counted. A worker thread decodes, downscales and builds the mip chain; the
+// texture is created on the render thread in update() once the pixels are ready.
+class ImageCache {
+public:
+    explicit ImageCache(VulkanRenderer* renderer);
+    ~ImageCache();
+
+    // Non-copyable
+    ImageCache(const ImageCache&) = delete;
+    ImageCache& operator=(const ImageCache&) = delete;
+
+    // Relative paths of plain characters only, without any traversal
+    static bool isPathSafe(const std::string& path);
+
+    // Reference the image at `path`, big enough for maxWidth x maxHeight. Sizes
+    // are rounded up to a power of two, so nearby window sizes share a copy.
+    // The path is checked here, once; 0 means it was rejected or is missing.
+    uint32_t acquire(const std::string& path, uint32_t maxWidth, uint32_t maxHeight);
+    void release(uint32_t id);
+    // Whether the image was decoded large enough for width x height; if not,
+    // acquire it again for the new size
+    bool covers(uint32_t id, uint32_t width, uint32_t height) const;
+
+    // Null until the image has been decoded and uploaded
+    VkImageView getView(uint32_t id) const;
+
+    // Upload images the worker finished; true if any became visible
+    bool update();
+    void clear();
+
+private:
+    struct Entry {
+        std::string key;
+        uint32_t bound = 0; // Size bucket: neither side is decoded larger
+        uint32_t refs = 0;
+        VkImage image = VK_NULL_HANDLE;
+        MemoryAllocation memory;
+        VkImageView view = VK_NULL_HANDLE;
+    };
+
+    struct Job {
+        uint32_t id;
+        std::string path;
+        uint32_t maxWidth;
+        uint32_t maxHeight;
+    };
+
+    struct Result {
+        uint32_t id;
+        bool loaded;
+        uint32_t width;
+        uint32_t height;
+        uint32_t levels;
+        bool opaque; // No transparent pixels, so drawn without blending
+        std::vector<uint8_t> pixels; // Mip chain, levels back to back
+    };
+
+    VulkanRenderer* renderer_;
+    std::unordered_map<uint32_t, Entry> entries_;
+    std::unordered_map<std::string, uint32_t> index_; // Key to entry id
+    uint32_t nextId_ = 1;
+    uint32_t maxDimension_ = 0; // Device limit, queried on first use
+
+    std::thread worker_;
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    std::deque<Job> jobs_;
+    std::vector<Result> results_;
+    bool stopping_ = false;
+
+    uint32_t getSizeBucket(uint32_t size);
+    void workerLoop();
+    void destroyEntry(Entry& entry);
+};
@@ -2,6 +2,7 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 #include <stdexcept>
+#include <algorithm>
 #include <cstring>
 
 ImageData ImageLoader::loadImage(const std::string& path) {
@@ -35,3 +36,57 @@ void ImageLoader::freeImage(ImageData& image) {
     image.channels = 0;
 }
 
+ImageData ImageLoader::downscale(const ImageData& image, uint32_t maxWidth, uint32_t maxHeight) {
+    uint32_t width = std::max<uint32_t>(std::min(image.width, maxWidth), 1);
+    uint32_t height = std::max<uint32_t>(std::min(image.height, maxHeight), 1);
+    if (width == image.width && height == image.height) {
+        return image;
+    }
+    
+    ImageData result;
+    result.width = width;
+    result.height = height;
+    result.channels = 4;
+    result.pixels.resize(static_cast<size_t>(width) * height * 4);
+    
+    // Every destination pixel averages the block of source pixels it covers
+    for (uint32_t y = 0; y < height; ++y) {
+        uint32_t y0 = static_cast<uint32_t>(static_cast<uint64_t>(y) * image.height / height);
+        uint32_t y1 = std::max(static_cast<uint32_t>(static_cast<uint64_t>(y + 1) * image.height / height), y0 + 1);
+        for (uint32_t x = 0; x < width; ++x) {
+            uint32_t x0 = static_cast<uint32_t>(static_cast<uint64_t>(x) * image.width / width);
+            uint32_t x1 = std::max(static_cast<uint32_t>(static_cast<uint64_t>(x + 1) * image.width / width), x0 + 1);
+            
+            uint64_t sum[4] = {};
+            for (uint32_t sy = y0; sy < y1; ++sy) {
+                const uint8_t* src = &image.pixels[(static_cast<size_t>(sy) * image.width + x0) * 4];
+                for (uint32_t sx = x0; sx < x1; ++sx, src += 4) {
+                    for (int c = 0; c < 4; ++c) {
+                        sum[c] += src[c];
+                    }
+                }
+            }
+            
+            uint64_t count = static_cast<uint64_t>(x1 - x0) * (y1 - y0);
+            uint8_t* dst = &result.pixels[(static_cast<size_t>(y) * width + x) * 4];
+            for (int c = 0; c < 4; ++c) {
+                dst[c] = static_cast<uint8_t>((sum[c] + count / 2) / count);
+            }
+        }
+    }
+    return result;
+}
+
+std::vector<uint8_t> ImageLoader::buildMipChain(const ImageData& image, uint32_t& levels) {
+    std::vector<uint8_t> chain(image.pixels);
+    levels = 1;
+    
+    ImageData level = image;
+    while (level.width > 1 || level.height > 1) {
+        level = downscale(level, std::max<uint32_t>(level.width / 2, 1), std::max<uint32_t>(level.height / 2, 1));
+        chain.insert(chain.end(), level.pixels.begin(), level.pixels.end());
+        levels++;
+    }
+    return chain;
+}
+
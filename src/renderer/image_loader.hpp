@@ -17,5 +17,13 @@ class ImageLoader {
 public:
     static ImageData loadImage(const std::string& path);
     static void freeImage(ImageData& image);
+    
+    // Box-filter an RGBA image down so neither side exceeds the limit; each
+    // side is scaled on its own and never enlarged
+    static ImageData downscale(const ImageData& image, uint32_t maxWidth, uint32_t maxHeight);
+    
+    // Full mip chain of an RGBA image, levels packed back to back starting
+    // with the image itself; each level halves the previous, down to 1x1
+    static std::vector<uint8_t> buildMipChain(const ImageData& image, uint32_t& levels);
 };
 
@@ -0,0 +1,65 @@
+#include "range_allocator.hpp"
+#include <algorithm>
+#include <iterator>
+
+RangeAllocator::RangeAllocator(uint64_t size) : size_(size), used_(0) {
+    if (size > 0) {
+        freeRanges_[0] = size;
+    }
+}
+
+bool RangeAllocator::allocate(uint64_t size, uint64_t alignment, uint64_t& offset) {
+    if (size == 0) {
+        return false;
+    }
+    alignment = std::max<uint64_t>(alignment, 1);
+
+    for (auto it = freeRanges_.begin(); it != freeRanges_.end(); ++it) {
+        uint64_t start = it->first;
+        uint64_t end = start + it->second;
+        uint64_t aligned = (start + alignment - 1) & ~(alignment - 1);
+        if (aligned + size > end) {
+            continue;
+        }
+
+        // Split off what's left on either side of the allocation
+        freeRanges_.erase(it);
+        if (aligned > start) {
+            freeRanges_[start] = aligned - start;
+        }
+        if (aligned + size < end) {
+            freeRanges_[aligned + size] = end - (aligned + size);
+        }
+        used_ += size;
+        offset = aligned;
+        return true;
+    }
+    return false;
+}
+
+void RangeAllocator::free(uint64_t offset, uint64_t size) {
+    used_ -= size;
+    auto it = freeRanges_.emplace(offset, size).first;
+
+    // Merge with the following range, then with the preceding one
+    auto next = std::next(it);
+    if (next != freeRanges_.end() && it->first + it->second == next->first) {
+        it->second += next->second;
+        freeRanges_.erase(next);
+    }
+    if (it != freeRanges_.begin()) {
+        auto prev = std::prev(it);
+        if (prev->first + prev->second == it->first) {
+            prev->second += it->second;
+            freeRanges_.erase(it);
+        }
+    }
+}
+
+uint64_t RangeAllocator::getLargestFree() const {
+    uint64_t largest = 0;
+    for (const auto& range : freeRanges_) {
+        largest = std::max(largest, range.second);
+    }
+    return largest;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+
+// First-fit free-list allocator over a range of [0, size). Free ranges are
+// kept sorted by offset and merged with their neighbours on free(), so the
+// list stays as short as the fragmentation allows. Knows nothing of Vulkan;
+// the device allocator runs one per memory block.
+class RangeAllocator {
+public:
+    explicit RangeAllocator(uint64_t size = 0);
+
+    // Offset of `size` bytes aligned to `alignment` (a power of two), or false if nothing fits
+    bool allocate(uint64_t size, uint64_t alignment, uint64_t& offset);
+    void free(uint64_t offset, uint64_t size);
+
+    uint64_t getSize() const { return size_; }
+    uint64_t getUsed() const { return used_; }
+    uint64_t getLargestFree() const;
+    size_t getFreeRangeCount() const { return freeRanges_.size(); }
+    bool empty() const { return used_ == 0; }
+
+private:
+    uint64_t size_;
+    uint64_t used_;
+    std::map<uint64_t, uint64_t> freeRanges_; // Offset to size
+};
@@ -0,0 +1,54 @@
+#include "rolling_stats.hpp"
+#include <algorithm>
+#include <cmath>
+
+RollingStats::RollingStats(size_t window) : samples_(std::max<size_t>(window, 1)), next_(0), count_(0) {
+}
+
+void RollingStats::add(double value) {
+    samples_[next_] = value;
+    next_ = (next_ + 1) % samples_.size();
+    count_ = std::min(count_ + 1, samples_.size());
+}
+
+void RollingStats::clear() {
+    next_ = 0;
+    count_ = 0;
+}
+
+double RollingStats::getLast() const {
+    if (count_ == 0) {
+        return 0.0;
+    }
+    return samples_[(next_ + samples_.size() - 1) % samples_.size()];
+}
+
+double RollingStats::getMin() const {
+    if (count_ == 0) {
+        return 0.0;
+    }
+    // Until the window fills, the samples are the first count_ slots
+    return *std::min_element(samples_.begin(), samples_.begin() + count_);
+}
+
+double RollingStats::getAverage() const {
+    if (count_ == 0) {
+        return 0.0;
+    }
+    double total = 0.0;
+    for (size_t i = 0; i < count_; ++i) {
+        total += samples_[i];
+    }
+    return total / count_;
+}
+
+double RollingStats::getPercentile(double p) const {
+    if (count_ == 0) {
+        return 0.0;
+    }
+    sorted_.assign(samples_.begin(), samples_.begin() + count_);
+    size_t rank = static_cast<size_t>(std::ceil(std::clamp(p, 0.0, 1.0) * count_));
+    size_t index = rank > 0 ? rank - 1 : 0;
+    std::nth_element(sorted_.begin(), sorted_.begin() + index, sorted_.end());
+    return sorted_[index];
+}
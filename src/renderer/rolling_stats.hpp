@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Min, average and percentiles over the most recent samples of a series,
+// e.g. per-frame timings. Older samples are overwritten once the window is
+// full, so the figures follow the current workload.
+class RollingStats {
+public:
+    explicit RollingStats(size_t window = 240);
+
+    void add(double value);
+    void clear();
+
+    size_t getCount() const { return count_; }
+    bool empty() const { return count_ == 0; }
+    double getLast() const;
+    double getMin() const;
+    double getAverage() const;
+    // Nearest-rank percentile, p in [0, 1]
+    double getPercentile(double p) const;
+    double getP99() const { return getPercentile(0.99); }
+
+private:
+    std::vector<double> samples_;
+    size_t next_;  // Slot the next sample goes into
+    size_t count_;
+    mutable std::vector<double> sorted_; // Scratch for getPercentile()
+};
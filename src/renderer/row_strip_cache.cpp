@@ -0,0 +1,96 @@
+#include "row_strip_cache.hpp"
+#include <algorithm>
+#include <cmath>
+
+RowStripCache::RowStripCache(VulkanRenderer* renderer, uint32_t rowsPerStrip, size_t maxStrips)
+    : renderer_(renderer), rowsPerStrip_(std::max<uint32_t>(rowsPerStrip, 1)), maxStrips_(std::max<size_t>(maxStrips, 1)),
+      width_(0), cellHeight_(0.0f), rowPitch_(0), generation_(0), frame_(0) {
+}
+
+RowStripCache::~RowStripCache() {
+    clear();
+}
+
+void RowStripCache::begin(uint32_t width, float cellHeight, uint64_t generation) {
+    if (width != width_ || cellHeight != cellHeight_ || generation != generation_) {
+        clear();
+        width_ = width;
+        cellHeight_ = cellHeight;
+        rowPitch_ = std::max<uint32_t>(static_cast<uint32_t>(std::ceil(cellHeight)), 1);
+        generation_ = generation;
+    }
+    frame_++;
+}
+
+void RowStripCache::draw(float x, float y, uint64_t firstLine, uint64_t endLine, uint64_t availableEnd, const DrawLine& drawLine) {
+    endLine = std::min(endLine, availableEnd);
+    if (width_ == 0) {
+        return;
+    }
+
+    uint64_t line = firstLine;
+    while (line < endLine) {
+        uint64_t index = line / rowsPerStrip_;
+        uint64_t stripFirst = index * rowsPerStrip_;
+        uint64_t stripEnd = std::min(stripFirst + rowsPerStrip_, availableEnd);
+
+        Strip& strip = acquire(index);
+        strip.usedFrame = frame_;
+        uint32_t needed = static_cast<uint32_t>(stripEnd - stripFirst);
+        if (strip.lineCount < needed || strip.missingGlyphs) {
+            renderer_->beginTarget(strip.target);
+            strip.missingGlyphs = false;
+            for (uint64_t l = stripFirst; l < stripEnd; ++l) {
+                if (!drawLine(l, static_cast<float>((l - stripFirst) * rowPitch_))) {
+                    strip.missingGlyphs = true;
+                }
+            }
+            renderer_->endTarget();
+            strip.lineCount = needed;
+        }
+
+        // One quad per line: lines are cellHeight apart on screen but rowPitch apart in the strip
+        float stripHeight = static_cast<float>(strip.target.height);
+        for (uint64_t end = std::min(endLine, stripEnd); line < end; ++line) {
+            float top = std::round(y + (line - firstLine) * cellHeight_);
+            float bottom = std::round(y + (line + 1 - firstLine) * cellHeight_);
+            float height = std::min(bottom - top, static_cast<float>(rowPitch_));
+            float v0 = ((line - stripFirst) * rowPitch_) / stripHeight;
+            float v1 = v0 + height / stripHeight;
+            renderer_->renderQuad(x, top, static_cast<float>(width_), height, strip.target.view,
+                                  1.0f, 1.0f, 1.0f, 1.0f, 0.0f, v0, 1.0f, v1);
+        }
+    }
+}
+
+void RowStripCache::clear() {
+    for (auto& strip : strips_) {
+        renderer_->destroyRenderTarget(strip.target);
+    }
+    strips_.clear();
+    index_.clear();
+}
+
+RowStripCache::Strip& RowStripCache::acquire(uint64_t index) {
+    auto found = index_.find(index);
+    if (found != index_.end()) {
+        strips_.splice(strips_.begin(), strips_, found->second);
+        return strips_.front();
+    }
+
+    // Reuse the least recently used strip's image unless this frame already samples it
+    if (strips_.size() >= maxStrips_ && strips_.back().usedFrame != frame_) {
+        auto oldest = std::prev(strips_.end());
+        index_.erase(oldest->index);
+        oldest->index = index;
+        oldest->lineCount = 0;
+        oldest->missingGlyphs = false;
+        strips_.splice(strips_.begin(), strips_, oldest);
+    } else {
+        Strip strip{index, 0, false, 0, {}};
+        renderer_->createRenderTarget(width_, rowsPerStrip_ * rowPitch_, strip.target);
+        strips_.push_front(strip);
+    }
+    index_[index] = strips_.begin();
+    return strips_.front();
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "vulkan_renderer.hpp"
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <unordered_map>
+
+// Scrollback rows rendered into strips of a few rows each, keyed by the
+// absolute index of the strip's first line. Scrollback lines never change once
+// written, so a strip stays valid until the row layout or the glyphs change,
+// and scrolling only renders the strips newly entering the view. Rows sit on
+// whole pixels inside a strip so they composite 1:1 at any scroll position.
+class RowStripCache {
+public:
+    // Returns false if the line was drawn with placeholders for missing glyphs
+    using DrawLine = std::function<bool(uint64_t line, float y)>;
+
+    RowStripCache(VulkanRenderer* renderer, uint32_t rowsPerStrip = 16, size_t maxStrips = 12);
+    ~RowStripCache();
+
+    // Called once per frame before draw(); a different layout or glyph
+    // generation (evicted or rescaled glyphs) drops every strip
+    void begin(uint32_t width, float cellHeight, uint64_t generation);
+
+    // Composite lines [firstLine, endLine) with firstLine's top edge at y.
+    // Lines up to availableEnd exist; missing ones are drawn with drawLine at
+    // their y inside the strip. A strip that had lines with missing glyphs is
+    // drawn again the next time it is used, leaving the other strips as they are.
+    void draw(float x, float y, uint64_t firstLine, uint64_t endLine, uint64_t availableEnd, const DrawLine& drawLine);
+    void clear();
+
+private:
+    struct Strip {
+        uint64_t index;
+        uint32_t lineCount; // Lines rendered so far; the newest strip fills up over time
+        bool missingGlyphs; // Some line was drawn with placeholders
+        uint64_t usedFrame;
+        RenderTarget target;
+    };
+    using StripList = std::list<Strip>;
+
+    VulkanRenderer* renderer_;
+    uint32_t rowsPerStrip_;
+    size_t maxStrips_;
+    uint32_t width_;
+    float cellHeight_;
+    uint32_t rowPitch_; // Pixel rows per line inside a strip
+    uint64_t generation_;
+    uint64_t frame_;
+    StripList strips_; // Most recently used first
+    std::unordered_map<uint64_t, StripList::iterator> index_;
+
+    Strip& acquire(uint64_t index);
+};
@@ -0,0 +1,90 @@
+#include "text_shaper.hpp"
+#include "atlas_cache.hpp"
+#include <cstring>
+#include <iterator>
+
+namespace {
+    struct CodepointRange {
+        char32_t first;
+        char32_t last;
+    };
+
+    // Mark ranges of the scripts a terminal commonly meets, plus variation selectors
+    constexpr CodepointRange COMBINING_MARKS[] = {
+        {0x0300, 0x036F}, {0x0483, 0x0489}, {0x0591, 0x05BD}, {0x05BF, 0x05BF},
+        {0x05C1, 0x05C2}, {0x05C4, 0x05C5}, {0x05C7, 0x05C7}, {0x0610, 0x061A},
+        {0x064B, 0x065F}, {0x0670, 0x0670}, {0x06D6, 0x06DC}, {0x06DF, 0x06E4},
+        {0x06E7, 0x06E8}, {0x06EA, 0x06ED}, {0x0900, 0x0903}, {0x093A, 0x094F},
+        {0x0951, 0x0957}, {0x0962, 0x0963}, {0x0E31, 0x0E31}, {0x0E34, 0x0E3A},
+        {0x0E47, 0x0E4E}, {0x0F18, 0x0F19}, {0x0F35, 0x0F35}, {0x0F37, 0x0F37},
+        {0x0F39, 0x0F39}, {0x0F3E, 0x0F3F}, {0x0F71, 0x0F84}, {0x0F86, 0x0F87},
+        {0x0F8D, 0x0FBC}, {0x0FC6, 0x0FC6}, {0x1AB0, 0x1AFF}, {0x1DC0, 0x1DFF},
+        {0x20D0, 0x20FF}, {0xFE00, 0xFE0F}, {0xFE20, 0xFE2F}, {0x1F3FB, 0x1F3FF},
+        {0xE0100, 0xE01EF},
+    };
+}
+
+bool isCombiningMark(char32_t codepoint) {
+    if (codepoint < COMBINING_MARKS[0].first) {
+        return false;
+    }
+    for (const auto& range : COMBINING_MARKS) {
+        if (codepoint < range.first) {
+            return false;
+        }
+        if (codepoint <= range.last) {
+            return true;
+        }
+    }
+    return false;
+}
+
+ShapedRunCache::ShapedRunCache(size_t capacity)
+    : capacity_(capacity), hits_(0), misses_(0) {
+}
+
+uint64_t ShapedRunCache::hashRun(const char32_t* codepoints, size_t count, uint32_t style) {
+    uint64_t hash = hashBytes(&style, sizeof(style));
+    return hashBytes(codepoints, count * sizeof(char32_t), hash);
+}
+
+const std::vector<ShapedGlyph>* ShapedRunCache::find(const char32_t* codepoints, size_t count, uint32_t style) {
+    uint64_t hash = hashRun(codepoints, count, style);
+    auto range = index_.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        Entry& entry = *it->second;
+        if (entry.style == style && entry.text.size() == count &&
+            memcmp(entry.text.data(), codepoints, count * sizeof(char32_t)) == 0) {
+            entries_.splice(entries_.begin(), entries_, it->second);
+            hits_++;
+            return &entry.glyphs;
+        }
+    }
+    misses_++;
+    return nullptr;
+}
+
+const std::vector<ShapedGlyph>& ShapedRunCache::insert(const char32_t* codepoints, size_t count, uint32_t style, std::vector<ShapedGlyph> glyphs) {
+    if (capacity_ > 0 && entries_.size() >= capacity_) {
+        // Drop the least recently used run
+        auto oldest = std::prev(entries_.end());
+        auto range = index_.equal_range(oldest->hash);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second == oldest) {
+                index_.erase(it);
+                break;
+            }
+        }
+        entries_.erase(oldest);
+    }
+
+    uint64_t hash = hashRun(codepoints, count, style);
+    entries_.push_front({hash, style, std::u32string(codepoints, count), std::move(glyphs)});
+    index_.emplace(hash, entries_.begin());
+    return entries_.front().glyphs;
+}
+
+void ShapedRunCache::clear() {
+    entries_.clear();
+    index_.clear();
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Codepoint of glyphs that don't stand for a single codepoint, e.g. ligatures
+constexpr char32_t NO_CODEPOINT = 0xFFFFFFFF;
+
+// One positioned glyph of a shaped run. Terminal text stays on the cell grid,
+// so positions are relative to the origin of the cell the cluster starts in.
+struct ShapedGlyph {
+    char32_t codepoint;   // The cluster's codepoint if this is its nominal glyph, else NO_CODEPOINT
+    uint32_t face;        // Face in the fallback chain
+    uint32_t glyphIndex;
+    uint32_t cluster;     // Index of the first codepoint (cell) of the cluster within the run
+    float x;              // Offset from the cluster's cell, in raster pixels
+    float y;
+};
+
+// Nonspacing and enclosing marks that attach to the preceding base character
+bool isCombiningMark(char32_t codepoint);
+
+// LRU cache of shaped runs keyed by style and codepoint sequence, so rows
+// that didn't change since the last frame skip shaping entirely. Entries are
+// compared in full; the hash only picks the bucket.
+class ShapedRunCache {
+public:
+    explicit ShapedRunCache(size_t capacity = 4096);
+
+    const std::vector<ShapedGlyph>* find(const char32_t* codepoints, size_t count, uint32_t style);
+    const std::vector<ShapedGlyph>& insert(const char32_t* codepoints, size_t count, uint32_t style, std::vector<ShapedGlyph> glyphs);
+    void clear();
+
+    size_t size() const { return entries_.size(); }
+    uint64_t getHits() const { return hits_; }
+    uint64_t getMisses() const { return misses_; }
+
+private:
+    struct Entry {
+        uint64_t hash;
+        uint32_t style;
+        std::u32string text;
+        std::vector<ShapedGlyph> glyphs;
+    };
+    using EntryList = std::list<Entry>;
+
+    size_t capacity_;
+    EntryList entries_; // Most recently used first
+    std::unordered_multimap<uint64_t, EntryList::iterator> index_;
+    uint64_t hits_;
+    uint64_t misses_;
+
+    static uint64_t hashRun(const char32_t* codepoints, size_t count, uint32_t style);
+};
@@ -1,4 +1,7 @@
 #include "vulkan_renderer.hpp"
+#include "atlas_cache.hpp"
+#include "image_cache.hpp"
+#include "batch_order.hpp"
 #include <GLFW/glfw3.h>
 #include <stdexcept>
 #include <fstream>
@@ -9,8 +12,43 @@
 #include <optional>
 #include <limits>
 #include <cstddef>
+#include <cmath>
+#include <chrono>
 
-const int MAX_FRAMES_IN_FLIGHT = 2;
+#ifndef HYPERTERM_EXTERNAL_SHADERS
+// Generated at build time by cmake/embed_spirv.cmake
+#include "shaders/text_vert.h"
+#include "shaders/text_frag.h"
+#include "shaders/solid_vert.h"
+#include "shaders/solid_frag.h"
+#include "shaders/image_vert.h"
+#include "shaders/background_frag.h"
+#include "shaders/glyph_vert.h"
+#include "shaders/grid_vert.h"
+#include "shaders/grid_frag.h"
+#endif
+
+const uint32_t MAX_FRAMES_IN_FLIGHT = 3; // Upper bound of the render.frames_in_flight setting
+
+// Initial per-frame capacities; all grow on demand
+const VkDeviceSize STAGING_CHUNK_SIZE = 4 * 1024 * 1024;
+const VkDeviceSize INITIAL_VERTEX_BUFFER_SIZE = sizeof(Vertex) * 6 * 4096;
+const VkDeviceSize INITIAL_SLOT_BUFFER_SIZE = sizeof(GlyphSlot) * 1024;
+const VkDeviceSize INITIAL_GRID_BUFFER_SIZE = sizeof(GridState) * 16;
+const uint32_t MAX_DESCRIPTOR_SETS = 256;
+
+// Bump when the pipeline cache file layout changes
+const uint32_t PIPELINE_CACHE_MAGIC = 0x43505448; // "HTPC"
+const uint32_t PIPELINE_CACHE_VERSION = 1;
+
+// Taken during static initialization, as the process starts, for the time-to-first-frame report
+const auto PROCESS_START = std::chrono::steady_clock::now();
+
+// Texture uploads share one ring; anything over half of it gets a staging buffer of its own
+const VkDeviceSize UPLOAD_RING_SIZE = 16 * 1024 * 1024;
+const VkDeviceSize UPLOAD_ALIGNMENT = 16;
+// Timestamps per frame; the last is kept for the end of the frame
+const uint32_t MAX_TIMESTAMPS = 256;
 
 // Validation layers are helpful for development but optional
 // Will be automatically disabled if not available
@@ -33,6 +71,10 @@ VulkanRenderer::VulkanRenderer(GLFWwindow* window) : window_(window) {
     glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
 }
 
+VulkanRenderer::VulkanRenderer(uint32_t width, uint32_t height) : window_(nullptr) {
+    headlessExtent_ = {std::max(width, 1u), std::max(height, 1u)};
+}
+
 VulkanRenderer::~VulkanRenderer() {
     cleanup();
 }
@@ -43,42 +85,64 @@ void VulkanRenderer::init() {
     createSurface();
     pickPhysicalDevice();
     createLogicalDevice();
+    allocator_.init(device_, physicalDevice_);
     createSwapChain();
     createImageViews();
     createRenderPass();
+    createTargetRenderPass();
     createDescriptorSetLayout();
-    createGraphicsPipeline();
+    createPipelineCache();
+    createGraphicsPipelines();
     createTextureSampler();
     createDescriptorPool();
-    createFramebuffers();
     createCommandPool();
+    createTransferResources();
+    createSceneTarget();
     createCommandBuffers();
     createSyncObjects();
-    createQuadVertexBuffer();
-    createWhiteTexture();
+    createFrameResources();
+    imageCache_ = std::make_unique<ImageCache>(this);
 }
 
 void VulkanRenderer::cleanup() {
     if (device_ != VK_NULL_HANDLE) {
         vkDeviceWaitIdle(device_); // Wait for device to finish all operations
+        
+        // Nothing is in flight any more, so deferred and later deletions happen right away
+        completedSerial_ = std::numeric_limits<uint64_t>::max();
+        runDeletions();
     }
     
     cleanupSwapChain();
+    imageCache_.reset();
     
     if (device_ != VK_NULL_HANDLE) {
+        cleanupTransferResources();
+        cleanupFrameResources();
+        if (captureBuffer_ != VK_NULL_HANDLE) {
+            destroyBuffer(captureBuffer_, captureMemory_);
+            captureBuffer_ = VK_NULL_HANDLE;
+            captureMemory_ = MemoryAllocation();
+        }
+        capturePending_ = false;
+        
         if (descriptorPool_ != VK_NULL_HANDLE) {
             vkDestroyDescriptorPool(device_, descriptorPool_, nullptr);
             descriptorPool_ = VK_NULL_HANDLE;
         }
+        descriptorSets_.clear();
+        textureModes_.clear();
         
         if (textureSampler_ != VK_NULL_HANDLE) {
             vkDestroySampler(device_, textureSampler_, nullptr);
             textureSampler_ = VK_NULL_HANDLE;
         }
         
-        if (graphicsPipeline_ != VK_NULL_HANDLE) {
-            vkDestroyPipeline(device_, graphicsPipeline_, nullptr);
-            graphicsPipeline_ = VK_NULL_HANDLE;
+        for (auto& pipeline : pipelines_) {
+            if (pipeline != VK_NULL_HANDLE) {
+                vkDestroyPipeline(device_, pipeline, nullptr);
+                pipeline = VK_NULL_HANDLE;
+            }
         }
         
         if (pipelineLayout_ != VK_NULL_HANDLE) {
@@ -86,17 +150,32 @@ void VulkanRenderer::cleanup() {
             pipelineLayout_ = VK_NULL_HANDLE;
         }
         
+        if (pipelineCache_ != VK_NULL_HANDLE) {
+            vkDestroyPipelineCache(device_, pipelineCache_, nullptr);
+            pipelineCache_ = VK_NULL_HANDLE;
+        }
+        
         if (descriptorSetLayout_ != VK_NULL_HANDLE) {
             vkDestroyDescriptorSetLayout(device_, descriptorSetLayout_, nullptr);
             descriptorSetLayout_ = VK_NULL_HANDLE;
         }
         
+        if (frameSetLayout_ != VK_NULL_HANDLE) {
+            vkDestroyDescriptorSetLayout(device_, frameSetLayout_, nullptr);
+            frameSetLayout_ = VK_NULL_HANDLE;
+        }
+        
         if (renderPass_ != VK_NULL_HANDLE) {
             vkDestroyRenderPass(device_, renderPass_, nullptr);
             renderPass_ = VK_NULL_HANDLE;
         }
         
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT && i < renderFinishedSemaphores_.size(); i++) {
+        if (targetRenderPass_ != VK_NULL_HANDLE) {
+            vkDestroyRenderPass(device_, targetRenderPass_, nullptr);
+            targetRenderPass_ = VK_NULL_HANDLE;
+        }
+        
+        for (size_t i = 0; i < renderFinishedSemaphores_.size(); i++) {
             if (renderFinishedSemaphores_[i] != VK_NULL_HANDLE) {
                 vkDestroySemaphore(device_, renderFinishedSemaphores_[i], nullptr);
             }
@@ -116,6 +195,7 @@ void VulkanRenderer::cleanup() {
             commandPool_ = VK_NULL_HANDLE;
         }
         
+        allocator_.cleanup();
         vkDestroyDevice(device_, nullptr);
         device_ = VK_NULL_HANDLE;
     }
@@ -165,11 +245,13 @@ bool VulkanRenderer::checkValidationLayerSupport() {
 }
 
 std::vector<const char*> VulkanRenderer::getRequiredExtensions() {
-    uint32_t glfwExtensionCount = 0;
-    const char** glfwExtensions;
-    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-    
-    std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    std::vector<const char*> extensions;
+    if (window_) { // Headless rendering needs no surface extensions
+        uint32_t glfwExtensionCount = 0;
+        const char** glfwExtensions;
+        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+        extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    }
     
     if (enableValidationLayers) {
         extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -206,6 +288,11 @@ void VulkanRenderer::createInstance() {
     createInfo.pApplicationInfo = &appInfo;
     
     auto extensions = getRequiredExtensions();
+    // Needed on a 1.0 instance to query device features, and by VK_KHR_timeline_semaphore
+    properties2Supported_ = isInstanceExtensionAvailable(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+    if (properties2Supported_) {
+        extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+    }
     createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
     createInfo.ppEnabledExtensionNames = extensions.data();
     
@@ -243,6 +330,9 @@ void VulkanRenderer::setupDebugMessenger() {
 }
 
 void VulkanRenderer::createSurface() {
+    if (!window_) {
+        return; // Headless
+    }
     if (glfwCreateWindowSurface(instance_, window_, nullptr, &surface_) != VK_SUCCESS) {
         throw std::runtime_error("failed to create window surface!");
     }
@@ -273,13 +363,18 @@ void VulkanRenderer::pickPhysicalDevice() {
 
 bool VulkanRenderer::isDeviceSuitable(VkPhysicalDevice device) {
     QueueFamilyIndices indices = findQueueFamilies(device);
+    if (!window_) {
+        return indices.graphicsFamily.has_value(); // Headless: nothing is presented
+    }
     
     bool extensionsSupported = checkDeviceExtensionSupport(device);
     
     bool swapChainAdequate = false;
     if (extensionsSupported) {
         SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
-        swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
+        // Frames are copied into the swap chain images from the retained scene target
+        swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty() &&
+                            (swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT);
     }
     
     return indices.isComplete() && extensionsSupported && swapChainAdequate;
@@ -301,6 +396,56 @@ bool VulkanRenderer::checkDeviceExtensionSupport(VkPhysicalDevice device) {
     return requiredExtensions.empty();
 }
 
+bool VulkanRenderer::isDeviceExtensionAvailable(VkPhysicalDevice device, const char* name) {
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+    
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+    
+    for (const auto& extension : availableExtensions) {
+        if (strcmp(extension.extensionName, name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool VulkanRenderer::isInstanceExtensionAvailable(const char* name) {
+    uint32_t extensionCount;
+    vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
+    
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, availableExtensions.data());
+    
+    for (const auto& extension : availableExtensions) {
+        if (strcmp(extension.extensionName, name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool VulkanRenderer::isTimelineSemaphoreSupported() {
+    // The extension requires VK_KHR_get_physical_device_properties2, and exposing
+    // it doesn't promise the feature, so that is queried too
+    if (!properties2Supported_ || !isDeviceExtensionAvailable(physicalDevice_, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME)) {
+        return false;
+    }
+    auto getFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2KHR)vkGetInstanceProcAddr(instance_, "vkGetPhysicalDeviceFeatures2KHR");
+    if (!getFeatures2) {
+        return false;
+    }
+    
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures{};
+    timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+    VkPhysicalDeviceFeatures2 features{};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &timelineFeatures;
+    getFeatures2(physicalDevice_, &features);
+    return timelineFeatures.timelineSemaphore == VK_TRUE;
+}
+
 VulkanRenderer::QueueFamilyIndices VulkanRenderer::findQueueFamilies(VkPhysicalDevice device) {
     QueueFamilyIndices indices{};
     
@@ -316,8 +461,13 @@ VulkanRenderer::QueueFamilyIndices VulkanRenderer::findQueueFamilies(VkPhysicalD
             indices.graphicsFamily = i;
         }
         
+        // Headless there is no surface; the graphics queue stands in for the present queue
         VkBool32 presentSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
+        if (surface_ != VK_NULL_HANDLE) {
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
+        } else {
+            presentSupport = (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+        }
         
         if (presentSupport) {
             indices.presentFamily = i;
@@ -330,6 +480,15 @@ VulkanRenderer::QueueFamilyIndices VulkanRenderer::findQueueFamilies(VkPhysicalD
         i++;
     }
     
+    // A family that can only copy is usually a DMA engine running alongside the graphics queue
+    for (uint32_t family = 0; family < queueFamilyCount; ++family) {
+        VkQueueFlags flags = queueFamilies[family].queueFlags;
+        if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+            indices.transferFamily = family;
+            break;
+        }
+    }
+    
     return indices;
 }
 
@@ -360,8 +519,14 @@ VulkanRenderer::SwapChainSupportDetails VulkanRenderer::querySwapChainSupport(Vk
 void VulkanRenderer::createLogicalDevice() {
     QueueFamilyIndices indices = findQueueFamilies(physicalDevice_);
     
+    // Uploads on a queue of their own are handed to the frame through a timeline semaphore;
+    // without one they stay on the graphics queue, where submission order is enough
+    timelineSupported_ = isTimelineSemaphoreSupported();
+    graphicsFamily_ = indices.graphicsFamily.value();
+    transferFamily_ = timelineSupported_ && indices.transferFamily.has_value() ? indices.transferFamily.value() : graphicsFamily_;
+    
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-    std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(), indices.presentFamily.value()};
+    std::set<uint32_t> uniqueQueueFamilies = {graphicsFamily_, indices.presentFamily.value(), transferFamily_};
     
     float queuePriority = 1.0f;
     for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -375,13 +540,39 @@ void VulkanRenderer::createLogicalDevice() {
     
     VkPhysicalDeviceFeatures deviceFeatures{};
     
+    // Damage hints for the compositor are optional; headless there is no swap chain at all
+    std::vector<const char*> extensions;
+    if (window_) {
+        extensions = deviceExtensions;
+    }
+    incrementalPresentSupported_ = window_ && isDeviceExtensionAvailable(physicalDevice_, VK_KHR_INCREMENTAL_PRESENT_EXTENSION_NAME);
+    if (incrementalPresentSupported_) {
+        extensions.push_back(VK_KHR_INCREMENTAL_PRESENT_EXTENSION_NAME);
+    }
+    // Actual present times, for pacing frames against vblank
+    displayTimingSupported_ = window_ && isDeviceExtensionAvailable(physicalDevice_, VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME);
+    if (displayTimingSupported_) {
+        extensions.push_back(VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME);
+    }
+    
+    // Only enabled once isTimelineSemaphoreSupported() found the feature
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures{};
+    timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+    timelineFeatures.timelineSemaphore = VK_TRUE;
+    if (timelineSupported_) {
+        extensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+    }
+    
     VkDeviceCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
     createInfo.pEnabledFeatures = &deviceFeatures;
-    createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-    createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+    createInfo.ppEnabledExtensionNames = extensions.data();
+    if (timelineSupported_) {
+        createInfo.pNext = &timelineFeatures;
+    }
     
     if (enableValidationLayers) {
         createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
@@ -396,9 +587,23 @@ void VulkanRenderer::createLogicalDevice() {
     
     vkGetDeviceQueue(device_, indices.graphicsFamily.value(), 0, &graphicsQueue_);
     vkGetDeviceQueue(device_, indices.presentFamily.value(), 0, &presentQueue_);
+    vkGetDeviceQueue(device_, transferFamily_, 0, &transferQueue_);
+    
+    if (displayTimingSupported_) {
+        getRefreshCycleDuration_ = (PFN_vkGetRefreshCycleDurationGOOGLE)vkGetDeviceProcAddr(device_, "vkGetRefreshCycleDurationGOOGLE");
+        getPastPresentationTiming_ = (PFN_vkGetPastPresentationTimingGOOGLE)vkGetDeviceProcAddr(device_, "vkGetPastPresentationTimingGOOGLE");
+        displayTimingSupported_ = getRefreshCycleDuration_ && getPastPresentationTiming_;
+    }
 }
 
 void VulkanRenderer::createSwapChain() {
+    if (!window_) {
+        // Headless frames end in the scene target, which takes the place of the swap chain images
+        swapChainImageFormat_ = VK_FORMAT_R8G8B8A8_SRGB;
+        swapChainExtent_ = headlessExtent_;
+        return;
+    }
+    
     SwapChainSupportDetails swapChainSupport = querySwapChainSupport(physicalDevice_);
     
     VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
@@ -418,7 +623,7 @@ void VulkanRenderer::createSwapChain() {
     createInfo.imageColorSpace = surfaceFormat.colorSpace;
     createInfo.imageExtent = extent;
     createInfo.imageArrayLayers = 1;
-    createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
     
     QueueFamilyIndices indices = findQueueFamilies(physicalDevice_);
     uint32_t queueFamilyIndices[] = {indices.graphicsFamily.value(), indices.presentFamily.value()};
@@ -436,9 +641,19 @@ void VulkanRenderer::createSwapChain() {
     createInfo.presentMode = presentMode;
     createInfo.clipped = VK_TRUE;
     
-    if (vkCreateSwapchainKHR(device_, &createInfo, nullptr, &swapChain_) != VK_SUCCESS) {
+    // Handing over the old swap chain lets the presentation engine switch
+    // without a gap; it goes once the frames presenting from it are done
+    VkSwapchainKHR oldSwapChain = swapChain_;
+    createInfo.oldSwapchain = oldSwapChain;
+    
+    VkSwapchainKHR swapChain = VK_NULL_HANDLE;
+    if (vkCreateSwapchainKHR(device_, &createInfo, nullptr, &swapChain) != VK_SUCCESS) {
         throw std::runtime_error("failed to create swap chain!");
     }
+    swapChain_ = swapChain;
+    if (oldSwapChain != VK_NULL_HANDLE) {
+        deferDeletion([this, oldSwapChain]() { vkDestroySwapchainKHR(device_, oldSwapChain, nullptr); });
+    }
     
     vkGetSwapchainImagesKHR(device_, swapChain_, &imageCount, nullptr);
     swapChainImages_.resize(imageCount);
@@ -446,6 +661,15 @@ void VulkanRenderer::createSwapChain() {
     
     swapChainImageFormat_ = surfaceFormat.format;
     swapChainExtent_ = extent;
+    
+    refreshDurationNs_ = 0;
+    lastVblankNs_ = 0;
+    if (displayTimingSupported_) {
+        VkRefreshCycleDurationGOOGLE refreshCycle{};
+        if (getRefreshCycleDuration_(device_, swapChain_, &refreshCycle) == VK_SUCCESS) {
+            refreshDurationNs_ = refreshCycle.refreshDuration;
+        }
+    }
 }
 
 VkSurfaceFormatKHR VulkanRenderer::chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats) {
@@ -460,11 +684,15 @@ VkSurfaceFormatKHR VulkanRenderer::chooseSwapSurfaceFormat(const std::vector<VkS
 
 VkPresentModeKHR VulkanRenderer::chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes) {
     for (const auto& availablePresentMode : availablePresentModes) {
-        if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
+        if (availablePresentMode == presentMode_) {
             return availablePresentMode;
         }
     }
     
+    // FIFO is the one mode every device supports
+    if (presentMode_ != VK_PRESENT_MODE_FIFO_KHR) {
+        std::cerr << "Warning: Requested present mode not supported, using fifo" << std::endl;
+    }
     return VK_PRESENT_MODE_FIFO_KHR;
 }
 
@@ -513,6 +741,58 @@ void VulkanRenderer::createImageViews() {
 }
 
 void VulkanRenderer::createRenderPass() {
+    VkAttachmentDescription colorAttachment{};
+    colorAttachment.format = swapChainImageFormat_;
+    colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    // The scene target keeps last frame's pixels; damaged rectangles are cleared explicitly
+    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    
+    VkAttachmentReference colorAttachmentRef{};
+    colorAttachmentRef.attachment = 0;
+    colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &colorAttachmentRef;
+    
+    // Previous frame's copy out of the scene must finish before it is drawn into,
+    // and this frame's drawing before its own copy
+    VkSubpassDependency dependencies[2]{};
+    dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[0].dstSubpass = 0;
+    dependencies[0].srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    dependencies[0].srcAccessMask = 0;
+    dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependencies[1].srcSubpass = 0;
+    dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    
+    VkRenderPassCreateInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = 1;
+    renderPassInfo.pAttachments = &colorAttachment;
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+    renderPassInfo.dependencyCount = 2;
+    renderPassInfo.pDependencies = dependencies;
+    
+    if (vkCreateRenderPass(device_, &renderPassInfo, nullptr, &renderPass_) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create render pass!");
+    }
+}
+
+void VulkanRenderer::createTargetRenderPass() {
+    // Same attachment format as the scene pass, so the pipeline works in both
     VkAttachmentDescription colorAttachment{};
     colorAttachment.format = swapChainImageFormat_;
     colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
@@ -521,7 +801,7 @@ void VulkanRenderer::createRenderPass() {
     colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
     
     VkAttachmentReference colorAttachmentRef{};
     colorAttachmentRef.attachment = 0;
@@ -532,13 +812,20 @@ void VulkanRenderer::createRenderPass() {
     subpass.colorAttachmentCount = 1;
     subpass.pColorAttachments = &colorAttachmentRef;
     
-    VkSubpassDependency dependency{};
-    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-    dependency.dstSubpass = 0;
-    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.srcAccessMask = 0;
-    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    // Earlier frames may still sample the target; this frame samples it after drawing
+    VkSubpassDependency dependencies[2]{};
+    dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[0].dstSubpass = 0;
+    dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    dependencies[0].srcAccessMask = 0;
+    dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependencies[1].srcSubpass = 0;
+    dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
     
     VkRenderPassCreateInfo renderPassInfo{};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
@@ -546,10 +833,10 @@ void VulkanRenderer::createRenderPass() {
     renderPassInfo.pAttachments = &colorAttachment;
     renderPassInfo.subpassCount = 1;
     renderPassInfo.pSubpasses = &subpass;
-    renderPassInfo.dependencyCount = 1;
-    renderPassInfo.pDependencies = &dependency;
+    renderPassInfo.dependencyCount = 2;
+    renderPassInfo.pDependencies = dependencies;
     
-    if (vkCreateRenderPass(device_, &renderPassInfo, nullptr, &renderPass_) != VK_SUCCESS) {
+    if (vkCreateRenderPass(device_, &renderPassInfo, nullptr, &targetRenderPass_) != VK_SUCCESS) {
         throw std::runtime_error("failed to create render pass!");
     }
 }
@@ -570,58 +857,170 @@ void VulkanRenderer::createDescriptorSetLayout() {
     if (vkCreateDescriptorSetLayout(device_, &layoutInfo, nullptr, &descriptorSetLayout_) != VK_SUCCESS) {
         throw std::runtime_error("failed to create descriptor set layout!");
     }
+    
+    // The glyph slot table, read by glyph.vert, and the grid states, read by
+    // grid.frag; one set per frame in flight
+    VkDescriptorSetLayoutBinding frameLayoutBindings[2]{};
+    frameLayoutBindings[0].binding = 0;
+    frameLayoutBindings[0].descriptorCount = 1;
+    frameLayoutBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    frameLayoutBindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    frameLayoutBindings[1].binding = 1;
+    frameLayoutBindings[1].descriptorCount = 1;
+    frameLayoutBindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    frameLayoutBindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    
+    layoutInfo.bindingCount = 2;
+    layoutInfo.pBindings = frameLayoutBindings;
+    if (vkCreateDescriptorSetLayout(device_, &layoutInfo, nullptr, &frameSetLayout_) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create frame set layout!");
+    }
 }
 
-void VulkanRenderer::createGraphicsPipeline() {
-    // Load compiled SPIR-V shaders (.spv files)
-    auto vertShaderCode = readFile("shaders/text_vert.spv");
-    auto fragShaderCode = readFile("shaders/text_frag.spv");
+void VulkanRenderer::createPipelineCache() {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice_, &properties);
+    
+    // Driver data is only handed back to the device and driver build that produced it
+    std::vector<uint8_t> initialData;
+    MappedFile file;
+    if (file.open(getCacheDirectory() + "/pipeline.cache")) {
+        ByteReader reader(file.data(), file.size());
+        uint32_t magic, version, vendorID, deviceID, driverVersion;
+        uint8_t cacheUUID[VK_UUID_SIZE];
+        uint64_t size, hash;
+        if (reader.get(magic) && reader.get(version) && reader.get(vendorID) && reader.get(deviceID) &&
+            reader.get(driverVersion) && reader.getBytes(cacheUUID, VK_UUID_SIZE) && reader.get(size) && reader.get(hash) &&
+            magic == PIPELINE_CACHE_MAGIC && version == PIPELINE_CACHE_VERSION &&
+            vendorID == properties.vendorID && deviceID == properties.deviceID && driverVersion == properties.driverVersion &&
+            memcmp(cacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0) {
+            const uint8_t* data = reader.view(static_cast<size_t>(size));
+            if (data && hashBytes(data, static_cast<size_t>(size)) == hash) {
+                initialData.assign(data, data + size);
+            }
+        }
+    }
+    pipelineCacheWarm_ = !initialData.empty();
     
-    VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-    VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
+    VkPipelineCacheCreateInfo cacheInfo{};
+    cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cacheInfo.initialDataSize = initialData.size();
+    cacheInfo.pInitialData = initialData.empty() ? nullptr : initialData.data();
+    
+    if (vkCreatePipelineCache(device_, &cacheInfo, nullptr, &pipelineCache_) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create pipeline cache!");
+    }
+}
+
+void VulkanRenderer::savePipelineCache() {
+    size_t size = 0;
+    if (vkGetPipelineCacheData(device_, pipelineCache_, &size, nullptr) != VK_SUCCESS || size == 0) {
+        return;
+    }
+    std::vector<uint8_t> data(size);
+    if (vkGetPipelineCacheData(device_, pipelineCache_, &size, data.data()) != VK_SUCCESS) {
+        return;
+    }
+    data.resize(size);
     
-    VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
-    vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-    vertShaderStageInfo.module = vertShaderModule;
-    vertShaderStageInfo.pName = "main";
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice_, &properties);
     
-    VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
-    fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    fragShaderStageInfo.module = fragShaderModule;
-    fragShaderStageInfo.pName = "main";
+    ByteWriter writer;
+    writer.put(PIPELINE_CACHE_MAGIC);
+    writer.put(PIPELINE_CACHE_VERSION);
+    writer.put(properties.vendorID);
+    writer.put(properties.deviceID);
+    writer.put(properties.driverVersion);
+    writer.putBytes(properties.pipelineCacheUUID, VK_UUID_SIZE);
+    writer.put(static_cast<uint64_t>(data.size()));
+    writer.put(hashBytes(data.data(), data.size()));
+    writer.putBytes(data.data(), data.size());
     
-    VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
+    std::string path = getCacheDirectory() + "/pipeline.cache";
+    if (!writeCacheFile(path, writer.getBytes())) {
+        std::cerr << "Warning: failed to write pipeline cache " << path << std::endl;
+    }
+}
+
+void VulkanRenderer::createGraphicsPipelines() {
+#ifdef HYPERTERM_EXTERNAL_SHADERS
+    // Built without a shader compiler: SPIR-V compiled by hand into the working directory
+    auto loadShader = [this](const char* name) {
+        auto code = readFile(std::string("shaders/") + name + ".spv");
+        return createShaderModule(reinterpret_cast<const uint32_t*>(code.data()), code.size());
+    };
+    VkShaderModule textVert = loadShader("text_vert");
+    VkShaderModule textFrag = loadShader("text_frag");
+    VkShaderModule solidVert = loadShader("solid_vert");
+    VkShaderModule solidFrag = loadShader("solid_frag");
+    VkShaderModule imageVert = loadShader("image_vert");
+    VkShaderModule imageFrag = loadShader("background_frag");
+    VkShaderModule glyphVert = loadShader("glyph_vert");
+    VkShaderModule gridVert = loadShader("grid_vert");
+    VkShaderModule gridFrag = loadShader("grid_frag");
+#else
+    // SPIR-V embedded at build time, so the working directory doesn't matter
+    VkShaderModule textVert = createShaderModule(text_vert_spv, sizeof(text_vert_spv));
+    VkShaderModule textFrag = createShaderModule(text_frag_spv, sizeof(text_frag_spv));
+    VkShaderModule solidVert = createShaderModule(solid_vert_spv, sizeof(solid_vert_spv));
+    VkShaderModule solidFrag = createShaderModule(solid_frag_spv, sizeof(solid_frag_spv));
+    VkShaderModule imageVert = createShaderModule(image_vert_spv, sizeof(image_vert_spv));
+    VkShaderModule imageFrag = createShaderModule(background_frag_spv, sizeof(background_frag_spv));
+    VkShaderModule glyphVert = createShaderModule(glyph_vert_spv, sizeof(glyph_vert_spv));
+    VkShaderModule gridVert = createShaderModule(grid_vert_spv, sizeof(grid_vert_spv));
+    VkShaderModule gridFrag = createShaderModule(grid_frag_spv, sizeof(grid_frag_spv));
+#endif
     
-    VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
-    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputInfo.vertexBindingDescriptionCount = 0;
-    vertexInputInfo.vertexAttributeDescriptionCount = 0;
+    // Vertex formats, indexed by VertexFormat
+    auto solidBinding = SolidVertex::getBindingDescription();
+    auto solidAttributes = SolidVertex::getAttributeDescriptions();
+    auto texturedBinding = Vertex::getBindingDescription();
+    auto texturedAttributes = Vertex::getAttributeDescriptions();
+    auto imageBinding = ImageVertex::getBindingDescription();
+    auto imageAttributes = ImageVertex::getAttributeDescriptions();
+    auto gridBinding = GridVertex::getBindingDescription();
+    auto gridAttributes = GridVertex::getAttributeDescriptions();
+    auto glyphBinding = GlyphInstance::getBindingDescription();
+    auto glyphAttributes = GlyphInstance::getAttributeDescriptions();
+    
+    std::array<VkPipelineVertexInputStateCreateInfo, static_cast<size_t>(VertexFormat::Count)> vertexInputs{};
+    for (auto& vertexInput : vertexInputs) {
+        vertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+        vertexInput.vertexBindingDescriptionCount = 1;
+    }
+    vertexInputs[static_cast<size_t>(VertexFormat::Solid)].pVertexBindingDescriptions = &solidBinding;
+    vertexInputs[static_cast<size_t>(VertexFormat::Solid)].vertexAttributeDescriptionCount = static_cast<uint32_t>(solidAttributes.size());
+    vertexInputs[static_cast<size_t>(VertexFormat::Solid)].pVertexAttributeDescriptions = solidAttributes.data();
+    vertexInputs[static_cast<size_t>(VertexFormat::Textured)].pVertexBindingDescriptions = &texturedBinding;
+    vertexInputs[static_cast<size_t>(VertexFormat::Textured)].vertexAttributeDescriptionCount = static_cast<uint32_t>(texturedAttributes.size());
+    vertexInputs[static_cast<size_t>(VertexFormat::Textured)].pVertexAttributeDescriptions = texturedAttributes.data();
+    vertexInputs[static_cast<size_t>(VertexFormat::Image)].pVertexBindingDescriptions = &imageBinding;
+    vertexInputs[static_cast<size_t>(VertexFormat::Image)].vertexAttributeDescriptionCount = static_cast<uint32_t>(imageAttributes.size());
+    vertexInputs[static_cast<size_t>(VertexFormat::Image)].pVertexAttributeDescriptions = imageAttributes.data();
+    vertexInputs[static_cast<size_t>(VertexFormat::Grid)].pVertexBindingDescriptions = &gridBinding;
+    vertexInputs[static_cast<size_t>(VertexFormat::Grid)].vertexAttributeDescriptionCount = static_cast<uint32_t>(gridAttributes.size());
+    vertexInputs[static_cast<size_t>(VertexFormat::Grid)].pVertexAttributeDescriptions = gridAttributes.data();
+    vertexInputs[static_cast<size_t>(VertexFormat::Glyph)].pVertexBindingDescriptions = &glyphBinding;
+    vertexInputs[static_cast<size_t>(VertexFormat::Glyph)].vertexAttributeDescriptionCount = static_cast<uint32_t>(glyphAttributes.size());
+    vertexInputs[static_cast<size_t>(VertexFormat::Glyph)].pVertexAttributeDescriptions = glyphAttributes.data();
     
     VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
     inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
     inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
     inputAssembly.primitiveRestartEnable = VK_FALSE;
     
-    VkViewport viewport{};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = (float)swapChainExtent_.width;
-    viewport.height = (float)swapChainExtent_.height;
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-    
-    VkRect2D scissor{};
-    scissor.offset = {0, 0};
-    scissor.extent = swapChainExtent_;
-    
+    // Viewport follows the swap chain extent and the scissor each damage rectangle
     VkPipelineViewportStateCreateInfo viewportState{};
     viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
     viewportState.viewportCount = 1;
-    viewportState.pViewports = &viewport;
     viewportState.scissorCount = 1;
-    viewportState.pScissors = &scissor;
+    
+    VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamicState{};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = 2;
+    dynamicState.pDynamicStates = dynamicStates;
     
     VkPipelineRasterizationStateCreateInfo rasterizer{};
     rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
@@ -629,7 +1028,7 @@ void VulkanRenderer::createGraphicsPipeline() {
     rasterizer.rasterizerDiscardEnable = VK_FALSE;
     rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
     rasterizer.lineWidth = 1.0f;
-    rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+    rasterizer.cullMode = VK_CULL_MODE_NONE; // 2D quads, winding is irrelevant
     rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
     rasterizer.depthBiasEnable = VK_FALSE;
     
@@ -638,37 +1037,44 @@ void VulkanRenderer::createGraphicsPipeline() {
     multisampling.sampleShadingEnable = VK_FALSE;
     multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
     
-    VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-    colorBlendAttachment.blendEnable = VK_TRUE;
-    colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
-    colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
-    colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
-    colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-    colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-    colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
-    
-    VkPipelineColorBlendStateCreateInfo colorBlending{};
-    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-    colorBlending.logicOpEnable = VK_FALSE;
-    colorBlending.logicOp = VK_LOGIC_OP_COPY;
-    colorBlending.attachmentCount = 1;
-    colorBlending.pAttachments = &colorBlendAttachment;
-    colorBlending.blendConstants[0] = 0.0f;
-    colorBlending.blendConstants[1] = 0.0f;
-    colorBlending.blendConstants[2] = 0.0f;
-    colorBlending.blendConstants[3] = 0.0f;
-    
-    // Push constant for screen size
+    // Everything but opaque images is alpha blended
+    VkPipelineColorBlendAttachmentState blendAttachment{};
+    blendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    blendAttachment.blendEnable = VK_TRUE;
+    blendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    blendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    blendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+    blendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    blendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+    blendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+    
+    VkPipelineColorBlendAttachmentState opaqueAttachment{};
+    opaqueAttachment.colorWriteMask = blendAttachment.colorWriteMask;
+    opaqueAttachment.blendEnable = VK_FALSE;
+    
+    VkPipelineColorBlendStateCreateInfo blending{};
+    blending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    blending.logicOpEnable = VK_FALSE;
+    blending.logicOp = VK_LOGIC_OP_COPY;
+    blending.attachmentCount = 1;
+    blending.pAttachments = &blendAttachment;
+    
+    VkPipelineColorBlendStateCreateInfo opaque = blending;
+    opaque.pAttachments = &opaqueAttachment;
+    
+    // Push constants: vec2 screenSize, shared by every vertex shader. One
+    // layout for all pipelines keeps push constants and sets bound across switches.
     VkPushConstantRange pushConstantRange{};
     pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
     pushConstantRange.offset = 0;
-    pushConstantRange.size = sizeof(float) * 2; // vec2 screenSize
+    pushConstantRange.size = sizeof(float) * 2;
     
+    // Set 0 is the sampled texture, set 1 the glyph slot table and grid states
+    VkDescriptorSetLayout setLayouts[] = {descriptorSetLayout_, frameSetLayout_};
     VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = 1;
-    pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout_;
+    pipelineLayoutInfo.setLayoutCount = 2;
+    pipelineLayoutInfo.pSetLayouts = setLayouts;
     pipelineLayoutInfo.pushConstantRangeCount = 1;
     pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
     
@@ -676,49 +1082,236 @@ void VulkanRenderer::createGraphicsPipeline() {
         throw std::runtime_error("failed to create pipeline layout!");
     }
     
-    VkGraphicsPipelineCreateInfo pipelineInfo{};
-    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipelineInfo.stageCount = 2;
-    pipelineInfo.pStages = shaderStages;
-    pipelineInfo.pVertexInputState = &vertexInputInfo;
-    pipelineInfo.pInputAssemblyState = &inputAssembly;
-    pipelineInfo.pViewportState = &viewportState;
-    pipelineInfo.pRasterizationState = &rasterizer;
-    pipelineInfo.pMultisampleState = &multisampling;
-    pipelineInfo.pColorBlendState = &colorBlending;
-    pipelineInfo.layout = pipelineLayout_;
-    pipelineInfo.renderPass = renderPass_;
-    pipelineInfo.subpass = 0;
-    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+    // Textured quads and the glyph pipelines share text.frag, specialized on its SAMPLE_MODE
+    VkSpecializationMapEntry sampleModeEntry{0, 0, sizeof(uint32_t)};
+    const uint32_t sampleModes[] = {0, 1, 2}; // Coverage, distance field, color
+    std::array<VkSpecializationInfo, 3> specializations{};
+    for (size_t i = 0; i < specializations.size(); ++i) {
+        specializations[i].mapEntryCount = 1;
+        specializations[i].pMapEntries = &sampleModeEntry;
+        specializations[i].dataSize = sizeof(uint32_t);
+        specializations[i].pData = &sampleModes[i];
+    }
+    
+    struct PipelineDesc {
+        VkShaderModule vert;
+        VkShaderModule frag;
+        const VkSpecializationInfo* specialization;
+        VertexFormat format;
+        const VkPipelineColorBlendStateCreateInfo* blend;
+    };
+    const PipelineDesc descs[] = {
+        {solidVert, solidFrag, nullptr, VertexFormat::Solid, &blending},               // Solid
+        {textVert, textFrag, &specializations[0], VertexFormat::Textured, &blending},  // Textured
+        {imageVert, imageFrag, nullptr, VertexFormat::Image, &opaque},                 // Image
+        {gridVert, gridFrag, nullptr, VertexFormat::Grid, &opaque},                    // Grid
+        {glyphVert, textFrag, &specializations[0], VertexFormat::Glyph, &blending},    // Glyph
+        {glyphVert, textFrag, &specializations[1], VertexFormat::Glyph, &blending},    // DistanceFieldGlyph
+        {glyphVert, textFrag, &specializations[2], VertexFormat::Glyph, &blending},    // ColorGlyph
+    };
+    static_assert(sizeof(descs) / sizeof(descs[0]) == static_cast<size_t>(PipelineKind::Count), "one description per pipeline");
+    
+    std::array<std::array<VkPipelineShaderStageCreateInfo, 2>, static_cast<size_t>(PipelineKind::Count)> stages{};
+    std::array<VkGraphicsPipelineCreateInfo, static_cast<size_t>(PipelineKind::Count)> pipelineInfos{};
+    for (size_t i = 0; i < pipelineInfos.size(); ++i) {
+        stages[i][0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        stages[i][0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+        stages[i][0].module = descs[i].vert;
+        stages[i][0].pName = "main";
+        stages[i][1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        stages[i][1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+        stages[i][1].module = descs[i].frag;
+        stages[i][1].pName = "main";
+        stages[i][1].pSpecializationInfo = descs[i].specialization;
+        
+        VkGraphicsPipelineCreateInfo& pipelineInfo = pipelineInfos[i];
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        pipelineInfo.stageCount = 2;
+        pipelineInfo.pStages = stages[i].data();
+        pipelineInfo.pVertexInputState = &vertexInputs[static_cast<size_t>(descs[i].format)];
+        pipelineInfo.pInputAssemblyState = &inputAssembly;
+        pipelineInfo.pViewportState = &viewportState;
+        pipelineInfo.pRasterizationState = &rasterizer;
+        pipelineInfo.pMultisampleState = &multisampling;
+        pipelineInfo.pColorBlendState = descs[i].blend;
+        pipelineInfo.pDynamicState = &dynamicState;
+        pipelineInfo.layout = pipelineLayout_;
+        pipelineInfo.renderPass = renderPass_;
+        pipelineInfo.subpass = 0;
+        pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+    }
+    
+    if (vkCreateGraphicsPipelines(device_, pipelineCache_, static_cast<uint32_t>(pipelineInfos.size()), pipelineInfos.data(),
+                                  nullptr, pipelines_.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create graphics pipelines!");
+    }
     
-    if (vkCreateGraphicsPipelines(device_, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline_) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create graphics pipeline!");
+    // Every pipeline is created by now; keep what the driver compiled for the next launch
+    if (!pipelineCacheWarm_) {
+        savePipelineCache();
     }
     
-    vkDestroyShaderModule(device_, fragShaderModule, nullptr);
-    vkDestroyShaderModule(device_, vertShaderModule, nullptr);
+    for (VkShaderModule module : {textVert, textFrag, solidVert, solidFrag, imageVert, imageFrag, glyphVert, gridVert, gridFrag}) {
+        vkDestroyShaderModule(device_, module, nullptr);
+    }
 }
 
-void VulkanRenderer::createFramebuffers() {
-    swapChainFramebuffers_.resize(swapChainImageViews_.size());
+void VulkanRenderer::createSceneTarget() {
+    createColorTarget(swapChainExtent_.width, swapChainExtent_.height, VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                      renderPass_, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, scene_);
+    resetDamage();
+}
+
+void VulkanRenderer::createColorTarget(uint32_t width, uint32_t height, VkImageUsageFlags usage, VkRenderPass renderPass, VkImageLayout layout, RenderTarget& target) {
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent.width = width;
+    imageInfo.extent.height = height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = swapChainImageFormat_;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | usage;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
     
-    for (size_t i = 0; i < swapChainImageViews_.size(); i++) {
-        VkImageView attachments[] = {
-            swapChainImageViews_[i]
-        };
-        
-        VkFramebufferCreateInfo framebufferInfo{};
-        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-        framebufferInfo.renderPass = renderPass_;
-        framebufferInfo.attachmentCount = 1;
-        framebufferInfo.pAttachments = attachments;
-        framebufferInfo.width = swapChainExtent_.width;
-        framebufferInfo.height = swapChainExtent_.height;
-        framebufferInfo.layers = 1;
-        
-        if (vkCreateFramebuffer(device_, &framebufferInfo, nullptr, &swapChainFramebuffers_[i]) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create framebuffer!");
-        }
+    if (vkCreateImage(device_, &imageInfo, nullptr, &target.image) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create render target image!");
+    }
+    
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(device_, target.image, &memRequirements);
+    target.memory = allocator_.allocate(memRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, true);
+    vkBindImageMemory(device_, target.image, target.memory.memory, target.memory.offset);
+    
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = target.image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = swapChainImageFormat_;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.layerCount = 1;
+    
+    if (vkCreateImageView(device_, &viewInfo, nullptr, &target.view) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create render target image view!");
+    }
+    
+    VkFramebufferCreateInfo framebufferInfo{};
+    framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebufferInfo.renderPass = renderPass;
+    framebufferInfo.attachmentCount = 1;
+    framebufferInfo.pAttachments = &target.view;
+    framebufferInfo.width = width;
+    framebufferInfo.height = height;
+    framebufferInfo.layers = 1;
+    
+    if (vkCreateFramebuffer(device_, &framebufferInfo, nullptr, &target.framebuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create framebuffer!");
+    }
+    target.width = width;
+    target.height = height;
+    
+    // Moved into the layout the render pass expects to find it in ahead of the next frame's passes
+    pendingTransitions_.push_back({target.image, layout});
+}
+
+void VulkanRenderer::destroyColorTarget(RenderTarget& target) {
+    pendingTransitions_.erase(std::remove_if(pendingTransitions_.begin(), pendingTransitions_.end(),
+        [&target](const PendingTransition& transition) { return transition.image == target.image; }), pendingTransitions_.end());
+    if (target.framebuffer != VK_NULL_HANDLE) {
+        vkDestroyFramebuffer(device_, target.framebuffer, nullptr);
+    }
+    if (target.view != VK_NULL_HANDLE) {
+        vkDestroyImageView(device_, target.view, nullptr);
+    }
+    if (target.image != VK_NULL_HANDLE) {
+        vkDestroyImage(device_, target.image, nullptr);
+    }
+    allocator_.free(target.memory);
+    target = RenderTarget();
+}
+
+void VulkanRenderer::retireColorTarget(RenderTarget& target) {
+    // No later frame may transition an image that is on its way out
+    pendingTransitions_.erase(std::remove_if(pendingTransitions_.begin(), pendingTransitions_.end(),
+        [&target](const PendingTransition& transition) { return transition.image == target.image; }), pendingTransitions_.end());
+    RenderTarget retired = target;
+    deferDeletion([this, retired]() mutable { destroyColorTarget(retired); });
+    target = RenderTarget();
+}
+
+void VulkanRenderer::deferDeletion(std::function<void()> destroy) {
+    // The frame being recorded and uploads not yet waited on by a frame are
+    // covered by the next submission
+    uint64_t frame = frameSerial_;
+    if (frameStarted_ || transferOpen_ || !transfersInFlight_.empty()) {
+        frame++;
+    }
+    if (frame <= completedSerial_) {
+        destroy();
+        return;
+    }
+    deletionQueue_.push_back({frame, std::move(destroy)});
+}
+
+void VulkanRenderer::runDeletions() {
+    while (!deletionQueue_.empty() && deletionQueue_.front().frame <= completedSerial_) {
+        std::function<void()> destroy = std::move(deletionQueue_.front().destroy);
+        deletionQueue_.pop_front();
+        destroy();
+    }
+}
+
+void VulkanRenderer::createRenderTarget(uint32_t width, uint32_t height, RenderTarget& target) {
+    createColorTarget(std::max(width, 1u), std::max(height, 1u), VK_IMAGE_USAGE_SAMPLED_BIT,
+                      targetRenderPass_, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, target);
+    // Targets start from an opaque clear, so compositing them needs no blending
+    textureModes_[target.view] = TextureMode::Opaque;
+}
+
+void VulkanRenderer::destroyRenderTarget(RenderTarget& target) {
+    if (target.image == VK_NULL_HANDLE) {
+        return;
+    }
+    
+    // Frames in flight may still sample it, so its descriptor set goes with it
+    auto it = descriptorSets_.find(target.view);
+    if (it != descriptorSets_.end()) {
+        VkDescriptorSet descriptorSet = it->second;
+        deferDeletion([this, descriptorSet]() { vkFreeDescriptorSets(device_, descriptorPool_, 1, &descriptorSet); });
+        descriptorSets_.erase(it);
+    }
+    textureModes_.erase(target.view);
+    
+    retireColorTarget(target);
+}
+
+void VulkanRenderer::beginTarget(const RenderTarget& target) {
+    openTargets_.push_back({target.framebuffer, target.width, target.height, {}});
+    currentBatches_ = &openTargets_.back().batches;
+}
+
+void VulkanRenderer::endTarget() {
+    // Passes are recorded in the order they end, so a nested target is drawn before the one sampling it
+    targetPasses_.push_back(std::move(openTargets_.back()));
+    openTargets_.pop_back();
+    currentBatches_ = openTargets_.empty() ? &drawBatches_ : &openTargets_.back().batches;
+}
+
+void VulkanRenderer::resetDamage() {
+    // Nothing valid is retained yet: the scene and every swap chain image need a full redraw
+    int32_t width = static_cast<int32_t>(swapChainExtent_.width);
+    int32_t height = static_cast<int32_t>(swapChainExtent_.height);
+    frameDamage_.setBounds(width, height);
+    frameDamage_.addAll();
+    imageDamage_.assign(swapChainImages_.size(), DamageRegion());
+    for (auto& damage : imageDamage_) {
+        damage.setBounds(width, height);
+        damage.addAll();
     }
 }
 
@@ -736,7 +1329,7 @@ void VulkanRenderer::createCommandPool() {
 }
 
 void VulkanRenderer::createCommandBuffers() {
-    commandBuffers_.resize(MAX_FRAMES_IN_FLIGHT);
+    commandBuffers_.resize(framesInFlight_);
     
     VkCommandBufferAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -750,9 +1343,9 @@ void VulkanRenderer::createCommandBuffers() {
 }
 
 void VulkanRenderer::createSyncObjects() {
-    imageAvailableSemaphores_.resize(MAX_FRAMES_IN_FLIGHT);
-    renderFinishedSemaphores_.resize(MAX_FRAMES_IN_FLIGHT);
-    inFlightFences_.resize(MAX_FRAMES_IN_FLIGHT);
+    imageAvailableSemaphores_.resize(framesInFlight_);
+    renderFinishedSemaphores_.resize(framesInFlight_);
+    inFlightFences_.resize(framesInFlight_);
     
     VkSemaphoreCreateInfo semaphoreInfo{};
     semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
@@ -761,7 +1354,7 @@ void VulkanRenderer::createSyncObjects() {
     fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
     fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
     
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+    for (size_t i = 0; i < framesInFlight_; i++) {
         if (vkCreateSemaphore(device_, &semaphoreInfo, nullptr, &imageAvailableSemaphores_[i]) != VK_SUCCESS ||
             vkCreateSemaphore(device_, &semaphoreInfo, nullptr, &renderFinishedSemaphores_[i]) != VK_SUCCESS ||
             vkCreateFence(device_, &fenceInfo, nullptr, &inFlightFences_[i]) != VK_SUCCESS) {
@@ -775,12 +1368,7 @@ void VulkanRenderer::cleanupSwapChain() {
         return; // Device not initialized, nothing to clean up
     }
     
-    for (auto framebuffer : swapChainFramebuffers_) {
-        if (framebuffer != VK_NULL_HANDLE) {
-            vkDestroyFramebuffer(device_, framebuffer, nullptr);
-        }
-    }
-    swapChainFramebuffers_.clear();
+    destroyColorTarget(scene_);
     
     for (auto imageView : swapChainImageViews_) {
         if (imageView != VK_NULL_HANDLE) {
@@ -803,15 +1391,25 @@ void VulkanRenderer::recreateSwapChain() {
         glfwWaitEvents();
     }
     
-    vkDeviceWaitIdle(device_);
-    
-    cleanupSwapChain();
+    // No idling the device: everything the frames in flight still use is
+    // released once they finish, while the new swap chain takes over
+    std::vector<VkImageView> oldImageViews = std::move(swapChainImageViews_);
+    swapChainImageViews_.clear();
+    deferDeletion([this, oldImageViews]() {
+        for (auto imageView : oldImageViews) {
+            vkDestroyImageView(device_, imageView, nullptr);
+        }
+    });
+    retireColorTarget(scene_);
     
     createSwapChain();
     createImageViews();
-    createFramebuffers();
+    createSceneTarget();
     
-    // Viewport and pipeline don't need recreation - they adapt automatically
+    // Viewport and scissor are dynamic, so the pipeline doesn't need recreation
+    if (onSwapChainRecreated) {
+        onSwapChainRecreated();
+    }
 }
 
 namespace {
@@ -822,19 +1420,41 @@ uint32_t VulkanRenderer::getCurrentImageIndex() const {
     return currentImageIndex;
 }
 
-void VulkanRenderer::beginFrame() {
+bool VulkanRenderer::beginFrame() {
     vkWaitForFences(device_, 1, &inFlightFences_[currentFrame_], VK_TRUE, UINT64_MAX);
+    completedSerial_ = std::max(completedSerial_, frames_[currentFrame_].serial);
+    runDeletions();
     
-    VkResult result = vkAcquireNextImageKHR(device_, swapChain_, UINT64_MAX, imageAvailableSemaphores_[currentFrame_], VK_NULL_HANDLE, &currentImageIndex);
-    
-    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
-        recreateSwapChain();
-        return;
-    } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
-        throw std::runtime_error("failed to acquire swap chain image!");
+    if (window_) {
+        VkResult result = vkAcquireNextImageKHR(device_, swapChain_, UINT64_MAX, imageAvailableSemaphores_[currentFrame_], VK_NULL_HANDLE, &currentImageIndex);
+        
+        if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+            recreateSwapChain();
+            return false;
+        } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+            throw std::runtime_error("failed to acquire swap chain image!");
+        }
     }
     
     vkResetFences(device_, 1, &inFlightFences_[currentFrame_]);
+    retireTransfers();
+    
+    // The fence has signalled, so this slot's timestamps are ready without waiting
+    readTimestamps(frames_[currentFrame_]);
+    
+    // This frame's staging memory is free again unless uploads from a skipped frame still live in it
+    if (pendingUploads_.empty()) {
+        resetStaging(frames_[currentFrame_]);
+    }
+    frameQuads_.clear();
+    frameGlyphs_.clear();
+    frameGridStates_.clear();
+    drawBatches_.clear();
+    targetPasses_.clear();
+    openTargets_.clear();
+    currentBatches_ = &drawBatches_;
+    currentPhase_ = RenderPhase::PaneContent;
+    frameCounters_ = FrameCounters();
     
     vkResetCommandBuffer(commandBuffers_[currentFrame_], 0);
     
@@ -845,34 +1465,117 @@ void VulkanRenderer::beginFrame() {
         throw std::runtime_error("failed to begin recording command buffer!");
     }
     
-    VkRenderPassBeginInfo renderPassInfo{};
-    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderPassInfo.renderPass = renderPass_;
-    renderPassInfo.framebuffer = swapChainFramebuffers_[currentImageIndex];
-    renderPassInfo.renderArea.offset = {0, 0};
-    renderPassInfo.renderArea.extent = swapChainExtent_;
-    
-    VkClearValue clearColor = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
-    renderPassInfo.clearValueCount = 1;
-    renderPassInfo.pClearValues = &clearColor;
+    FrameResources& frame = frames_[currentFrame_];
+    if (frame.queryPool != VK_NULL_HANDLE) {
+        vkCmdResetQueryPool(commandBuffers_[currentFrame_], frame.queryPool, 0, MAX_TIMESTAMPS);
+        vkCmdWriteTimestamp(commandBuffers_[currentFrame_], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.queryPool, 0);
+        frame.queryPhases[0] = RenderPhase::Count;
+        frame.queryCount = 1;
+        frame.openPhase = RenderPhase::Count;
+    }
     
-    vkCmdBeginRenderPass(commandBuffers_[currentFrame_], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    frameStarted_ = true;
+    return true;
 }
 
 void VulkanRenderer::endFrame() {
+    if (!frameStarted_) {
+        return; // beginFrame() bailed out to recreate the swap chain
+    }
+    frameStarted_ = false;
+    
+    VkCommandBuffer cmd = commandBuffers_[currentFrame_];
+    
+    // Transfers must be recorded outside the render pass
+    recordTargetTransitions(cmd);
+    recordPendingUploads(cmd);
+    uploadVertices();
+    recordTargetPasses(cmd);
+    
+    if (!frameDamage_.empty()) {
+        // Only the damaged area is touched; the rest of the scene keeps last frame's pixels
+        DamageRect bounds = frameDamage_.getBounds();
+        VkRenderPassBeginInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = renderPass_;
+        renderPassInfo.framebuffer = scene_.framebuffer;
+        renderPassInfo.renderArea.offset = {bounds.x, bounds.y};
+        renderPassInfo.renderArea.extent = {static_cast<uint32_t>(bounds.width), static_cast<uint32_t>(bounds.height)};
+        
+        vkCmdBeginRenderPass(cmd, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        
+        VkClearAttachment clearAttachment{};
+        clearAttachment.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        clearAttachment.colorAttachment = 0;
+        clearAttachment.clearValue = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
+        
+        std::vector<VkClearRect> clearRects;
+        for (const auto& rect : frameDamage_.getRects()) {
+            VkClearRect clearRect{};
+            clearRect.rect.offset = {rect.x, rect.y};
+            clearRect.rect.extent = {static_cast<uint32_t>(rect.width), static_cast<uint32_t>(rect.height)};
+            clearRect.layerCount = 1;
+            clearRects.push_back(clearRect);
+        }
+        writeTimestamp(cmd, RenderPhase::Background);
+        vkCmdClearAttachments(cmd, 1, &clearAttachment, static_cast<uint32_t>(clearRects.size()), clearRects.data());
+        
+        recordDrawBatches(cmd, drawBatches_, frameDamage_.getRects(), swapChainExtent_.width, swapChainExtent_.height);
+        
+        vkCmdEndRenderPass(cmd);
+    }
+    
+    for (auto& damage : imageDamage_) {
+        damage.add(frameDamage_);
+    }
+    if (window_) {
+        recordSceneCopy(cmd);
+    }
+    recordCapture(cmd);
     
-    vkCmdEndRenderPass(commandBuffers_[currentFrame_]);
+    // Closes the last stretch; uploads and copies in between count only toward the frame
+    FrameResources& frame = frames_[currentFrame_];
+    if (frame.queryPool != VK_NULL_HANDLE) {
+        vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.queryPool, frame.queryCount);
+        frame.queryPhases[frame.queryCount++] = RenderPhase::Count;
+    }
     
-    if (vkEndCommandBuffer(commandBuffers_[currentFrame_]) != VK_SUCCESS) {
+    if (vkEndCommandBuffer(cmd) != VK_SUCCESS) {
         throw std::runtime_error("failed to record command buffer!");
     }
     
+    // Textures created during the frame are uploaded ahead of it
+    flushTransfers();
+    
+    frameCounters_.descriptorSets = static_cast<uint32_t>(descriptorSets_.size());
+    lastCounters_ = frameCounters_;
+    frame.serial = ++frameSerial_;
+    
     VkSubmitInfo submitInfo{};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
     
-    VkSemaphore waitSemaphores[] = {imageAvailableSemaphores_[currentFrame_]};
-    VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-    submitInfo.waitSemaphoreCount = 1;
+    VkSemaphore waitSemaphores[2];
+    VkPipelineStageFlags waitStages[2];
+    uint64_t waitValues[2] = {}; // Ignored for the binary semaphore
+    uint32_t waitCount = 0;
+    if (window_) {
+        // The swap chain image is only written by the copy
+        waitSemaphores[waitCount] = imageAvailableSemaphores_[currentFrame_];
+        waitStages[waitCount++] = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    }
+    
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    if (transferTimeline_ != VK_NULL_HANDLE) {
+        // Uploads are needed by the first copy into or sample of their image
+        waitSemaphores[waitCount] = transferTimeline_;
+        waitValues[waitCount] = transferValue_;
+        waitStages[waitCount++] = VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timelineInfo.waitSemaphoreValueCount = waitCount;
+        timelineInfo.pWaitSemaphoreValues = waitValues;
+        submitInfo.pNext = &timelineInfo;
+    }
+    submitInfo.waitSemaphoreCount = waitCount;
     submitInfo.pWaitSemaphores = waitSemaphores;
     submitInfo.pWaitDstStageMask = waitStages;
     
@@ -880,13 +1583,21 @@ void VulkanRenderer::endFrame() {
     submitInfo.pCommandBuffers = &commandBuffers_[currentFrame_];
     
     VkSemaphore signalSemaphores[] = {renderFinishedSemaphores_[currentFrame_]};
-    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.signalSemaphoreCount = window_ ? 1 : 0;
     submitInfo.pSignalSemaphores = signalSemaphores;
     
     if (vkQueueSubmit(graphicsQueue_, 1, &submitInfo, inFlightFences_[currentFrame_]) != VK_SUCCESS) {
         throw std::runtime_error("failed to submit draw command buffer!");
     }
     
+    if (!window_) {
+        // Headless: the scene target is the result, there is nothing to present
+        recordFirstFrame();
+        frameDamage_.clear();
+        currentFrame_ = (currentFrame_ + 1) % framesInFlight_;
+        return;
+    }
+    
     VkPresentInfoKHR presentInfo{};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
     presentInfo.waitSemaphoreCount = 1;
@@ -897,6 +1608,38 @@ void VulkanRenderer::endFrame() {
     presentInfo.pSwapchains = swapChains;
     presentInfo.pImageIndices = &currentImageIndex;
     
+    // Tell the compositor which parts changed since the previous present
+    std::vector<VkRectLayerKHR> presentRects;
+    VkPresentRegionKHR presentRegion{};
+    VkPresentRegionsKHR presentRegions{};
+    if (incrementalPresentSupported_ && !frameDamage_.empty() && !frameDamage_.isFull()) {
+        for (const auto& rect : frameDamage_.getRects()) {
+            VkRectLayerKHR presentRect{};
+            presentRect.offset = {rect.x, rect.y};
+            presentRect.extent = {static_cast<uint32_t>(rect.width), static_cast<uint32_t>(rect.height)};
+            presentRects.push_back(presentRect);
+        }
+        presentRegion.rectangleCount = static_cast<uint32_t>(presentRects.size());
+        presentRegion.pRectangles = presentRects.data();
+        presentRegions.sType = VK_STRUCTURE_TYPE_PRESENT_REGIONS_KHR;
+        presentRegions.swapchainCount = 1;
+        presentRegions.pRegions = &presentRegion;
+        presentInfo.pNext = &presentRegions;
+    }
+    frameDamage_.clear();
+    
+    // Tagged so getDisplayTiming() can find out when it reached the screen
+    VkPresentTimeGOOGLE presentTime{};
+    VkPresentTimesInfoGOOGLE presentTimes{};
+    if (displayTimingSupported_) {
+        presentTime.presentID = ++presentId_;
+        presentTimes.sType = VK_STRUCTURE_TYPE_PRESENT_TIMES_INFO_GOOGLE;
+        presentTimes.pNext = presentInfo.pNext;
+        presentTimes.swapchainCount = 1;
+        presentTimes.pTimes = &presentTime;
+        presentInfo.pNext = &presentTimes;
+    }
+    
     VkResult result = vkQueuePresentKHR(presentQueue_, &presentInfo);
     
     if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized_) {
@@ -906,45 +1649,135 @@ void VulkanRenderer::endFrame() {
         throw std::runtime_error("failed to present swap chain image!");
     }
     
-    currentFrame_ = (currentFrame_ + 1) % MAX_FRAMES_IN_FLIGHT;
+    recordFirstFrame();
+    currentFrame_ = (currentFrame_ + 1) % framesInFlight_;
 }
 
-void VulkanRenderer::createTexture(uint32_t width, uint32_t height, const void* data, VkImage& image, VkDeviceMemory& memory, VkImageView& view) {
-    VkImageCreateInfo imageInfo{};
-    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-    imageInfo.imageType = VK_IMAGE_TYPE_2D;
-    imageInfo.extent.width = width;
-    imageInfo.extent.height = height;
-    imageInfo.extent.depth = 1;
-    imageInfo.mipLevels = 1;
-    imageInfo.arrayLayers = 1;
-    imageInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
-    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    
-    if (vkCreateImage(device_, &imageInfo, nullptr, &image) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create image!");
+void VulkanRenderer::recordFirstFrame() {
+    if (firstFrameMs_ == 0.0) {
+        firstFrameMs_ = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - PROCESS_START).count();
+    }
+}
+
+void VulkanRenderer::setFramesInFlight(uint32_t count) {
+    if (device_ != VK_NULL_HANDLE) {
+        std::cerr << "Warning: Frames in flight can only be set before init()" << std::endl;
+        return;
+    }
+    framesInFlight_ = std::clamp<uint32_t>(count, 1, MAX_FRAMES_IN_FLIGHT);
+}
+
+void VulkanRenderer::setPresentMode(VkPresentModeKHR mode) {
+    if (mode == presentMode_) {
+        return;
+    }
+    presentMode_ = mode;
+    if (swapChain_ != VK_NULL_HANDLE) {
+        recreateSwapChain();
+    }
+}
+
+bool VulkanRenderer::getDisplayTiming(double& refreshPeriod, double& lastVblank) {
+    if (!displayTimingSupported_ || refreshDurationNs_ == 0) {
+        return false;
+    }
+    
+    // Never blocks; only presents the driver has already timed are returned
+    uint32_t count = 0;
+    if (getPastPresentationTiming_(device_, swapChain_, &count, nullptr) == VK_SUCCESS && count > 0) {
+        std::vector<VkPastPresentationTimingGOOGLE> timings(count);
+        if (getPastPresentationTiming_(device_, swapChain_, &count, timings.data()) >= VK_SUCCESS) {
+            for (uint32_t i = 0; i < count; ++i) {
+                lastVblankNs_ = std::max(lastVblankNs_, timings[i].actualPresentTime);
+            }
+        }
+    }
+    if (lastVblankNs_ == 0) {
+        return false;
+    }
+    
+    // Present times are CLOCK_MONOTONIC, which steady_clock is on Linux
+    refreshPeriod = refreshDurationNs_ / 1.0e9;
+    lastVblank = lastVblankNs_ / 1.0e9;
+    return true;
+}
+
+bool VulkanRenderer::parsePresentMode(const std::string& name, VkPresentModeKHR& mode) {
+    if (name == "fifo") {
+        mode = VK_PRESENT_MODE_FIFO_KHR;
+    } else if (name == "fifo-relaxed") {
+        mode = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+    } else if (name == "mailbox") {
+        mode = VK_PRESENT_MODE_MAILBOX_KHR;
+    } else if (name == "immediate") {
+        mode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void VulkanRenderer::createTexture(uint32_t width, uint32_t height, const void* data, VkImage& image, MemoryAllocation& memory, VkImageView& view, VkFormat format, uint32_t mipLevels) {
+    VkDeviceSize bytesPerPixel = format == VK_FORMAT_R8_UNORM ? 1 : 4;
+    
+    // One copy per mip level, each reading its level from the packed data
+    std::vector<VkBufferImageCopy> regions(mipLevels);
+    VkDeviceSize imageSize = 0;
+    for (uint32_t level = 0; level < mipLevels; ++level) {
+        uint32_t levelWidth = std::max(width >> level, 1u);
+        uint32_t levelHeight = std::max(height >> level, 1u);
+        VkBufferImageCopy& region = regions[level];
+        region.bufferOffset = imageSize;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = level;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageOffset = {0, 0, 0};
+        region.imageExtent = {levelWidth, levelHeight, 1};
+        imageSize += static_cast<VkDeviceSize>(levelWidth) * levelHeight * bytesPerPixel;
     }
     
-    VkMemoryRequirements memRequirements;
-    vkGetImageMemoryRequirements(device_, image, &memRequirements);
-    
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent.width = width;
+    imageInfo.extent.height = height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = mipLevels;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = format;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
     
-    if (vkAllocateMemory(device_, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate image memory!");
+    // Written by the transfer queue, then sampled by the graphics queue without an ownership transfer
+    bool dedicatedTransfer = transferFamily_ != graphicsFamily_;
+    uint32_t queueFamilies[] = {graphicsFamily_, transferFamily_};
+    if (dedicatedTransfer) {
+        imageInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        imageInfo.queueFamilyIndexCount = 2;
+        imageInfo.pQueueFamilyIndices = queueFamilies;
+    }
+    
+    if (vkCreateImage(device_, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create image!");
     }
     
-    vkBindImageMemory(device_, image, memory, 0);
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(device_, image, &memRequirements);
+    memory = allocator_.allocate(memRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, true);
+    vkBindImageMemory(device_, image, memory.memory, memory.offset);
+    
+    // Staged in the upload ring and recorded into the open transfer batch
+    VkBuffer stagingBuffer;
+    VkDeviceSize stagingOffset = stageTransfer(data, imageSize, stagingBuffer);
+    for (auto& region : regions) {
+        region.bufferOffset += stagingOffset;
+    }
     
-    // Transition image layout and copy data
-    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+    VkCommandBuffer commandBuffer = beginTransfer();
     
     VkImageMemoryBarrier barrier{};
     barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -955,7 +1788,7 @@ void VulkanRenderer::createTexture(uint32_t width, uint32_t height, const void*
     barrier.image = image;
     barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
     barrier.subresourceRange.baseMipLevel = 0;
-    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.levelCount = mipLevels;
     barrier.subresourceRange.baseArrayLayer = 0;
     barrier.subresourceRange.layerCount = 1;
     barrier.srcAccessMask = 0;
@@ -963,81 +1796,852 @@ void VulkanRenderer::createTexture(uint32_t width, uint32_t height, const void*
     
     vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
     
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    VkDeviceSize imageSize = width * height * 4;
-    
-    createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-    
-    void* bufferData;
-    vkMapMemory(device_, stagingBufferMemory, 0, imageSize, 0, &bufferData);
-    memcpy(bufferData, data, static_cast<size_t>(imageSize));
-    vkUnmapMemory(device_, stagingBufferMemory);
-    
-    VkBufferImageCopy region{};
-    region.bufferOffset = 0;
-    region.bufferRowLength = 0;
-    region.bufferImageHeight = 0;
-    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    region.imageSubresource.mipLevel = 0;
-    region.imageSubresource.baseArrayLayer = 0;
-    region.imageSubresource.layerCount = 1;
-    region.imageOffset = {0, 0, 0};
-    region.imageExtent = {width, height, 1};
-    
-    vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+    vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels, regions.data());
     
     barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
     barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
     barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
     barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    VkPipelineStageFlags dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    if (dedicatedTransfer) {
+        // A transfer queue has no shader stages; the frame's semaphore wait orders the sampling instead
+        barrier.dstAccessMask = 0;
+        dstStage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+    }
     
-    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
-    
-    endSingleTimeCommands(commandBuffer);
-    
-    vkDestroyBuffer(device_, stagingBuffer, nullptr);
-    vkFreeMemory(device_, stagingBufferMemory, nullptr);
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
     
     VkImageViewCreateInfo viewInfo{};
     viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
     viewInfo.image = image;
     viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    viewInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+    viewInfo.format = format;
+    if (format == VK_FORMAT_R8_UNORM) {
+        // Coverage textures read as (1, 1, 1, r) so the text shader can treat them like RGBA
+        viewInfo.components = {VK_COMPONENT_SWIZZLE_ONE, VK_COMPONENT_SWIZZLE_ONE, VK_COMPONENT_SWIZZLE_ONE, VK_COMPONENT_SWIZZLE_R};
+    }
     viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
     viewInfo.subresourceRange.baseMipLevel = 0;
-    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.levelCount = mipLevels;
     viewInfo.subresourceRange.baseArrayLayer = 0;
     viewInfo.subresourceRange.layerCount = 1;
     
     if (vkCreateImageView(device_, &viewInfo, nullptr, &view) != VK_SUCCESS) {
         throw std::runtime_error("failed to create texture image view!");
     }
+    if (format == VK_FORMAT_R8_UNORM) {
+        textureModes_[view] = TextureMode::Coverage;
+    }
 }
 
-void VulkanRenderer::destroyTexture(VkImage image, VkDeviceMemory memory, VkImageView view) {
-    vkDestroyImageView(device_, view, nullptr);
-    vkFreeMemory(device_, memory, nullptr);
-    vkDestroyImage(device_, image, nullptr);
+void VulkanRenderer::destroyTexture(VkImage image, const MemoryAllocation& memory, VkImageView view) {
+    // Drop uploads and the cached descriptor set that still reference this texture
+    pendingUploads_.erase(std::remove_if(pendingUploads_.begin(), pendingUploads_.end(),
+        [image](const PendingUpload& upload) { return upload.image == image; }), pendingUploads_.end());
+    
+    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+    auto it = descriptorSets_.find(view);
+    if (it != descriptorSets_.end()) {
+        descriptorSet = it->second;
+        descriptorSets_.erase(it);
+    }
+    textureModes_.erase(view);
+    
+    // Frames in flight may sample it and its initial upload may still be running
+    deferDeletion([this, image, memory, view, descriptorSet]() {
+        if (descriptorSet != VK_NULL_HANDLE) {
+            vkFreeDescriptorSets(device_, descriptorPool_, 1, &descriptorSet);
+        }
+        vkDestroyImageView(device_, view, nullptr);
+        vkDestroyImage(device_, image, nullptr);
+        allocator_.free(memory);
+    });
 }
 
 void VulkanRenderer::renderQuad(float x, float y, float width, float height, VkImageView texture, float r, float g, float b, float a, float u0, float v0, float u1, float v1) {
-    VkCommandBuffer cmd = getCurrentCommandBuffer();
+    uint32_t firstQuad = static_cast<uint32_t>(frameQuads_.size());
+    frameQuads_.push_back({x, y, x + width, y + height, u0, v0, u1, v1, {r, g, b, a}});
+    
+    float minX = std::min(x, x + width), maxX = std::max(x, x + width);
+    float minY = std::min(y, y + height), maxY = std::max(y, y + height);
+    PipelineKind pipeline = getPipelineKind(texture);
+    
+    // Consecutive quads sharing a texture become a single draw
+    std::vector<DrawBatch>& batches = *currentBatches_;
+    if (!batches.empty() && batches.back().texture == texture && batches.back().pipeline == pipeline &&
+        batches.back().phase == currentPhase_ && batches.back().firstQuad + batches.back().quadCount == firstQuad) {
+        DrawBatch& batch = batches.back();
+        batch.quadCount++;
+        batch.x0 = std::min(batch.x0, minX);
+        batch.y0 = std::min(batch.y0, minY);
+        batch.x1 = std::max(batch.x1, maxX);
+        batch.y1 = std::max(batch.y1, maxY);
+    } else {
+        DrawBatch batch{};
+        batch.texture = texture;
+        batch.pipeline = pipeline;
+        batch.phase = currentPhase_;
+        batch.firstQuad = firstQuad;
+        batch.quadCount = 1;
+        batch.x0 = minX;
+        batch.y0 = minY;
+        batch.x1 = maxX;
+        batch.y1 = maxY;
+        batches.push_back(batch);
+    }
+}
+
+void VulkanRenderer::renderGrid(float x, float y, float width, float height, VkImageView image, const GridState& state) {
+    uint32_t firstQuad = static_cast<uint32_t>(frameQuads_.size());
+    Quad quad{x, y, x + width, y + height, 0.0f, 0.0f, 1.0f, 1.0f, {1.0f, 1.0f, 1.0f, 1.0f}};
+    quad.grid = static_cast<uint32_t>(frameGridStates_.size());
+    frameQuads_.push_back(quad);
+    frameGridStates_.push_back(state);
+    
+    // Each grid is a draw of its own; the image differs from pane to pane anyway
+    DrawBatch batch{};
+    batch.texture = image;
+    batch.pipeline = PipelineKind::Grid;
+    batch.phase = currentPhase_;
+    batch.firstQuad = firstQuad;
+    batch.quadCount = 1;
+    batch.x0 = std::min(x, x + width);
+    batch.y0 = std::min(y, y + height);
+    batch.x1 = std::max(x, x + width);
+    batch.y1 = std::max(y, y + height);
+    currentBatches_->push_back(batch);
+}
+
+uint32_t VulkanRenderer::createDrawList() {
+    uint32_t list = nextDrawList_++;
+    drawLists_[list];
+    return list;
+}
+
+void VulkanRenderer::destroyDrawList(uint32_t list) {
+    drawLists_.erase(list);
+}
+
+void VulkanRenderer::beginRecording(uint32_t list) {
+    if (recordingList_) {
+        throw std::runtime_error("draw list recordings can't nest!");
+    }
+    recordingList_ = &drawLists_[list];
+    recordingList_->batches.clear();
+    recordingParent_ = currentBatches_;
+    currentBatches_ = &recordingList_->batches;
+    recordingQuadBase_ = frameQuads_.size();
+    recordingGlyphBase_ = frameGlyphs_.size();
+}
+
+void VulkanRenderer::endRecording() {
+    if (!recordingList_) {
+        return;
+    }
+    
+    // What was drawn since beginRecording() moves from the frame into the list
+    DrawList& list = *recordingList_;
+    list.quads.assign(frameQuads_.begin() + recordingQuadBase_, frameQuads_.end());
+    list.glyphs.assign(frameGlyphs_.begin() + recordingGlyphBase_, frameGlyphs_.end());
+    frameQuads_.resize(recordingQuadBase_);
+    frameGlyphs_.resize(recordingGlyphBase_);
+    for (auto& batch : list.batches) {
+        bool glyphs = getVertexFormat(batch.pipeline) == VertexFormat::Glyph;
+        batch.firstQuad -= static_cast<uint32_t>(glyphs ? recordingGlyphBase_ : recordingQuadBase_);
+    }
+    
+    currentBatches_ = recordingParent_;
+    recordingList_ = nullptr;
+    recordingParent_ = nullptr;
+}
+
+void VulkanRenderer::drawList(uint32_t list) {
+    auto it = drawLists_.find(list);
+    if (it == drawLists_.end()) {
+        return;
+    }
+    
+    // Appended as if drawn now, in the current phase
+    const DrawList& recorded = it->second;
+    uint32_t quadBase = static_cast<uint32_t>(frameQuads_.size());
+    uint32_t glyphBase = static_cast<uint32_t>(frameGlyphs_.size());
+    frameQuads_.insert(frameQuads_.end(), recorded.quads.begin(), recorded.quads.end());
+    frameGlyphs_.insert(frameGlyphs_.end(), recorded.glyphs.begin(), recorded.glyphs.end());
+    for (DrawBatch batch : recorded.batches) {
+        batch.firstQuad += getVertexFormat(batch.pipeline) == VertexFormat::Glyph ? glyphBase : quadBase;
+        batch.phase = currentPhase_;
+        currentBatches_->push_back(batch);
+    }
+}
+
+std::vector<VkImageView> VulkanRenderer::getDrawListTextures(uint32_t list) const {
+    std::vector<VkImageView> textures;
+    auto it = drawLists_.find(list);
+    if (it != drawLists_.end()) {
+        for (const auto& batch : it->second.batches) {
+            if (batch.texture != VK_NULL_HANDLE && std::find(textures.begin(), textures.end(), batch.texture) == textures.end()) {
+                textures.push_back(batch.texture);
+            }
+        }
+    }
+    return textures;
+}
+
+void VulkanRenderer::setGlyphSlot(uint32_t slot, const GlyphSlot& data) {
+    if (slot >= MAX_GLYPH_SLOTS) {
+        return;
+    }
+    if (slot >= glyphSlots_.size()) {
+        glyphSlots_.resize(slot + 1, GlyphSlot{});
+    }
+    glyphSlots_[slot] = data;
+    glyphSlotVersion_++;
+}
+
+void VulkanRenderer::renderGlyph(float x, float y, uint32_t slot, VkImageView page, uint32_t color) {
+    if (slot >= glyphSlots_.size()) {
+        return;
+    }
+    
+    // Whole pixels; the slot's offsets carry the glyph's position relative to the pen
+    auto toPixel = [](float value) {
+        return static_cast<int16_t>(std::clamp(std::lround(value), -32768l, 32767l));
+    };
+    GlyphInstance instance{{toPixel(x), toPixel(y)}, static_cast<uint16_t>(slot), 0, color};
+    uint32_t firstGlyph = static_cast<uint32_t>(frameGlyphs_.size());
+    frameGlyphs_.push_back(instance);
+    
+    const GlyphSlot& data = glyphSlots_[slot];
+    float minX = instance.pen[0] + data.x, maxX = minX + data.width;
+    float minY = instance.pen[1] + data.y, maxY = minY + data.height;
+    PipelineKind pipeline = getGlyphPipelineKind(page);
+    
+    // Consecutive glyphs from one atlas page become a single instanced draw
+    std::vector<DrawBatch>& batches = *currentBatches_;
+    if (!batches.empty() && batches.back().texture == page && batches.back().pipeline == pipeline &&
+        batches.back().phase == currentPhase_ && batches.back().firstQuad + batches.back().quadCount == firstGlyph) {
+        DrawBatch& batch = batches.back();
+        batch.quadCount++;
+        batch.x0 = std::min(batch.x0, minX);
+        batch.y0 = std::min(batch.y0, minY);
+        batch.x1 = std::max(batch.x1, maxX);
+        batch.y1 = std::max(batch.y1, maxY);
+    } else {
+        DrawBatch batch{};
+        batch.texture = page;
+        batch.pipeline = pipeline;
+        batch.phase = currentPhase_;
+        batch.firstQuad = firstGlyph;
+        batch.quadCount = 1;
+        batch.x0 = minX;
+        batch.y0 = minY;
+        batch.x1 = maxX;
+        batch.y1 = maxY;
+        batches.push_back(batch);
+    }
+}
+
+VulkanRenderer::PipelineKind VulkanRenderer::getPipelineKind(VkImageView texture) const {
+    if (texture == VK_NULL_HANDLE) {
+        return PipelineKind::Solid;
+    }
+    auto mode = textureModes_.find(texture);
+    if (mode != textureModes_.end() && mode->second == TextureMode::Opaque) {
+        return PipelineKind::Image;
+    }
+    return PipelineKind::Textured;
+}
+
+VulkanRenderer::PipelineKind VulkanRenderer::getGlyphPipelineKind(VkImageView page) const {
+    auto mode = textureModes_.find(page);
+    switch (mode != textureModes_.end() ? mode->second : TextureMode::Color) {
+        case TextureMode::Coverage: return PipelineKind::Glyph;
+        case TextureMode::DistanceField: return PipelineKind::DistanceFieldGlyph;
+        case TextureMode::Color:
+        case TextureMode::Opaque: break;
+    }
+    return PipelineKind::ColorGlyph;
+}
+
+VulkanRenderer::VertexFormat VulkanRenderer::getVertexFormat(PipelineKind pipeline) {
+    switch (pipeline) {
+        case PipelineKind::Solid: return VertexFormat::Solid;
+        case PipelineKind::Textured: return VertexFormat::Textured;
+        case PipelineKind::Image: return VertexFormat::Image;
+        case PipelineKind::Grid: return VertexFormat::Grid;
+        default: return VertexFormat::Glyph;
+    }
+}
+
+void VulkanRenderer::orderDrawBatches(std::vector<DrawBatch>& batches) {
+    if (batches.size() < 3) {
+        return;
+    }
+    // Batches of the same texture (and so pipeline) are drawn back to back where that can't change the image
+    std::unordered_map<VkImageView, uint32_t> states;
+    std::vector<BatchBounds> bounds;
+    bounds.reserve(batches.size());
+    for (const auto& batch : batches) {
+        uint32_t state = states.emplace(batch.texture, static_cast<uint32_t>(states.size())).first->second;
+        bounds.push_back({state, static_cast<uint32_t>(batch.phase), batch.x0, batch.y0, batch.x1, batch.y1});
+    }
+    std::vector<DrawBatch> ordered;
+    ordered.reserve(batches.size());
+    for (uint32_t index : orderBatches(bounds)) {
+        ordered.push_back(batches[index]);
+    }
+    batches.swap(ordered);
+}
+
+void VulkanRenderer::queueImageUpload(VkImage image, uint32_t x, uint32_t y, uint32_t width, uint32_t height, const void* data, uint32_t bytesPerPixel) {
+    if (width == 0 || height == 0) {
+        return;
+    }
+    
+    FrameResources& frame = frames_[currentFrame_];
+    if (!frameStarted_ && pendingUploads_.empty()) {
+        // Outside a frame the previous submission of this slot may still read its staging memory
+        vkWaitForFences(device_, 1, &inFlightFences_[currentFrame_], VK_TRUE, UINT64_MAX);
+        resetStaging(frame);
+    }
+    
+    VkDeviceSize size = static_cast<VkDeviceSize>(width) * height * bytesPerPixel;
+    
+    StagingChunk* chunk = nullptr;
+    for (auto& candidate : frame.staging) {
+        // Buffer offsets for image copies must be a multiple of the texel size (and of 4)
+        VkDeviceSize offset = (candidate.offset + 3) & ~VkDeviceSize(3);
+        if (offset + size <= candidate.size) {
+            candidate.offset = offset;
+            chunk = &candidate;
+            break;
+        }
+    }
+    
+    if (!chunk) {
+        StagingChunk newChunk;
+        newChunk.size = std::max(STAGING_CHUNK_SIZE, size);
+        createBuffer(newChunk.size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, newChunk.buffer, newChunk.memory);
+        newChunk.mapped = newChunk.memory.mapped;
+        frame.staging.push_back(newChunk);
+        chunk = &frame.staging.back();
+    }
+    
+    memcpy(static_cast<char*>(chunk->mapped) + chunk->offset, data, static_cast<size_t>(size));
+    
+    PendingUpload upload{};
+    upload.image = image;
+    upload.buffer = chunk->buffer;
+    upload.region.bufferOffset = chunk->offset;
+    upload.region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    upload.region.imageSubresource.layerCount = 1;
+    upload.region.imageOffset = {static_cast<int32_t>(x), static_cast<int32_t>(y), 0};
+    upload.region.imageExtent = {width, height, 1};
+    pendingUploads_.push_back(upload);
+    
+    chunk->offset += size;
+}
+
+void VulkanRenderer::setTextureMode(VkImageView view, TextureMode mode) {
+    if (mode == TextureMode::Color) {
+        textureModes_.erase(view);
+    } else {
+        textureModes_[view] = mode;
+    }
+}
+
+void VulkanRenderer::recordPendingUploads(VkCommandBuffer cmd) {
+    if (pendingUploads_.empty()) {
+        return;
+    }
+    
+    // Group by destination image and source buffer so each pair is a single copy command
+    std::stable_sort(pendingUploads_.begin(), pendingUploads_.end(), [](const PendingUpload& a, const PendingUpload& b) {
+        return a.image != b.image ? a.image < b.image : a.buffer < b.buffer;
+    });
+    
+    std::vector<VkImageMemoryBarrier> barriers;
+    for (const auto& upload : pendingUploads_) {
+        if (!barriers.empty() && barriers.back().image == upload.image) {
+            continue;
+        }
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = upload.image;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.layerCount = 1;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT; // Earlier frames may still sample the image
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barriers.push_back(barrier);
+    }
+    
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr,
+                         static_cast<uint32_t>(barriers.size()), barriers.data());
+    
+    std::vector<VkBufferImageCopy> regions;
+    for (size_t i = 0; i < pendingUploads_.size();) {
+        const PendingUpload& first = pendingUploads_[i];
+        regions.clear();
+        while (i < pendingUploads_.size() && pendingUploads_[i].image == first.image && pendingUploads_[i].buffer == first.buffer) {
+            regions.push_back(pendingUploads_[i].region);
+            ++i;
+        }
+        vkCmdCopyBufferToImage(cmd, first.buffer, first.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                               static_cast<uint32_t>(regions.size()), regions.data());
+    }
+    
+    for (auto& barrier : barriers) {
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    }
+    
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr,
+                         static_cast<uint32_t>(barriers.size()), barriers.data());
+    
+    pendingUploads_.clear();
+}
+
+void VulkanRenderer::recordTargetTransitions(VkCommandBuffer cmd) {
+    if (pendingTransitions_.empty()) {
+        return;
+    }
+    
+    std::vector<VkImageMemoryBarrier> barriers;
+    for (const auto& transition : pendingTransitions_) {
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = transition.layout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = transition.image;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.layerCount = 1;
+        barrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+        barriers.push_back(barrier);
+    }
+    
+    // Every later pass, sample and copy of the frame sees the new layout
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr,
+                         static_cast<uint32_t>(barriers.size()), barriers.data());
+    
+    pendingTransitions_.clear();
+}
+
+namespace {
+    // Two triangles per quad: top-left, top-right, bottom-left; top-right, bottom-right, bottom-left
+    const int QUAD_CORNERS[6][2] = {{0, 0}, {1, 0}, {0, 1}, {1, 0}, {1, 1}, {0, 1}};
+}
+
+void VulkanRenderer::uploadVertices() {
+    // Batches first go in the order that needs the fewest pipeline and texture changes
+    for (auto& pass : targetPasses_) {
+        orderDrawBatches(pass.batches);
+    }
+    if (frameDamage_.empty()) {
+        drawBatches_.clear();
+    } else {
+        orderDrawBatches(drawBatches_);
+    }
+    
+    // Each vertex format has a region of the buffer, sized for its quads before culling.
+    // Glyphs take one instance each, which the vertex shader expands into six vertices.
+    const VkDeviceSize strides[] = {sizeof(SolidVertex), sizeof(Vertex), sizeof(ImageVertex), sizeof(GridVertex), sizeof(GlyphInstance)};
+    const VkDeviceSize verticesPerQuad[] = {6, 6, 6, 6, 1};
+    std::array<VkDeviceSize, static_cast<size_t>(VertexFormat::Count)> quadCounts{};
+    auto countQuads = [&](const std::vector<DrawBatch>& batches) {
+        for (const auto& batch : batches) {
+            quadCounts[static_cast<size_t>(getVertexFormat(batch.pipeline))] += batch.quadCount;
+        }
+    };
+    for (const auto& pass : targetPasses_) {
+        countQuads(pass.batches);
+    }
+    countQuads(drawBatches_);
+    
+    FrameResources& frame = frames_[currentFrame_];
+    VkDeviceSize size = 0;
+    for (size_t i = 0; i < quadCounts.size(); ++i) {
+        frame.vertexOffsets[i] = size;
+        size = (size + quadCounts[i] * verticesPerQuad[i] * strides[i] + 15) & ~VkDeviceSize(15);
+    }
+    ensureVertexCapacity(frame, std::max<VkDeviceSize>(size, 1));
+    char* mapped = static_cast<char*>(frame.vertexMapped);
+    std::array<uint32_t, static_cast<size_t>(VertexFormat::Count)> written{};
+    
+    auto writeQuad = [&](VertexFormat format, const Quad& quad) {
+        char* out = mapped + frame.vertexOffsets[static_cast<size_t>(format)] + written[static_cast<size_t>(format)] * strides[static_cast<size_t>(format)];
+        for (const auto& corner : QUAD_CORNERS) {
+            float x = corner[0] ? quad.x1 : quad.x0;
+            float y = corner[1] ? quad.y1 : quad.y0;
+            float u = corner[0] ? quad.u1 : quad.u0;
+            float v = corner[1] ? quad.v1 : quad.v0;
+            if (format == VertexFormat::Solid) {
+                SolidVertex vertex{{x, y}, {quad.color[0], quad.color[1], quad.color[2], quad.color[3]}};
+                memcpy(out, &vertex, sizeof(vertex));
+                out += sizeof(vertex);
+            } else if (format == VertexFormat::Image) {
+                ImageVertex vertex{{x, y}, {u, v}};
+                memcpy(out, &vertex, sizeof(vertex));
+                out += sizeof(vertex);
+            } else if (format == VertexFormat::Grid) {
+                GridVertex vertex{{x, y}, {u, v}, quad.grid};
+                memcpy(out, &vertex, sizeof(vertex));
+                out += sizeof(vertex);
+            } else {
+                Vertex vertex{{x, y}, {u, v}, {quad.color[0], quad.color[1], quad.color[2], quad.color[3]}};
+                memcpy(out, &vertex, sizeof(vertex));
+                out += sizeof(vertex);
+            }
+        }
+        written[static_cast<size_t>(format)] += 6;
+    };
+    
+    // Instances are copied as they are
+    auto writeGlyph = [&](const GlyphInstance& glyph) {
+        size_t format = static_cast<size_t>(VertexFormat::Glyph);
+        memcpy(mapped + frame.vertexOffsets[format] + written[format] * sizeof(GlyphInstance), &glyph, sizeof(glyph));
+        written[format]++;
+    };
+    
+    // Quads the damage doesn't touch are dropped on the way
+    auto writeBatches = [&](std::vector<DrawBatch>& batches, bool cull) {
+        for (auto& batch : batches) {
+            VertexFormat format = getVertexFormat(batch.pipeline);
+            uint32_t first = written[static_cast<size_t>(format)];
+            for (uint32_t q = batch.firstQuad; q < batch.firstQuad + batch.quadCount; ++q) {
+                if (format == VertexFormat::Glyph) {
+                    const GlyphInstance& glyph = frameGlyphs_[q];
+                    const GlyphSlot& slot = glyphSlots_[glyph.slot];
+                    float x0 = glyph.pen[0] + slot.x, y0 = glyph.pen[1] + slot.y;
+                    if (!cull || frameDamage_.intersects(x0, y0, x0 + slot.width, y0 + slot.height)) {
+                        writeGlyph(glyph);
+                    }
+                    continue;
+                }
+                const Quad& quad = frameQuads_[q];
+                if (!cull || frameDamage_.intersects(std::min(quad.x0, quad.x1), std::min(quad.y0, quad.y1),
+                                                     std::max(quad.x0, quad.x1), std::max(quad.y0, quad.y1))) {
+                    writeQuad(format, quad);
+                }
+            }
+            batch.firstVertex = first;
+            batch.vertexCount = written[static_cast<size_t>(format)] - first;
+        }
+        
+        // Batches that ordering brought together are now contiguous in the buffer too
+        std::vector<DrawBatch> merged;
+        merged.reserve(batches.size());
+        for (const auto& batch : batches) {
+            if (batch.vertexCount == 0) {
+                continue;
+            }
+            if (!merged.empty() && merged.back().texture == batch.texture && merged.back().pipeline == batch.pipeline &&
+                merged.back().phase == batch.phase && merged.back().firstVertex + merged.back().vertexCount == batch.firstVertex) {
+                merged.back().vertexCount += batch.vertexCount;
+            } else {
+                merged.push_back(batch);
+            }
+        }
+        batches.swap(merged);
+    };
+    
+    // Targets are always redrawn whole
+    for (auto& pass : targetPasses_) {
+        writeBatches(pass.batches, false);
+    }
+    writeBatches(drawBatches_, !frameDamage_.isFull());
+    
+    if (quadCounts[static_cast<size_t>(VertexFormat::Glyph)] > 0) {
+        uploadGlyphSlots(frame);
+    }
+    if (!frameGridStates_.empty()) {
+        uploadGridStates(frame);
+    }
+}
+
+void VulkanRenderer::recordTargetPasses(VkCommandBuffer cmd) {
+    for (const auto& pass : targetPasses_) {
+        VkRenderPassBeginInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = targetRenderPass_;
+        renderPassInfo.framebuffer = pass.framebuffer;
+        renderPassInfo.renderArea.offset = {0, 0};
+        renderPassInfo.renderArea.extent = {pass.width, pass.height};
+        
+        VkClearValue clearColor = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
+        renderPassInfo.clearValueCount = 1;
+        renderPassInfo.pClearValues = &clearColor;
+        
+        vkCmdBeginRenderPass(cmd, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        
+        std::vector<DamageRect> scissors = {{0, 0, static_cast<int32_t>(pass.width), static_cast<int32_t>(pass.height)}};
+        recordDrawBatches(cmd, pass.batches, scissors, pass.width, pass.height);
+        
+        vkCmdEndRenderPass(cmd);
+    }
+}
+
+void VulkanRenderer::recordDrawBatches(VkCommandBuffer cmd, const std::vector<DrawBatch>& batches, const std::vector<DamageRect>& scissors, uint32_t width, uint32_t height) {
+    if (batches.empty()) {
+        return;
+    }
+    
+    FrameResources& frame = frames_[currentFrame_];
+    
+    // Push target size constants; every pipeline shares the layout, so they stay across switches
+    float screenSize[2] = {
+        static_cast<float>(width),
+        static_cast<float>(height)
+    };
+    vkCmdPushConstants(cmd, pipelineLayout_, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(screenSize), screenSize);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout_, 1, 1, &frame.frameSet, 0, nullptr);
+    
+    VkViewport viewport{};
+    viewport.width = screenSize[0];
+    viewport.height = screenSize[1];
+    viewport.maxDepth = 1.0f;
+    vkCmdSetViewport(cmd, 0, 1, &viewport);
+    
+    // Damage rectangles are disjoint, so drawing the batches once under each
+    // rectangle's scissor never blends a pixel twice
+    PipelineKind boundPipeline = PipelineKind::Count;
+    VertexFormat boundFormat = VertexFormat::Count;
+    VkDescriptorSet boundSet = VK_NULL_HANDLE;
+    for (const auto& rect : scissors) {
+        VkRect2D scissor{};
+        scissor.offset = {rect.x, rect.y};
+        scissor.extent = {static_cast<uint32_t>(rect.width), static_cast<uint32_t>(rect.height)};
+        vkCmdSetScissor(cmd, 0, 1, &scissor);
+        
+        for (const auto& batch : batches) {
+            if (batch.texture != VK_NULL_HANDLE) {
+                VkDescriptorSet descriptorSet = getDescriptorSet(batch.texture);
+                if (descriptorSet == VK_NULL_HANDLE) {
+                    continue; // Descriptor pool exhausted, skip this texture
+                }
+                if (descriptorSet != boundSet) {
+                    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout_, 0, 1, &descriptorSet, 0, nullptr);
+                    boundSet = descriptorSet;
+                }
+            }
+            if (batch.pipeline != boundPipeline) {
+                vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines_[static_cast<size_t>(batch.pipeline)]);
+                boundPipeline = batch.pipeline;
+                frameCounters_.pipelineBinds++;
+                
+                VertexFormat format = getVertexFormat(batch.pipeline);
+                if (format != boundFormat) {
+                    VkDeviceSize offset = frame.vertexOffsets[static_cast<size_t>(format)];
+                    vkCmdBindVertexBuffers(cmd, 0, 1, &frame.vertexBuffer, &offset);
+                    boundFormat = format;
+                }
+            }
+            if (batch.phase != frame.openPhase) {
+                writeTimestamp(cmd, batch.phase);
+            }
+            if (getVertexFormat(batch.pipeline) == VertexFormat::Glyph) {
+                vkCmdDraw(cmd, 6, batch.vertexCount, 0, batch.firstVertex);
+                frameCounters_.quads += batch.vertexCount;
+            } else {
+                vkCmdDraw(cmd, batch.vertexCount, 1, batch.firstVertex, 0);
+                frameCounters_.quads += batch.vertexCount / 6;
+            }
+            frameCounters_.drawCalls++;
+        }
+    }
+    writeTimestamp(cmd, RenderPhase::Count);
+}
+
+void VulkanRenderer::writeTimestamp(VkCommandBuffer cmd, RenderPhase phase) {
+    FrameResources& frame = frames_[currentFrame_];
+    // Past the limit the remaining work is credited to the phase already open
+    if (frame.queryPool == VK_NULL_HANDLE || frame.queryCount + 1 >= MAX_TIMESTAMPS || phase == frame.openPhase) {
+        return;
+    }
+    vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.queryPool, frame.queryCount);
+    frame.queryPhases[frame.queryCount++] = phase;
+    frame.openPhase = phase;
+}
+
+void VulkanRenderer::readTimestamps(FrameResources& frame) {
+    if (frame.queryCount < 2) {
+        frame.queryCount = 0;
+        return;
+    }
     
-    if (quadVertexBuffer_ == VK_NULL_HANDLE) {
-        return; // Vertex buffer not created yet
+    uint64_t ticks[MAX_TIMESTAMPS];
+    VkResult result = vkGetQueryPoolResults(device_, frame.queryPool, 0, frame.queryCount, sizeof(uint64_t) * frame.queryCount, ticks,
+                                            sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    uint32_t count = frame.queryCount;
+    frame.queryCount = 0;
+    if (result != VK_SUCCESS) {
+        return; // Not ready means the frame was never submitted; skip it rather than wait
     }
     
-    // Use white texture if no texture provided (for solid colored quads)
-    VkImageView useTexture = texture;
-    if (useTexture == VK_NULL_HANDLE) {
-        useTexture = whiteTextureView_;
-        if (useTexture == VK_NULL_HANDLE) {
-            return; // White texture not created
+    auto milliseconds = [&](uint64_t from, uint64_t to) {
+        return static_cast<double>((to - from) & timestampMask_) * timestampPeriod_ / 1.0e6;
+    };
+    
+    // A phase can occur several times in a frame, once per target and damage rectangle
+    double phaseTimes[static_cast<size_t>(RenderPhase::Count)] = {};
+    bool phaseSeen[static_cast<size_t>(RenderPhase::Count)] = {};
+    for (uint32_t i = 0; i + 1 < count; ++i) {
+        if (frame.queryPhases[i] != RenderPhase::Count) {
+            size_t phase = static_cast<size_t>(frame.queryPhases[i]);
+            phaseTimes[phase] += milliseconds(ticks[i], ticks[i + 1]);
+            phaseSeen[phase] = true;
         }
     }
+    for (size_t phase = 0; phase < phaseStats_.size(); ++phase) {
+        if (phaseSeen[phase]) {
+            phaseStats_[phase].add(phaseTimes[phase]);
+        }
+    }
+    gpuFrameStats_.add(milliseconds(ticks[0], ticks[count - 1]));
+}
+
+const char* VulkanRenderer::getRenderPhaseName(RenderPhase phase) {
+    switch (phase) {
+        case RenderPhase::Background: return "background";
+        case RenderPhase::PaneContent: return "panes";
+        case RenderPhase::Overlays: return "overlays";
+        case RenderPhase::MenuBar: return "menu bar";
+        case RenderPhase::Settings: return "settings";
+        case RenderPhase::SearchBar: return "search bar";
+        case RenderPhase::Hud: return "hud";
+        default: return "other";
+    }
+}
+
+void VulkanRenderer::recordSceneCopy(VkCommandBuffer cmd) {
+    // Bring this swap chain image up to date with everything drawn since it was last shown
+    DamageRegion& damage = imageDamage_[currentImageIndex];
+    if (damage.empty()) {
+        return;
+    }
+    
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = damage.isFull() ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = swapChainImages_[currentImageIndex];
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.layerCount = 1;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    
+    std::vector<VkImageCopy> regions;
+    for (const auto& rect : damage.getRects()) {
+        VkImageCopy region{};
+        region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.srcSubresource.layerCount = 1;
+        region.srcOffset = {rect.x, rect.y, 0};
+        region.dstSubresource = region.srcSubresource;
+        region.dstOffset = region.srcOffset;
+        region.extent = {static_cast<uint32_t>(rect.width), static_cast<uint32_t>(rect.height), 1};
+        regions.push_back(region);
+    }
+    vkCmdCopyImage(cmd, scene_.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, swapChainImages_[currentImageIndex],
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+    
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = 0;
+    
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    
+    damage.clear();
+}
+
+void VulkanRenderer::recordCapture(VkCommandBuffer cmd) {
+    if (!captureRequested_) {
+        return;
+    }
+    captureRequested_ = false;
+    
+    if (captureBuffer_ == VK_NULL_HANDLE) {
+        VkDeviceSize size = static_cast<VkDeviceSize>(swapChainExtent_.width) * swapChainExtent_.height * 4;
+        createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                     captureBuffer_, captureMemory_);
+    }
+    
+    // The scene pass leaves the target in TRANSFER_SRC, ready to be copied
+    VkBufferImageCopy region{};
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent = {swapChainExtent_.width, swapChainExtent_.height, 1};
+    vkCmdCopyImageToBuffer(cmd, scene_.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, captureBuffer_, 1, &region);
+    
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = captureBuffer_;
+    barrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+    
+    capturePending_ = true;
+    captureFrame_ = currentFrame_;
+}
+
+bool VulkanRenderer::readCapture(std::vector<uint8_t>& pixels) {
+    if (!capturePending_) {
+        return false;
+    }
+    capturePending_ = false;
+    
+    vkWaitForFences(device_, 1, &inFlightFences_[captureFrame_], VK_TRUE, UINT64_MAX);
+    
+    size_t size = static_cast<size_t>(swapChainExtent_.width) * swapChainExtent_.height * 4;
+    const uint8_t* mapped = static_cast<const uint8_t*>(captureMemory_.mapped);
+    pixels.assign(mapped, mapped + size);
+    
+    // Swap chain formats are usually BGRA
+    if (swapChainImageFormat_ == VK_FORMAT_B8G8R8A8_SRGB || swapChainImageFormat_ == VK_FORMAT_B8G8R8A8_UNORM) {
+        for (size_t i = 0; i < size; i += 4) {
+            std::swap(pixels[i], pixels[i + 2]);
+        }
+    }
+    return true;
+}
+
+void VulkanRenderer::addDamage(float x, float y, float width, float height) {
+    // Round outwards so partially covered pixels are redrawn too
+    int32_t x0 = static_cast<int32_t>(std::floor(x));
+    int32_t y0 = static_cast<int32_t>(std::floor(y));
+    int32_t x1 = static_cast<int32_t>(std::ceil(x + width));
+    int32_t y1 = static_cast<int32_t>(std::ceil(y + height));
+    frameDamage_.add(x0, y0, x1 - x0, y1 - y0);
+}
+
+void VulkanRenderer::damageAll() {
+    frameDamage_.addAll();
+}
+
+VkDescriptorSet VulkanRenderer::getDescriptorSet(VkImageView view) {
+    auto it = descriptorSets_.find(view);
+    if (it != descriptorSets_.end()) {
+        return it->second;
+    }
     
-    // Create descriptor set for texture
     VkDescriptorSetAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
     allocInfo.descriptorPool = descriptorPool_;
@@ -1045,15 +2649,13 @@ void VulkanRenderer::renderQuad(float x, float y, float width, float height, VkI
     allocInfo.pSetLayouts = &descriptorSetLayout_;
     
     VkDescriptorSet descriptorSet;
-    VkResult result = vkAllocateDescriptorSets(device_, &allocInfo, &descriptorSet);
-    if (result != VK_SUCCESS) {
-        // Descriptor pool might be full, skip rendering this frame
-        return;
+    if (vkAllocateDescriptorSets(device_, &allocInfo, &descriptorSet) != VK_SUCCESS) {
+        return VK_NULL_HANDLE;
     }
     
     VkDescriptorImageInfo imageInfo{};
     imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    imageInfo.imageView = useTexture;
+    imageInfo.imageView = view;
     imageInfo.sampler = textureSampler_;
     
     VkWriteDescriptorSet descriptorWrite{};
@@ -1067,43 +2669,9 @@ void VulkanRenderer::renderQuad(float x, float y, float width, float height, VkI
     
     vkUpdateDescriptorSets(device_, 1, &descriptorWrite, 0, nullptr);
     
-    // Update quad vertices with current position/size/color (in pixel coordinates)
-    float x2 = x + width;
-    float y2 = y + height;
-    
-    // Triangle 1: Top-left, Top-right, Bottom-left
-    quadVertices_[0] = {{x, y}, {u0, v0}, {r, g, b, a}};
-    quadVertices_[1] = {{x2, y}, {u1, v0}, {r, g, b, a}};
-    quadVertices_[2] = {{x, y2}, {u0, v1}, {r, g, b, a}};
-    // Triangle 2: Top-right, Bottom-right, Bottom-left
-    quadVertices_[3] = {{x2, y}, {u1, v0}, {r, g, b, a}};
-    quadVertices_[4] = {{x2, y2}, {u1, v1}, {r, g, b, a}};
-    quadVertices_[5] = {{x, y2}, {u0, v1}, {r, g, b, a}};
-    
-    // Update vertex buffer (would be better to use staging buffer, but for simplicity using direct mapping)
-    void* data;
-    vkMapMemory(device_, quadVertexBufferMemory_, 0, sizeof(Vertex) * 6, 0, &data);
-    memcpy(data, quadVertices_.data(), sizeof(Vertex) * 6);
-    vkUnmapMemory(device_, quadVertexBufferMemory_);
-    
-    // Bind pipeline and descriptor set
-    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline_);
-    
-    VkBuffer vertexBuffers[] = {quadVertexBuffer_};
-    VkDeviceSize offsets[] = {0};
-    vkCmdBindVertexBuffers(cmd, 0, 1, vertexBuffers, offsets);
-    
-    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout_, 0, 1, &descriptorSet, 0, nullptr);
-    
-    // Push screen size constants
-    float screenSize[2] = {
-        static_cast<float>(swapChainExtent_.width),
-        static_cast<float>(swapChainExtent_.height)
-    };
-    vkCmdPushConstants(cmd, pipelineLayout_, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(screenSize), screenSize);
-    
-    // Draw the quad (2 triangles = 6 vertices)
-    vkCmdDraw(cmd, 6, 1, 0, 0);
+    descriptorSets_[view] = descriptorSet;
+    frameCounters_.descriptorAllocations++;
+    return descriptorSet;
 }
 
 void VulkanRenderer::renderText([[maybe_unused]] float x, [[maybe_unused]] float y, [[maybe_unused]] const std::string& text, [[maybe_unused]] float r, [[maybe_unused]] float g, [[maybe_unused]] float b) {
@@ -1112,11 +2680,11 @@ void VulkanRenderer::renderText([[maybe_unused]] float x, [[maybe_unused]] float
     // Full implementation would iterate through characters and render each glyph
 }
 
-VkShaderModule VulkanRenderer::createShaderModule(const std::vector<char>& code) {
+VkShaderModule VulkanRenderer::createShaderModule(const uint32_t* code, size_t size) {
     VkShaderModuleCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    createInfo.codeSize = code.size();
-    createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+    createInfo.codeSize = size;
+    createInfo.pCode = code;
     
     VkShaderModule shaderModule;
     if (vkCreateShaderModule(device_, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
@@ -1160,82 +2728,162 @@ void VulkanRenderer::framebufferResizeCallback(GLFWwindow* window, [[maybe_unuse
     app->framebufferResized_ = true;
 }
 
-void VulkanRenderer::createQuadVertexBuffer() {
-    // Create initial quad vertices (will be updated per frame)
-    quadVertices_.resize(6); // 2 triangles = 6 vertices for a quad
-    
-    // Initialize with default values (will be updated in renderQuad)
-    for (auto& vertex : quadVertices_) {
-        vertex.pos[0] = 0.0f;
-        vertex.pos[1] = 0.0f;
-        vertex.texCoord[0] = 0.0f;
-        vertex.texCoord[1] = 0.0f;
-        vertex.color[0] = 1.0f;
-        vertex.color[1] = 1.0f;
-        vertex.color[2] = 1.0f;
-        vertex.color[3] = 1.0f;
+void VulkanRenderer::createFrameResources() {
+    frames_.resize(framesInFlight_);
+    for (auto& frame : frames_) {
+        ensureVertexCapacity(frame, INITIAL_VERTEX_BUFFER_SIZE);
+        
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = descriptorPool_;
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &frameSetLayout_;
+        if (vkAllocateDescriptorSets(device_, &allocInfo, &frame.frameSet) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate frame descriptor set!");
+        }
+        uploadGlyphSlots(frame);
+        uploadGridStates(frame);
     }
     
-    VkDeviceSize bufferSize = sizeof(Vertex) * quadVertices_.size();
-    
-    // Use host-visible memory so we can update it each frame
-    createBuffer(bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, 
-                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
-                 quadVertexBuffer_, quadVertexBufferMemory_);
+    // GPU timings are optional: queues with no valid timestamp bits just go without
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice_, &properties);
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice_, &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice_, &queueFamilyCount, queueFamilies.data());
+    uint32_t validBits = graphicsFamily_ < queueFamilyCount ? queueFamilies[graphicsFamily_].timestampValidBits : 0;
+    if (validBits == 0 || properties.limits.timestampPeriod <= 0.0f) {
+        std::cerr << "Warning: GPU timestamps not supported, phase timings disabled" << std::endl;
+        return;
+    }
+    timestampMask_ = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
     
-    // Initialize buffer with default vertices
-    void* data;
-    vkMapMemory(device_, quadVertexBufferMemory_, 0, bufferSize, 0, &data);
-    memcpy(data, quadVertices_.data(), (size_t)bufferSize);
-    vkUnmapMemory(device_, quadVertexBufferMemory_);
+    VkQueryPoolCreateInfo queryInfo{};
+    queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryInfo.queryCount = MAX_TIMESTAMPS;
+    for (auto& frame : frames_) {
+        if (vkCreateQueryPool(device_, &queryInfo, nullptr, &frame.queryPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create timestamp query pool!");
+        }
+        frame.queryPhases.assign(MAX_TIMESTAMPS, RenderPhase::Count);
+    }
+    timestampPeriod_ = properties.limits.timestampPeriod;
 }
 
-void VulkanRenderer::cleanupQuadVertexBuffer() {
-    if (quadVertexBuffer_ != VK_NULL_HANDLE) {
-        vkDestroyBuffer(device_, quadVertexBuffer_, nullptr);
-        quadVertexBuffer_ = VK_NULL_HANDLE;
+void VulkanRenderer::cleanupFrameResources() {
+    for (auto& frame : frames_) {
+        if (frame.vertexBuffer != VK_NULL_HANDLE) {
+            destroyBuffer(frame.vertexBuffer, frame.vertexMemory);
+        }
+        if (frame.slotBuffer != VK_NULL_HANDLE) {
+            destroyBuffer(frame.slotBuffer, frame.slotMemory);
+        }
+        if (frame.gridBuffer != VK_NULL_HANDLE) {
+            destroyBuffer(frame.gridBuffer, frame.gridMemory);
+        }
+        for (auto& chunk : frame.staging) {
+            destroyBuffer(chunk.buffer, chunk.memory);
+        }
+        if (frame.queryPool != VK_NULL_HANDLE) {
+            vkDestroyQueryPool(device_, frame.queryPool, nullptr);
+        }
     }
-    if (quadVertexBufferMemory_ != VK_NULL_HANDLE) {
-        vkFreeMemory(device_, quadVertexBufferMemory_, nullptr);
-        quadVertexBufferMemory_ = VK_NULL_HANDLE;
+    frames_.clear();
+    timestampPeriod_ = 0.0f;
+    pendingUploads_.clear();
+}
+
+void VulkanRenderer::resetStaging(FrameResources& frame) {
+    for (auto& chunk : frame.staging) {
+        chunk.offset = 0;
     }
 }
 
-void VulkanRenderer::createWhiteTexture() {
-    // Create a 1x1 white texture for solid colored quads
-    uint32_t whitePixel = 0xFFFFFFFF; // RGBA white
-    createTexture(1, 1, &whitePixel, whiteTexture_, whiteTextureMemory_, whiteTextureView_);
+void VulkanRenderer::ensureVertexCapacity(FrameResources& frame, VkDeviceSize size) {
+    if (size <= frame.vertexCapacity) {
+        return;
+    }
+    
+    // Only called for the current frame, whose previous submission has completed
+    if (frame.vertexBuffer != VK_NULL_HANDLE) {
+        destroyBuffer(frame.vertexBuffer, frame.vertexMemory);
+    }
+    
+    VkDeviceSize capacity = std::max(frame.vertexCapacity, INITIAL_VERTEX_BUFFER_SIZE);
+    while (capacity < size) {
+        capacity *= 2;
+    }
+    
+    // Host-visible and persistently mapped; rewritten every frame
+    createBuffer(capacity, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 frame.vertexBuffer, frame.vertexMemory);
+    frame.vertexMapped = frame.vertexMemory.mapped;
+    frame.vertexCapacity = capacity;
 }
 
-void VulkanRenderer::cleanupWhiteTexture() {
-    if (whiteTextureView_ != VK_NULL_HANDLE) {
-        vkDestroyImageView(device_, whiteTextureView_, nullptr);
-        whiteTextureView_ = VK_NULL_HANDLE;
+void VulkanRenderer::uploadGlyphSlots(FrameResources& frame) {
+    if (frame.slotVersion == glyphSlotVersion_) {
+        return;
     }
-    if (whiteTexture_ != VK_NULL_HANDLE) {
-        vkDestroyImage(device_, whiteTexture_, nullptr);
-        whiteTexture_ = VK_NULL_HANDLE;
+    
+    VkDeviceSize size = std::max<VkDeviceSize>(glyphSlots_.size(), 1) * sizeof(GlyphSlot);
+    ensureStorageCapacity(frame, 0, size, INITIAL_SLOT_BUFFER_SIZE, frame.slotBuffer, frame.slotMemory, frame.slotCapacity);
+    
+    // The whole table is small and only changes as glyphs are placed or the font is rescaled
+    if (!glyphSlots_.empty()) {
+        memcpy(frame.slotMemory.mapped, glyphSlots_.data(), glyphSlots_.size() * sizeof(GlyphSlot));
     }
-    if (whiteTextureMemory_ != VK_NULL_HANDLE) {
-        vkFreeMemory(device_, whiteTextureMemory_, nullptr);
-        whiteTextureMemory_ = VK_NULL_HANDLE;
+    frame.slotVersion = glyphSlotVersion_;
+}
+
+void VulkanRenderer::uploadGridStates(FrameResources& frame) {
+    // A few states a frame, one per visible pane; rewritten every time
+    VkDeviceSize size = std::max<VkDeviceSize>(frameGridStates_.size(), 1) * sizeof(GridState);
+    ensureStorageCapacity(frame, 1, size, INITIAL_GRID_BUFFER_SIZE, frame.gridBuffer, frame.gridMemory, frame.gridCapacity);
+    if (!frameGridStates_.empty()) {
+        memcpy(frame.gridMemory.mapped, frameGridStates_.data(), frameGridStates_.size() * sizeof(GridState));
     }
 }
 
-uint32_t VulkanRenderer::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
-    VkPhysicalDeviceMemoryProperties memProperties;
-    vkGetPhysicalDeviceMemoryProperties(physicalDevice_, &memProperties);
+void VulkanRenderer::ensureStorageCapacity(FrameResources& frame, uint32_t binding, VkDeviceSize size, VkDeviceSize initialSize,
+                                           VkBuffer& buffer, MemoryAllocation& memory, VkDeviceSize& capacity) {
+    if (size <= capacity) {
+        return;
+    }
     
-    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-        if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-            return i;
-        }
+    // Only called for the current frame, whose previous submission has completed
+    if (buffer != VK_NULL_HANDLE) {
+        destroyBuffer(buffer, memory);
+    }
+    
+    VkDeviceSize newCapacity = std::max(capacity, initialSize);
+    while (newCapacity < size) {
+        newCapacity *= 2;
     }
+    createBuffer(newCapacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 buffer, memory);
+    capacity = newCapacity;
+    
+    VkDescriptorBufferInfo bufferInfo{};
+    bufferInfo.buffer = buffer;
+    bufferInfo.offset = 0;
+    bufferInfo.range = VK_WHOLE_SIZE;
     
-    throw std::runtime_error("failed to find suitable memory type!");
+    VkWriteDescriptorSet descriptorWrite{};
+    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.dstSet = frame.frameSet;
+    descriptorWrite.dstBinding = binding;
+    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.pBufferInfo = &bufferInfo;
+    vkUpdateDescriptorSets(device_, 1, &descriptorWrite, 0, nullptr);
 }
 
-void VulkanRenderer::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
+void VulkanRenderer::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, MemoryAllocation& bufferMemory) {
     VkBufferCreateInfo bufferInfo{};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     bufferInfo.size = size;
@@ -1248,60 +2896,235 @@ void VulkanRenderer::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, V
     
     VkMemoryRequirements memRequirements;
     vkGetBufferMemoryRequirements(device_, buffer, &memRequirements);
+    bufferMemory = allocator_.allocate(memRequirements, properties, false);
+    vkBindBufferMemory(device_, buffer, bufferMemory.memory, bufferMemory.offset);
+}
+
+void VulkanRenderer::destroyBuffer(VkBuffer buffer, const MemoryAllocation& bufferMemory) {
+    vkDestroyBuffer(device_, buffer, nullptr);
+    allocator_.free(bufferMemory);
+}
+
+void VulkanRenderer::createTransferResources() {
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    poolInfo.queueFamilyIndex = transferFamily_;
+    
+    if (vkCreateCommandPool(device_, &poolInfo, nullptr, &transferCommandPool_) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create transfer command pool!");
+    }
     
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+    if (timelineSupported_) {
+        VkSemaphoreTypeCreateInfo typeInfo{};
+        typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+        typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        typeInfo.initialValue = 0;
+        
+        VkSemaphoreCreateInfo semaphoreInfo{};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        semaphoreInfo.pNext = &typeInfo;
+        
+        if (vkCreateSemaphore(device_, &semaphoreInfo, nullptr, &transferTimeline_) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create transfer timeline semaphore!");
+        }
+        transferValue_ = 0;
+    }
     
-    if (vkAllocateMemory(device_, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate buffer memory!");
+    createBuffer(UPLOAD_RING_SIZE, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 uploadRing_, uploadRingMemory_);
+    ringHead_ = 0;
+    ringTail_ = 0;
+    ringUsed_ = 0;
+}
+
+void VulkanRenderer::cleanupTransferResources() {
+    if (transferCommandPool_ == VK_NULL_HANDLE) {
+        return;
     }
     
-    vkBindBufferMemory(device_, buffer, bufferMemory, 0);
+    finishTransfers();
+    for (auto& batch : idleTransfers_) {
+        vkDestroyFence(device_, batch.fence, nullptr);
+    }
+    idleTransfers_.clear();
+    
+    destroyBuffer(uploadRing_, uploadRingMemory_);
+    uploadRing_ = VK_NULL_HANDLE;
+    uploadRingMemory_ = MemoryAllocation();
+    
+    if (transferTimeline_ != VK_NULL_HANDLE) {
+        vkDestroySemaphore(device_, transferTimeline_, nullptr);
+        transferTimeline_ = VK_NULL_HANDLE;
+    }
+    
+    vkDestroyCommandPool(device_, transferCommandPool_, nullptr); // Frees the batches' command buffers
+    transferCommandPool_ = VK_NULL_HANDLE;
 }
 
-VkCommandBuffer VulkanRenderer::beginSingleTimeCommands() {
-    VkCommandBufferAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandPool = commandPool_;
-    allocInfo.commandBufferCount = 1;
+VkCommandBuffer VulkanRenderer::beginTransfer() {
+    if (transferOpen_) {
+        return openTransfer_.cmd;
+    }
+    
+    if (idleTransfers_.empty()) {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = transferCommandPool_;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+        
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        
+        TransferBatch batch;
+        if (vkAllocateCommandBuffers(device_, &allocInfo, &batch.cmd) != VK_SUCCESS ||
+            vkCreateFence(device_, &fenceInfo, nullptr, &batch.fence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create transfer batch!");
+        }
+        idleTransfers_.push_back(std::move(batch));
+    }
     
-    VkCommandBuffer commandBuffer;
-    vkAllocateCommandBuffers(device_, &allocInfo, &commandBuffer);
+    openTransfer_ = std::move(idleTransfers_.back());
+    idleTransfers_.pop_back();
     
     VkCommandBufferBeginInfo beginInfo{};
     beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
     beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
     
-    vkBeginCommandBuffer(commandBuffer, &beginInfo);
+    if (vkBeginCommandBuffer(openTransfer_.cmd, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin recording transfer command buffer!");
+    }
+    transferOpen_ = true;
+    return openTransfer_.cmd;
+}
+
+VkDeviceSize VulkanRenderer::stageTransfer(const void* data, VkDeviceSize size, VkBuffer& buffer) {
+    if (size > UPLOAD_RING_SIZE / 2) {
+        // Large images would stall the ring; their staging buffer lives as long as the batch
+        MemoryAllocation memory;
+        createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, buffer, memory);
+        memcpy(memory.mapped, data, static_cast<size_t>(size));
+        beginTransfer();
+        openTransfer_.oversized.push_back({buffer, memory});
+        return 0;
+    }
+    
+    // When the ring is full, wait for the oldest batch to give its space back
+    VkDeviceSize offset = 0;
+    VkDeviceSize consumed = 0;
+    while (!allocateRing(size, offset, consumed)) {
+        if (transfersInFlight_.empty()) {
+            flushTransfers(); // The open batch holds the rest of the ring
+        }
+        vkWaitForFences(device_, 1, &transfersInFlight_.front().fence, VK_TRUE, UINT64_MAX);
+        completeTransfer();
+    }
+    
+    memcpy(static_cast<char*>(uploadRingMemory_.mapped) + offset, data, static_cast<size_t>(size));
+    beginTransfer();
+    openTransfer_.ringBytes += consumed;
+    buffer = uploadRing_;
+    return offset;
+}
+
+bool VulkanRenderer::allocateRing(VkDeviceSize size, VkDeviceSize& offset, VkDeviceSize& consumed) {
+    if (ringUsed_ == 0) {
+        ringHead_ = 0;
+        ringTail_ = 0;
+    }
+    
+    // Buffer offsets for image copies must be a multiple of the texel size (and of 4)
+    VkDeviceSize aligned = (ringHead_ + UPLOAD_ALIGNMENT - 1) & ~(UPLOAD_ALIGNMENT - 1);
+    if (ringHead_ > ringTail_ || ringUsed_ == 0) {
+        // Free from the head to the end of the ring, then from the start up to the tail
+        if (aligned + size <= UPLOAD_RING_SIZE) {
+            offset = aligned;
+        } else if (size <= ringTail_) {
+            offset = 0;
+            aligned = UPLOAD_RING_SIZE; // The skipped end of the ring is held until the batch retires
+        } else {
+            return false;
+        }
+    } else if (aligned + size <= ringTail_) {
+        offset = aligned;
+    } else {
+        return false;
+    }
     
-    return commandBuffer;
+    consumed = (aligned - ringHead_) + size;
+    ringUsed_ += consumed;
+    ringHead_ = offset + size;
+    return true;
 }
 
-void VulkanRenderer::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
-    vkEndCommandBuffer(commandBuffer);
+void VulkanRenderer::flushTransfers() {
+    if (!transferOpen_) {
+        return;
+    }
+    transferOpen_ = false;
+    
+    if (vkEndCommandBuffer(openTransfer_.cmd) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record transfer command buffer!");
+    }
     
     VkSubmitInfo submitInfo{};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
     submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffer;
+    submitInfo.pCommandBuffers = &openTransfer_.cmd;
+    
+    // The fence tells the CPU when the ring space is free again, the timeline tells the frame
+    uint64_t signalValue = transferValue_ + 1;
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    if (transferTimeline_ != VK_NULL_HANDLE) {
+        timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timelineInfo.signalSemaphoreValueCount = 1;
+        timelineInfo.pSignalSemaphoreValues = &signalValue;
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &transferTimeline_;
+        submitInfo.pNext = &timelineInfo;
+    }
     
-    vkQueueSubmit(graphicsQueue_, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(graphicsQueue_);
+    if (vkQueueSubmit(transferQueue_, 1, &submitInfo, openTransfer_.fence) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit transfer command buffer!");
+    }
     
-    vkFreeCommandBuffers(device_, commandPool_, 1, &commandBuffer);
+    transferValue_ = signalValue;
+    openTransfer_.value = signalValue;
+    openTransfer_.ringEnd = ringHead_;
+    transfersInFlight_.push_back(std::move(openTransfer_));
+    openTransfer_ = TransferBatch();
+}
+
+void VulkanRenderer::retireTransfers() {
+    while (!transfersInFlight_.empty() && vkGetFenceStatus(device_, transfersInFlight_.front().fence) == VK_SUCCESS) {
+        completeTransfer();
+    }
 }
 
-void VulkanRenderer::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
-    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+void VulkanRenderer::completeTransfer() {
+    // Batches complete in submission order, so the ring tail only moves forward
+    TransferBatch batch = std::move(transfersInFlight_.front());
+    transfersInFlight_.pop_front();
     
-    VkBufferCopy copyRegion{};
-    copyRegion.size = size;
-    vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+    ringUsed_ -= batch.ringBytes;
+    ringTail_ = batch.ringEnd;
+    for (auto& staging : batch.oversized) {
+        destroyBuffer(staging.first, staging.second);
+    }
     
-    endSingleTimeCommands(commandBuffer);
+    vkResetFences(device_, 1, &batch.fence);
+    batch.oversized.clear();
+    batch.ringBytes = 0;
+    idleTransfers_.push_back(std::move(batch));
+}
+
+void VulkanRenderer::finishTransfers() {
+    flushTransfers();
+    while (!transfersInFlight_.empty()) {
+        vkWaitForFences(device_, 1, &transfersInFlight_.front().fence, VK_TRUE, UINT64_MAX);
+        completeTransfer();
+    }
 }
 
 void VulkanRenderer::createTextureSampler() {
@@ -1321,7 +3144,7 @@ void VulkanRenderer::createTextureSampler() {
     samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
     samplerInfo.mipLodBias = 0.0f;
     samplerInfo.minLod = 0.0f;
-    samplerInfo.maxLod = 0.0f;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE; // Textures without mips only have level 0 anyway
     
     if (vkCreateSampler(device_, &samplerInfo, nullptr, &textureSampler_) != VK_SUCCESS) {
         throw std::runtime_error("failed to create texture sampler!");
@@ -1329,15 +3152,19 @@ void VulkanRenderer::createTextureSampler() {
 }
 
 void VulkanRenderer::createDescriptorPool() {
-    VkDescriptorPoolSize poolSize{};
-    poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    poolSize.descriptorCount = 100; // Maximum number of descriptor sets
+    VkDescriptorPoolSize poolSizes[2]{};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[0].descriptorCount = MAX_DESCRIPTOR_SETS;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[1].descriptorCount = MAX_FRAMES_IN_FLIGHT * 2;
     
+    // One cached set per texture view, freed again in destroyTexture(), and a frame set per frame
     VkDescriptorPoolCreateInfo poolInfo{};
     poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    poolInfo.poolSizeCount = 1;
-    poolInfo.pPoolSizes = &poolSize;
-    poolInfo.maxSets = 100;
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+    poolInfo.poolSizeCount = 2;
+    poolInfo.pPoolSizes = poolSizes;
+    poolInfo.maxSets = MAX_DESCRIPTOR_SETS + MAX_FRAMES_IN_FLIGHT;
     
     if (vkCreateDescriptorPool(device_, &poolInfo, nullptr, &descriptorPool_) != VK_SUCCESS) {
         throw std::runtime_error("failed to create descriptor pool!");
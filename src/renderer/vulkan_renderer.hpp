@@ -5,8 +5,16 @@
 #include <string>
 #include <memory>
 #include <cstdint>
+#include <cstring>
 #include <optional>
 #include <array>
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <unordered_map>
+#include "damage_region.hpp"
+#include "device_allocator.hpp"
+#include "rolling_stats.hpp"
 
 struct Vertex {
     float pos[2];
@@ -43,11 +51,249 @@ struct Vertex {
     }
 };
 
+// Solid color rectangles have nothing to sample
+struct SolidVertex {
+    float pos[2];
+    float color[4];
+    
+    static VkVertexInputBindingDescription getBindingDescription() {
+        VkVertexInputBindingDescription bindingDescription{};
+        bindingDescription.binding = 0;
+        bindingDescription.stride = sizeof(SolidVertex);
+        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+        return bindingDescription;
+    }
+    
+    static std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions() {
+        std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions{};
+        
+        attributeDescriptions[0].binding = 0;
+        attributeDescriptions[0].location = 0;
+        attributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
+        attributeDescriptions[0].offset = offsetof(SolidVertex, pos);
+        
+        attributeDescriptions[1].binding = 0;
+        attributeDescriptions[1].location = 1;
+        attributeDescriptions[1].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+        attributeDescriptions[1].offset = offsetof(SolidVertex, color);
+        
+        return attributeDescriptions;
+    }
+};
+
+// Opaque images are drawn as they are, untinted
+struct ImageVertex {
+    float pos[2];
+    float texCoord[2];
+    
+    static VkVertexInputBindingDescription getBindingDescription() {
+        VkVertexInputBindingDescription bindingDescription{};
+        bindingDescription.binding = 0;
+        bindingDescription.stride = sizeof(ImageVertex);
+        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+        return bindingDescription;
+    }
+    
+    static std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions() {
+        std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions{};
+        
+        attributeDescriptions[0].binding = 0;
+        attributeDescriptions[0].location = 0;
+        attributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
+        attributeDescriptions[0].offset = offsetof(ImageVertex, pos);
+        
+        attributeDescriptions[1].binding = 0;
+        attributeDescriptions[1].location = 1;
+        attributeDescriptions[1].format = VK_FORMAT_R32G32_SFLOAT;
+        attributeDescriptions[1].offset = offsetof(ImageVertex, texCoord);
+        
+        return attributeDescriptions;
+    }
+};
+
+// Pane images, drawn by grid.frag with the highlights of the grid state they index
+struct GridVertex {
+    float pos[2];
+    float texCoord[2];
+    uint32_t grid; // Index into the frame's grid states
+    
+    static VkVertexInputBindingDescription getBindingDescription() {
+        VkVertexInputBindingDescription bindingDescription{};
+        bindingDescription.binding = 0;
+        bindingDescription.stride = sizeof(GridVertex);
+        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+        return bindingDescription;
+    }
+    
+    static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions() {
+        std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions{};
+        
+        attributeDescriptions[0].binding = 0;
+        attributeDescriptions[0].location = 0;
+        attributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
+        attributeDescriptions[0].offset = offsetof(GridVertex, pos);
+        
+        attributeDescriptions[1].binding = 0;
+        attributeDescriptions[1].location = 1;
+        attributeDescriptions[1].format = VK_FORMAT_R32G32_SFLOAT;
+        attributeDescriptions[1].offset = offsetof(GridVertex, texCoord);
+        
+        attributeDescriptions[2].binding = 0;
+        attributeDescriptions[2].location = 2;
+        attributeDescriptions[2].format = VK_FORMAT_R32_UINT;
+        attributeDescriptions[2].offset = offsetof(GridVertex, grid);
+        
+        return attributeDescriptions;
+    }
+};
+
+// One glyph, expanded to a quad by glyph.vert from its slot in the glyph slot table
+struct GlyphInstance {
+    int16_t pen[2];   // Pen position, in whole pixels
+    uint16_t slot;    // Entry in the glyph slot table
+    uint16_t flags;   // Zero for now
+    uint32_t color;   // RGBA8, red in the lowest byte; see packColor()
+    
+    static VkVertexInputBindingDescription getBindingDescription() {
+        VkVertexInputBindingDescription bindingDescription{};
+        bindingDescription.binding = 0;
+        bindingDescription.stride = sizeof(GlyphInstance);
+        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+        return bindingDescription;
+    }
+    
+    static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions() {
+        std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions{};
+        
+        attributeDescriptions[0].binding = 0;
+        attributeDescriptions[0].location = 0;
+        attributeDescriptions[0].format = VK_FORMAT_R16G16_SINT;
+        attributeDescriptions[0].offset = offsetof(GlyphInstance, pen);
+        
+        attributeDescriptions[1].binding = 0;
+        attributeDescriptions[1].location = 1;
+        attributeDescriptions[1].format = VK_FORMAT_R16G16_UINT;
+        attributeDescriptions[1].offset = offsetof(GlyphInstance, slot);
+        
+        attributeDescriptions[2].binding = 0;
+        attributeDescriptions[2].location = 2;
+        attributeDescriptions[2].format = VK_FORMAT_R8G8B8A8_UNORM;
+        attributeDescriptions[2].offset = offsetof(GlyphInstance, color);
+        
+        return attributeDescriptions;
+    }
+};
+
+// Where a glyph lies in its atlas page, and its quad relative to the pen
+// position in pixels. Laid out as the shader reads it (std430).
+struct GlyphSlot {
+    float u0, v0, u1, v1;
+    float x, y, width, height;
+};
+
+constexpr uint32_t MAX_GLYPH_SLOTS = 65536; // GlyphInstance::slot is 16 bits
+
+enum class CursorShape : int32_t {
+    Block = 0,
+    Underline,
+    Bar
+};
+
+// Cursor, selection and search match of a terminal grid, applied per pixel by
+// grid.frag as the grid's image is drawn. Cells are counted from the origin;
+// the selection runs in reading order with its end cell excluded. Laid out as
+// the shader reads it (std430).
+struct GridState {
+    float cellWidth = 1.0f, cellHeight = 1.0f;
+    float originX = 0.0f, originY = 0.0f; // Top left of cell (0, 0), in pixels
+    int32_t selectionStart[2] = {0, 0};   // Column, row
+    int32_t selectionEnd[2] = {0, 0};
+    int32_t match[2] = {0, 0};            // First cell of the current search match
+    int32_t matchLength = 0;              // In cells; 0 for none
+    CursorShape cursorShape = CursorShape::Block;
+    int32_t cursor[2] = {-1, -1};         // Off the grid while hidden or scrolled away
+    float cursorAlpha = 0.0f;             // Blink phase; 0 while blinked off
+    float padding = 0.0f;
+    
+    bool hasSelection() const {
+        return selectionStart[0] != selectionEnd[0] || selectionStart[1] != selectionEnd[1];
+    }
+    bool showsCursor() const { return cursorAlpha > 0.0f && cursor[0] >= 0 && cursor[1] >= 0; }
+};
+static_assert(sizeof(GridState) == 64, "GridState must match grid.frag");
+
+inline bool operator==(const GridState& a, const GridState& b) {
+    return memcmp(&a, &b, sizeof(GridState)) == 0; // No padding bytes, see the assert above
+}
+inline bool operator!=(const GridState& a, const GridState& b) {
+    return !(a == b);
+}
+
+// Terminal cells keep colors as 0xRRGGBB; instances take them as RGBA8 without going through floats
+inline uint32_t packColor(uint32_t rgb, uint32_t alpha = 255) {
+    return ((rgb >> 16) & 0xFF) | (rgb & 0xFF00) | ((rgb & 0xFF) << 16) | (alpha << 24);
+}
+
+inline uint32_t packColor(float r, float g, float b, float a = 1.0f) {
+    auto channel = [](float value) {
+        return static_cast<uint32_t>(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+    };
+    return channel(r) | (channel(g) << 8) | (channel(b) << 16) | (channel(a) << 24);
+}
+
 struct GLFWwindow;
 
+// How a texture is drawn, which picks the pipeline. Single-channel textures
+// start out as Coverage and render targets as Opaque; the rest as Color.
+enum class TextureMode : uint32_t {
+    Color = 0,          // RGBA with its own colors, e.g. color glyphs; only alpha is applied
+    DistanceField = 1,  // Signed distance in alpha, edge at 0.5, tinted
+    Coverage = 2,       // Glyph coverage swizzled to alpha, tinted
+    Opaque = 3          // Replaces what is below, e.g. pane images and background photos
+};
+
+// Parts of the frame timed separately on the GPU. Each quad belongs to the
+// phase that was current when it was submitted.
+enum class RenderPhase : uint8_t {
+    Background = 0, // Clearing the damage and background images
+    PaneContent,
+    Overlays,       // Pane images composited with cursor and selection/search highlights
+    MenuBar,
+    Settings,
+    SearchBar,
+    Hud,            // The performance overlay itself
+    Count
+};
+
+// What the last frame recorded, for the performance overlay
+struct FrameCounters {
+    uint32_t drawCalls = 0;
+    uint32_t quads = 0;                 // Drawn, after culling to the damage
+    uint32_t descriptorSets = 0;        // Live, one per sampled view
+    uint32_t descriptorAllocations = 0; // Made during the frame
+    uint32_t pipelineBinds = 0;
+};
+
+// Offscreen color image in the frame's format. Once rendered it is sampled
+// like any texture, e.g. to composite cached content into the frame.
+struct RenderTarget {
+    VkImage image = VK_NULL_HANDLE;
+    MemoryAllocation memory;
+    VkImageView view = VK_NULL_HANDLE;
+    VkFramebuffer framebuffer = VK_NULL_HANDLE;
+    uint32_t width = 0;
+    uint32_t height = 0;
+};
+
+class ImageCache;
+
 class VulkanRenderer {
 public:
     VulkanRenderer(GLFWwindow* window);
+    // Headless: no window, surface or swap chain. Frames are drawn into the
+    // retained scene target only, which works on software implementations
+    // such as lavapipe; read them back with requestCapture()/readCapture().
+    VulkanRenderer(uint32_t width, uint32_t height);
     ~VulkanRenderer();
     
     // Non-copyable
@@ -57,17 +303,101 @@ public:
     void init();
     void cleanup();
     
-    void beginFrame();
+    // Frame pacing. Frames in flight (1-3) must be set before init(); one
+    // gives the lowest latency, more keep the GPU busier. An unsupported
+    // present mode falls back to FIFO.
+    void setFramesInFlight(uint32_t count);
+    uint32_t getFramesInFlight() const { return framesInFlight_; }
+    void setPresentMode(VkPresentModeKHR mode);
+    // "fifo", "fifo-relaxed", "mailbox" or "immediate"
+    static bool parsePresentMode(const std::string& name, VkPresentModeKHR& mode);
+    // Refresh period and the latest vblank a frame was shown at, in steady_clock
+    // seconds. Needs VK_GOOGLE_display_timing and at least one timed present.
+    bool getDisplayTiming(double& refreshPeriod, double& lastVblank);
+    
+    // False if the swap chain was out of date: it has been recreated and nothing
+    // may be drawn until the next beginFrame(). endFrame() does nothing then.
+    bool beginFrame();
     void endFrame();
     
-    void createTexture(uint32_t width, uint32_t height, const void* data, VkImage& image, VkDeviceMemory& memory, VkImageView& view);
-    void destroyTexture(VkImage image, VkDeviceMemory memory, VkImageView view);
+    // Supported formats are VK_FORMAT_R8G8B8A8_UNORM and VK_FORMAT_R8_UNORM. Single-channel
+    // textures are sampled as white with the channel as alpha, i.e. as glyph coverage.
+    // With mipLevels > 1, data holds every level back to back, each half the size of the previous
+    // Returns without waiting for the GPU; the upload completes before the next frame uses the texture
+    void createTexture(uint32_t width, uint32_t height, const void* data, VkImage& image, MemoryAllocation& memory, VkImageView& view, VkFormat format = VK_FORMAT_R8G8B8A8_UNORM, uint32_t mipLevels = 1);
+    // Textures and targets are released once the frames that may use them have finished
+    void destroyTexture(VkImage image, const MemoryAllocation& memory, VkImageView view);
+    
+    // Copy pixels into a sub-rectangle of a sampled image. The data is staged
+    // in the current frame's staging ring and the copy is recorded ahead of the
+    // render pass in endFrame(), batched with all other uploads of the frame.
+    void queueImageUpload(VkImage image, uint32_t x, uint32_t y, uint32_t width, uint32_t height, const void* data, uint32_t bytesPerPixel = 4);
+    
+    void setTextureMode(VkImageView view, TextureMode mode);
+    
+    // Quads recorded between beginTarget() and endTarget() are drawn into the
+    // target, which is cleared first, instead of the frame. Targets may nest;
+    // they are drawn before the frame in the order they were ended.
+    void createRenderTarget(uint32_t width, uint32_t height, RenderTarget& target);
+    void destroyRenderTarget(RenderTarget& target);
+    void beginTarget(const RenderTarget& target);
+    void endTarget();
     
     void renderQuad(float x, float y, float width, float height, VkImageView texture = VK_NULL_HANDLE, float r = 1.0f, float g = 1.0f, float b = 1.0f, float a = 1.0f, float u0 = 0.0f, float v0 = 0.0f, float u1 = 1.0f, float v1 = 1.0f);
     void renderText(float x, float y, const std::string& text, float r = 1.0f, float g = 1.0f, float b = 1.0f);
     
+    // Glyphs are drawn as instances of a slot, filled in by the font renderer
+    // with setGlyphSlot() whenever the glyph is placed or the scale changes.
+    // The page must be in Coverage, DistanceField or Color mode.
+    void setGlyphSlot(uint32_t slot, const GlyphSlot& data);
+    void renderGlyph(float x, float y, uint32_t slot, VkImageView page, uint32_t color);
+    
+    // An opaque image of a terminal grid, with the state's cursor and highlights
+    // drawn over it by the shader; changing them needs no new image.
+    void renderGrid(float x, float y, float width, float height, VkImageView image, const GridState& state);
+    
+    // Quads and glyphs drawn between beginRecording() and endRecording() are kept
+    // in the list instead of the frame; drawList() adds them to later frames for
+    // the cost of a copy. Lists keep the glyph slots and textures they were
+    // recorded with, so the caller records again when those change. Grids can't
+    // be recorded, and recordings don't nest.
+    uint32_t createDrawList();
+    void destroyDrawList(uint32_t list);
+    void beginRecording(uint32_t list);
+    void endRecording();
+    void drawList(uint32_t list);
+    std::vector<VkImageView> getDrawListTextures(uint32_t list) const;
+    
+    // The frame is retained between frames: only damaged pixels are cleared and
+    // redrawn (quads outside the damage are dropped), then copied and presented.
+    // Damage may be added at any point before endFrame().
+    void addDamage(float x, float y, float width, float height);
+    void damageAll();
+    bool hasDamage() const { return framebufferResized_ || !frameDamage_.empty(); }
+    
     uint32_t getCurrentImageIndex() const;
     
+    // GPU time per phase, in milliseconds, over recent frames. Timestamps are
+    // read back when a frame's slot comes round again, so figures lag a couple
+    // of frames. Without timestamp support the stats simply stay empty.
+    void setRenderPhase(RenderPhase phase) { currentPhase_ = phase; }
+    bool hasGpuTimings() const { return timestampPeriod_ > 0.0f; }
+    const RollingStats& getPhaseStats(RenderPhase phase) const { return phaseStats_[static_cast<size_t>(phase)]; }
+    const RollingStats& getGpuFrameStats() const { return gpuFrameStats_; }
+    static const char* getRenderPhaseName(RenderPhase phase);
+    const FrameCounters& getFrameCounters() const { return lastCounters_; }
+    
+    // Milliseconds from process start to the first presented frame (submitted,
+    // headless), 0 before it; and whether pipelines came from a warm cache
+    double getFirstFrameTime() const { return firstFrameMs_; }
+    bool isPipelineCacheWarm() const { return pipelineCacheWarm_; }
+    
+    // Copy the frame being recorded to host memory; readCapture() must follow
+    // its endFrame() and returns it as tightly packed RGBA rows
+    void requestCapture() { captureRequested_ = true; }
+    bool readCapture(std::vector<uint8_t>& pixels);
+    bool isHeadless() const { return window_ == nullptr; }
+    
     VkDevice getDevice() const { return device_; }
     VkPhysicalDevice getPhysicalDevice() const { return physicalDevice_; }
     VkCommandBuffer getCurrentCommandBuffer() const { return commandBuffers_[currentFrame_]; }
@@ -77,10 +407,19 @@ public:
     uint32_t getWidth() const { return swapChainExtent_.width; }
     uint32_t getHeight() const { return swapChainExtent_.height; }
     
+    ImageCache& getImageCache() { return *imageCache_; } // Shared by all sessions
+    MemoryStats getMemoryStats() const { return allocator_.getStats(); }
+    void dumpMemoryStats(std::ostream& out) const { allocator_.dumpStats(out); }
+    
     void recreateSwapChain();
+    // Called once the swap chain has been recreated, e.g. after a resize
+    std::function<void()> onSwapChainRecreated;
     
 private:
     GLFWwindow* window_;
+    VkExtent2D headlessExtent_{};
+    std::unique_ptr<ImageCache> imageCache_;
+    DeviceAllocator allocator_;
     
     VkInstance instance_ = VK_NULL_HANDLE;
     VkDebugUtilsMessengerEXT debugMessenger_ = VK_NULL_HANDLE;
@@ -89,37 +428,230 @@ private:
     VkDevice device_ = VK_NULL_HANDLE;
     VkQueue graphicsQueue_ = VK_NULL_HANDLE;
     VkQueue presentQueue_ = VK_NULL_HANDLE;
+    VkQueue transferQueue_ = VK_NULL_HANDLE;
+    uint32_t graphicsFamily_ = 0;
+    uint32_t transferFamily_ = 0; // Same as graphicsFamily_ without a dedicated transfer queue
+    bool timelineSupported_ = false;
+    bool properties2Supported_ = false; // VK_KHR_get_physical_device_properties2 enabled on the instance
     VkSwapchainKHR swapChain_ = VK_NULL_HANDLE;
     std::vector<VkImage> swapChainImages_;
     VkFormat swapChainImageFormat_;
     VkExtent2D swapChainExtent_;
     std::vector<VkImageView> swapChainImageViews_;
     VkRenderPass renderPass_ = VK_NULL_HANDLE;
+    VkRenderPass targetRenderPass_ = VK_NULL_HANDLE; // Compatible with renderPass_, ends shader-readable
     VkDescriptorSetLayout descriptorSetLayout_ = VK_NULL_HANDLE;
+    VkDescriptorSetLayout frameSetLayout_ = VK_NULL_HANDLE; // Set 1: the glyph slot table and grid states
     VkPipelineLayout pipelineLayout_ = VK_NULL_HANDLE;
-    VkPipeline graphicsPipeline_ = VK_NULL_HANDLE;
+    
+    // One pipeline per kind of quad, each with its own shaders, vertex format and blending.
+    // The glyph pipelines draw instances from frameGlyphs_, the rest quads from frameQuads_.
+    enum class PipelineKind : uint8_t {
+        Solid = 0,
+        Textured,
+        Image,
+        Grid,
+        Glyph,
+        DistanceFieldGlyph,
+        ColorGlyph,
+        Count
+    };
+    enum class VertexFormat : uint8_t {
+        Solid = 0,
+        Textured,
+        Image,
+        Grid,
+        Glyph,
+        Count
+    };
+    std::array<VkPipeline, static_cast<size_t>(PipelineKind::Count)> pipelines_{};
+    VkPipelineCache pipelineCache_ = VK_NULL_HANDLE;
+    bool pipelineCacheWarm_ = false; // Loaded from disk rather than started empty
+    double firstFrameMs_ = 0.0;
     VkSampler textureSampler_ = VK_NULL_HANDLE;
     VkDescriptorPool descriptorPool_ = VK_NULL_HANDLE;
-    std::vector<VkFramebuffer> swapChainFramebuffers_;
     VkCommandPool commandPool_ = VK_NULL_HANDLE;
     
-    // Vertex buffer for quad rendering
-    VkBuffer quadVertexBuffer_ = VK_NULL_HANDLE;
-    VkDeviceMemory quadVertexBufferMemory_ = VK_NULL_HANDLE;
-    std::vector<Vertex> quadVertices_;
+    // Quads are collected during the frame and drawn in endFrame(), one draw per texture run
+    struct Quad {
+        float x0, y0, x1, y1;
+        float u0, v0, u1, v1;
+        float color[4];
+        uint32_t grid = 0; // In frameGridStates_, for the grid pipeline
+    };
+    
+    struct DrawBatch {
+        VkImageView texture; // VK_NULL_HANDLE for solid color
+        PipelineKind pipeline;
+        RenderPhase phase;
+        uint32_t firstQuad;  // In frameQuads_, or frameGlyphs_ for the glyph pipelines
+        uint32_t quadCount;
+        float x0, y0, x1, y1; // Bounds of its quads, for reordering
+        uint32_t firstVertex = 0; // In the pipeline's vertex region, set by uploadVertices(); instances for glyphs
+        uint32_t vertexCount = 0;
+    };
+    
+    struct StagingChunk {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        MemoryAllocation memory;
+        void* mapped = nullptr;
+        VkDeviceSize size = 0;
+        VkDeviceSize offset = 0;
+    };
+    
+    struct PendingUpload {
+        VkImage image;
+        VkBuffer buffer;
+        VkBufferImageCopy region;
+    };
+    
+    // Whole-texture uploads are recorded into a transfer batch that is submitted
+    // no later than the next frame, which waits for it on the GPU. The CPU only
+    // waits when the upload ring is full or a texture still being written is destroyed.
+    struct TransferBatch {
+        VkCommandBuffer cmd = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE;
+        uint64_t value = 0;         // Timeline value signalled when the batch completes
+        VkDeviceSize ringEnd = 0;   // Ring head when the batch was submitted
+        VkDeviceSize ringBytes = 0; // Ring space held, alignment and wrap padding included
+        std::vector<std::pair<VkBuffer, MemoryAllocation>> oversized; // Staging too large for the ring
+    };
+    
+    // Render targets are moved out of UNDEFINED at the start of the next frame
+    struct PendingTransition {
+        VkImage image;
+        VkImageLayout layout;
+    };
+    
+    // Per frame-in-flight buffers, reused once the frame's fence has signalled
+    struct FrameResources {
+        VkBuffer vertexBuffer = VK_NULL_HANDLE;
+        MemoryAllocation vertexMemory;
+        void* vertexMapped = nullptr;
+        VkDeviceSize vertexCapacity = 0;
+        std::vector<StagingChunk> staging;
+        std::array<VkDeviceSize, static_cast<size_t>(VertexFormat::Count)> vertexOffsets{}; // Where each format's vertices start
+        
+        // Copy of the glyph slot table, refreshed when it is older than glyphSlotVersion_,
+        // and the frame's grid states; both bound through frameSet
+        VkDescriptorSet frameSet = VK_NULL_HANDLE;
+        VkBuffer slotBuffer = VK_NULL_HANDLE;
+        MemoryAllocation slotMemory;
+        VkDeviceSize slotCapacity = 0;
+        uint64_t slotVersion = 0;
+        VkBuffer gridBuffer = VK_NULL_HANDLE;
+        MemoryAllocation gridMemory;
+        VkDeviceSize gridCapacity = 0;
+        
+        // Timestamp i starts a stretch of GPU work credited to queryPhases[i];
+        // RenderPhase::Count marks work outside any phase
+        VkQueryPool queryPool = VK_NULL_HANDLE;
+        uint32_t queryCount = 0;
+        std::vector<RenderPhase> queryPhases;
+        RenderPhase openPhase = RenderPhase::Count;
+        
+        uint64_t serial = 0; // Of the frame last submitted from this slot
+    };
+    
+    // Runs once the GPU is done with every frame up to and including the given one
+    struct DeferredDeletion {
+        uint64_t frame;
+        std::function<void()> destroy;
+    };
+    
+    // Quads for one offscreen target, drawn in full before the frame's own pass
+    struct TargetPass {
+        VkFramebuffer framebuffer;
+        uint32_t width;
+        uint32_t height;
+        std::vector<DrawBatch> batches;
+    };
+    
+    std::vector<FrameResources> frames_;
+    std::vector<Quad> frameQuads_;
+    std::vector<GlyphInstance> frameGlyphs_;
+    std::vector<GlyphSlot> glyphSlots_;
+    std::vector<GridState> frameGridStates_;
+    uint64_t glyphSlotVersion_ = 1; // Bumped by every setGlyphSlot()
+    std::vector<DrawBatch> drawBatches_;
+    std::vector<TargetPass> targetPasses_;
+    std::vector<TargetPass> openTargets_; // Begun but not yet ended, innermost last
+    std::vector<DrawBatch>* currentBatches_ = &drawBatches_; // Where renderQuad() appends
+    
+    // Batches index the list's own quads and glyphs, from 0
+    struct DrawList {
+        std::vector<Quad> quads;
+        std::vector<GlyphInstance> glyphs;
+        std::vector<DrawBatch> batches;
+    };
+    std::unordered_map<uint32_t, DrawList> drawLists_;
+    uint32_t nextDrawList_ = 0;
+    DrawList* recordingList_ = nullptr;
+    std::vector<DrawBatch>* recordingParent_ = nullptr; // currentBatches_ before recording began
+    size_t recordingQuadBase_ = 0;  // Sizes of frameQuads_ and frameGlyphs_ when it began
+    size_t recordingGlyphBase_ = 0;
+    RenderPhase currentPhase_ = RenderPhase::PaneContent;
+    std::vector<PendingUpload> pendingUploads_;
+    std::vector<PendingTransition> pendingTransitions_;
+    std::unordered_map<VkImageView, VkDescriptorSet> descriptorSets_;
+    std::unordered_map<VkImageView, TextureMode> textureModes_; // Views not listed are Color
+    bool frameStarted_ = false;
+    uint64_t frameSerial_ = 0;     // Frames submitted so far
+    uint64_t completedSerial_ = 0; // Frames the GPU is known to have finished
+    std::deque<DeferredDeletion> deletionQueue_;
     
-    // White texture for solid colored quads
-    VkImage whiteTexture_ = VK_NULL_HANDLE;
-    VkDeviceMemory whiteTextureMemory_ = VK_NULL_HANDLE;
-    VkImageView whiteTextureView_ = VK_NULL_HANDLE;
     std::vector<VkCommandBuffer> commandBuffers_;
     std::vector<VkSemaphore> imageAvailableSemaphores_;
     std::vector<VkSemaphore> renderFinishedSemaphores_;
     std::vector<VkFence> inFlightFences_;
     size_t currentFrame_ = 0;
+    uint32_t framesInFlight_ = 2;
+    VkPresentModeKHR presentMode_ = VK_PRESENT_MODE_MAILBOX_KHR;
+    
+    // Upload ring, freed in submission order as transfer batches complete
+    VkCommandPool transferCommandPool_ = VK_NULL_HANDLE;
+    VkSemaphore transferTimeline_ = VK_NULL_HANDLE; // Null without timeline semaphore support
+    uint64_t transferValue_ = 0;                     // Last value submitted
+    VkBuffer uploadRing_ = VK_NULL_HANDLE;
+    MemoryAllocation uploadRingMemory_;
+    VkDeviceSize ringHead_ = 0;
+    VkDeviceSize ringTail_ = 0;
+    VkDeviceSize ringUsed_ = 0;
+    TransferBatch openTransfer_;
+    bool transferOpen_ = false;
+    std::deque<TransferBatch> transfersInFlight_;
+    std::vector<TransferBatch> idleTransfers_;
     
     bool framebufferResized_ = false;
     
+    // Retained color target the render pass draws into; swap chain images are
+    // refreshed from it by copying whatever changed since they were last shown
+    RenderTarget scene_;
+    DamageRegion frameDamage_;
+    std::vector<DamageRegion> imageDamage_; // Per swap chain image, relative to its last present
+    bool incrementalPresentSupported_ = false;
+    
+    bool displayTimingSupported_ = false;
+    PFN_vkGetRefreshCycleDurationGOOGLE getRefreshCycleDuration_ = nullptr;
+    PFN_vkGetPastPresentationTimingGOOGLE getPastPresentationTiming_ = nullptr;
+    uint32_t presentId_ = 0;
+    uint64_t refreshDurationNs_ = 0;
+    uint64_t lastVblankNs_ = 0;
+    
+    float timestampPeriod_ = 0.0f; // Nanoseconds per tick, 0 without timestamp support
+    uint64_t timestampMask_ = 0;
+    std::array<RollingStats, static_cast<size_t>(RenderPhase::Count)> phaseStats_;
+    RollingStats gpuFrameStats_;
+    FrameCounters frameCounters_; // Being recorded
+    FrameCounters lastCounters_;
+    
+    // Host-visible copy of the scene for readCapture()
+    VkBuffer captureBuffer_ = VK_NULL_HANDLE;
+    MemoryAllocation captureMemory_;
+    bool captureRequested_ = false;
+    bool capturePending_ = false;
+    size_t captureFrame_ = 0; // Frame in flight whose fence covers the copy
+    
     void createInstance();
     void setupDebugMessenger();
     void createSurface();
@@ -128,18 +660,54 @@ private:
     void createSwapChain();
     void createImageViews();
     void createRenderPass();
+    void createTargetRenderPass();
     void createDescriptorSetLayout();
-    void createGraphicsPipeline();
-    void createFramebuffers();
+    void createPipelineCache();
+    void savePipelineCache();
+    void createGraphicsPipelines();
+    void createSceneTarget();
+    void createColorTarget(uint32_t width, uint32_t height, VkImageUsageFlags usage, VkRenderPass renderPass, VkImageLayout layout, RenderTarget& target);
+    void destroyColorTarget(RenderTarget& target);
+    void retireColorTarget(RenderTarget& target);
+    void deferDeletion(std::function<void()> destroy);
+    void runDeletions();
+    void resetDamage();
     void createCommandPool();
     void createCommandBuffers();
     void createSyncObjects();
     void createTextureSampler();
     void createDescriptorPool();
-    void createQuadVertexBuffer();
-    void cleanupQuadVertexBuffer();
-    void createWhiteTexture();
-    void cleanupWhiteTexture();
+    void createFrameResources();
+    void cleanupFrameResources();
+    void resetStaging(FrameResources& frame);
+    void ensureVertexCapacity(FrameResources& frame, VkDeviceSize size);
+    void uploadGlyphSlots(FrameResources& frame);
+    void uploadGridStates(FrameResources& frame);
+    void ensureStorageCapacity(FrameResources& frame, uint32_t binding, VkDeviceSize size, VkDeviceSize initialSize,
+                               VkBuffer& buffer, MemoryAllocation& memory, VkDeviceSize& capacity);
+    void recordPendingUploads(VkCommandBuffer cmd);
+    void recordTargetTransitions(VkCommandBuffer cmd);
+    void createTransferResources();
+    void cleanupTransferResources();
+    VkCommandBuffer beginTransfer();
+    VkDeviceSize stageTransfer(const void* data, VkDeviceSize size, VkBuffer& buffer);
+    bool allocateRing(VkDeviceSize size, VkDeviceSize& offset, VkDeviceSize& consumed);
+    void flushTransfers();
+    void retireTransfers();
+    void completeTransfer();
+    void finishTransfers();
+    void uploadVertices();
+    void recordDrawBatches(VkCommandBuffer cmd, const std::vector<DrawBatch>& batches, const std::vector<DamageRect>& scissors, uint32_t width, uint32_t height);
+    void recordTargetPasses(VkCommandBuffer cmd);
+    void recordSceneCopy(VkCommandBuffer cmd);
+    void recordCapture(VkCommandBuffer cmd);
+    void writeTimestamp(VkCommandBuffer cmd, RenderPhase phase);
+    void readTimestamps(FrameResources& frame);
+    VkDescriptorSet getDescriptorSet(VkImageView view);
+    PipelineKind getPipelineKind(VkImageView texture) const;
+    PipelineKind getGlyphPipelineKind(VkImageView page) const;
+    static VertexFormat getVertexFormat(PipelineKind pipeline);
+    void orderDrawBatches(std::vector<DrawBatch>& batches);
     
     void cleanupSwapChain();
     
@@ -150,6 +718,7 @@ private:
     struct QueueFamilyIndices {
         std::optional<uint32_t> graphicsFamily;
         std::optional<uint32_t> presentFamily;
+        std::optional<uint32_t> transferFamily; // Transfer-only, if the device has one
         
         bool isComplete() {
             return graphicsFamily.has_value() && presentFamily.has_value();
@@ -164,23 +733,24 @@ private:
     
     bool isDeviceSuitable(VkPhysicalDevice device);
     bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+    bool isDeviceExtensionAvailable(VkPhysicalDevice device, const char* name);
+    bool isInstanceExtensionAvailable(const char* name);
+    void recordFirstFrame();
+    bool isTimelineSemaphoreSupported();
     QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
     SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
     VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats);
     VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes);
     VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities);
     
-    VkShaderModule createShaderModule(const std::vector<char>& code);
+    VkShaderModule createShaderModule(const uint32_t* code, size_t size);
     std::vector<char> readFile(const std::string& filename);
     
-    uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
 public: // Made public for FontRenderer
-    void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
-    VkCommandBuffer beginSingleTimeCommands();
-    void endSingleTimeCommands(VkCommandBuffer commandBuffer);
+    // Buffers and images draw their memory from allocator_; host-visible memory comes mapped
+    void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, MemoryAllocation& bufferMemory);
+    void destroyBuffer(VkBuffer buffer, const MemoryAllocation& bufferMemory);
 private:
-    void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
-    
     static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
         VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
         VkDebugUtilsMessageTypeFlagsEXT messageType,
@@ -37,7 +37,15 @@ Settings::Settings() {
     // Set defaults
     setInt("font.size", 16);
     setString("font.path", "fonts/default.ttf");
+    setString("font.render_mode", "bitmap");
+    setString("font.fallbacks", "fonts/himalaya.ttf");
     setString("background.default", "");
+    setString("render.present_mode", "mailbox");
+    setInt("render.frames_in_flight", 2);
+    setBool("render.late_latch", false);
+    setFloat("render.latch_margin_ms", 4.0f);
+    setString("cursor.shape", "underline");
+    setFloat("cursor.blink_ms", 530.0f);
 }
 
 Settings::~Settings() {
@@ -136,6 +144,23 @@ bool Settings::getBool(const std::string& key, bool defaultValue) const {
     return defaultValue;
 }
 
+uint32_t Settings::getFramesInFlight() const {
+    return static_cast<uint32_t>(std::clamp(getInt("render.frames_in_flight", 2), 1, 3));
+}
+
+std::vector<std::string> Settings::getFontFallbacks() const {
+    std::vector<std::string> paths;
+    std::stringstream list(getString("font.fallbacks", ""));
+    std::string path;
+    while (std::getline(list, path, ',')) {
+        path = trim(path);
+        if (!path.empty()) {
+            paths.push_back(path);
+        }
+    }
+    return paths;
+}
+
 void Settings::setString(const std::string& key, const std::string& value) {
     values_[key] = value;
 }
@@ -2,6 +2,7 @@
 
 #include <string>
 #include <map>
+#include <vector>
 #include <cstdint>
 #include <array>
 
@@ -39,8 +40,20 @@ public:
     
     std::string getFontPath() const { return getString("font.path", "fonts/default.ttf"); }
     uint32_t getFontSize() const { return static_cast<uint32_t>(getInt("font.size", 16)); }
+    std::string getFontRenderMode() const { return getString("font.render_mode", "bitmap"); } // "bitmap" or "sdf"
+    std::vector<std::string> getFontFallbacks() const; // Comma-separated font.fallbacks, in priority order
     std::string getDefaultBackground() const { return getString("background.default", ""); }
     
+    // Frame pacing: present mode is "fifo", "fifo-relaxed", "mailbox" or "immediate"
+    std::string getPresentMode() const { return getString("render.present_mode", "mailbox"); }
+    uint32_t getFramesInFlight() const; // 1-3
+    bool getLateLatch() const { return getBool("render.late_latch", false); }
+    float getLatchMargin() const { return getFloat("render.latch_margin_ms", 4.0f); }
+    
+    // Cursor shape is "block", "underline" or "bar"; a blink interval of 0 keeps it steady
+    std::string getCursorShape() const { return getString("cursor.shape", "underline"); }
+    float getCursorBlinkInterval() const { return getFloat("cursor.blink_ms", 530.0f); }
+    
     const ColorScheme& getCurrentColorScheme() const { return currentColorScheme_; }
     
 private:
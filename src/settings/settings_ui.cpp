@@ -56,6 +56,7 @@ SettingsUI::SettingsUI(Settings* settings)
 void SettingsUI::show() {
     visible_ = true;
     discoverFonts();
+    layer_.reset(); // The font list may differ from when the dialog was last recorded
     
     // Get current settings
     fontSize_ = settings_->getFontSize();
@@ -117,11 +118,28 @@ void SettingsUI::discoverFonts() {
 void SettingsUI::render(float width, float height) {
     if (!visible_ || !renderer_) return;
     
-    // Center dialog
-    dialogX_ = (width - dialogWidth_) / 2.0f;
-    dialogY_ = (height - dialogHeight_) / 2.0f;
+    float dialogWidth, dialogHeight;
+    getBounds(width, height, dialogX_, dialogY_, dialogWidth, dialogHeight);
     
-    renderDialog(width, height);
+    // Recorded again only when the list, the selection or the size shown change
+    if (!layer_) {
+        layer_ = std::make_unique<UiLayer>(renderer_, fontRenderer_);
+    }
+    layer_->draw(getContentKey(), [&]() {
+        renderDialog(width, height);
+    });
+}
+
+std::string SettingsUI::getContentKey() const {
+    return std::to_string(selectedFontIndex_) + ',' + std::to_string(scrollOffset_) + ',' + std::to_string(fontSize_);
+}
+
+void SettingsUI::getBounds(float width, float height, float& x, float& y, float& w, float& h) const {
+    // Centered in the window
+    x = (width - dialogWidth_) / 2.0f;
+    y = (height - dialogHeight_) / 2.0f;
+    w = dialogWidth_;
+    h = dialogHeight_;
 }
 
 void SettingsUI::renderDialog([[maybe_unused]] float width, [[maybe_unused]] float height) {
@@ -348,6 +366,7 @@ void SettingsUI::selectFont(int index) {
 }
 
 void SettingsUI::applySettings() {
+    std::string previousPath = settings_->getFontPath();
     if (selectedFontIndex_ >= 0 && selectedFontIndex_ < static_cast<int>(availableFonts_.size())) {
         settings_->setString("font.path", availableFonts_[selectedFontIndex_].path);
     }
@@ -355,6 +374,16 @@ void SettingsUI::applySettings() {
     if (fontSizeChanged_) {
         settings_->setInt("font.size", fontSize_);
     }
+    
+    // Apply to the live renderer; a size change alone is instant for distance-field fonts
+    if (fontRenderer_) {
+        if (settings_->getFontPath() != previousPath) {
+            fontRenderer_->loadFont(settings_->getFontPath(), settings_->getFontSize());
+        } else if (fontSizeChanged_) {
+            fontRenderer_->setFontSize(settings_->getFontSize());
+        }
+    }
+    fontSizeChanged_ = false;
 
     // Save settings
     const char* homeDir = getenv("HOME");
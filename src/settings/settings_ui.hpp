@@ -3,7 +3,9 @@
 #include "settings.hpp"
 #include "../renderer/vulkan_renderer.hpp"
 #include "../renderer/font_renderer.hpp"
+#include "../ui/ui_layer.hpp"
 #include <functional>
+#include <memory>
 #include <vector>
 #include <string>
 
@@ -18,6 +20,10 @@ public:
     void show();
     void hide() { visible_ = false; }
     
+    // What the dialog shows; it only needs redrawing, within its bounds, when this changes
+    std::string getContentKey() const;
+    void getBounds(float width, float height, float& x, float& y, float& w, float& h) const;
+    
     void setRenderer(VulkanRenderer* renderer) { renderer_ = renderer; }
     void setFontRenderer(FontRenderer* fontRenderer) { fontRenderer_ = fontRenderer; }
     
@@ -49,6 +55,8 @@ private:
     bool fontSizeChanged_;
     int fontSize_;
     
+    std::unique_ptr<UiLayer> layer_; // Created on the first render, once both renderers are set
+    
     void discoverFonts();
     void renderDialog(float width, float height);
     void renderFontList(float x, float y, float width, float height);
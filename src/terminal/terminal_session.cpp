@@ -1,6 +1,6 @@
 #include "terminal_session.hpp"
 #include "renderer/vulkan_renderer.hpp"
-#include "renderer/stb_image.h"
+#include "renderer/image_cache.hpp"
 #include <unistd.h>
 #include <sys/wait.h>
 #include <sys/ioctl.h>
@@ -10,6 +10,7 @@
 #include <signal.h>
 #include <stdexcept>
 #include <algorithm>
+#include <chrono>
 #include <sstream>
 #include <vector>
 #include <string>
@@ -22,8 +23,9 @@ TerminalSession::TerminalSession(uint32_t rows, uint32_t cols, VulkanRenderer* r
       useAlternateBuffer_(false), // Initialize alternate buffer usage
       masterFd_(-1), slaveFd_(-1), shellPid_(-1),
       renderer_(renderer), colorScheme_(colorScheme),
-      backgroundImageTexture_(VK_NULL_HANDLE), backgroundImageTextureMemory_(VK_NULL_HANDLE), backgroundImageTextureView_(VK_NULL_HANDLE),
+      backgroundImageId_(0),
       currentFgColor_(colorScheme->defaultFg), currentBgColor_(colorScheme->defaultBg), currentBold_(false), currentUnderline_(false),
+      dirty_(true), drawnCursorRow_(0), drawnCursorCol_(0),
       utf8_state_(0), utf8_codepoint_(0) {
     cells_.resize(rows_);
     for (auto& row : cells_) {
@@ -33,6 +35,7 @@ TerminalSession::TerminalSession(uint32_t rows, uint32_t cols, VulkanRenderer* r
     for (auto& row : altCells_) {
         row.resize(cols_);
     }
+    dirtyRows_.assign(rows_, true);
 }
 
 TerminalSession::~TerminalSession() {
@@ -128,9 +131,13 @@ void TerminalSession::writeInput(const std::string& data) {
 }
 
 void TerminalSession::processOutput(const std::string& data) {
+    // Timed per chunk, not per byte, so the clock costs nothing next to the parse
+    auto start = std::chrono::steady_clock::now();
     for (char c : data) {
         processByte(static_cast<unsigned char>(c));
     }
+    parseSeconds_ += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    bytesProcessed_ += data.size();
     
     if (onOutput) {
         onOutput();
@@ -217,6 +224,7 @@ void TerminalSession::resize(uint32_t rows, uint32_t cols) {
     for (auto& row : altCells_) {
         row.resize(cols_);
     }
+    markAllDirty();
 
     if (cursorRow_ >= rows_) cursorRow_ = rows_ - 1;
     if (cursorCol_ >= cols_) cursorCol_ = cols_ - 1;
@@ -233,17 +241,66 @@ void TerminalSession::resize(uint32_t rows, uint32_t cols) {
 
 void TerminalSession::setBackgroundImage(const std::string& path) {
     backgroundImage_ = path;
+    markAllDirty();
     
     destroyBackgroundImage();
     
     if (!backgroundImage_.empty() && renderer_) {
-        int imgWidth, imgHeight, channels;
-        unsigned char* data = stbi_load(backgroundImage_.c_str(), &imgWidth, &imgHeight, &channels, 4);
-        if (data) {
-            renderer_->createTexture(imgWidth, imgHeight, data, backgroundImageTexture_, backgroundImageTextureMemory_, backgroundImageTextureView_);
-            stbi_image_free(data);
-        }
+        // No pane is larger than the window, so neither needs the image any larger
+        backgroundImageId_ = renderer_->getImageCache().acquire(backgroundImage_, renderer_->getWidth(), renderer_->getHeight());
+    }
+}
+
+void TerminalSession::fitBackgroundImage(uint32_t width, uint32_t height) {
+    if (!renderer_ || backgroundImageId_ == 0) {
+        return;
+    }
+    
+    ImageCache& cache = renderer_->getImageCache();
+    if (nextBackgroundImageId_ == 0 && !cache.covers(backgroundImageId_, width, height)) {
+        nextBackgroundImageId_ = cache.acquire(backgroundImage_, width, height);
+    }
+    if (nextBackgroundImageId_ != 0 && cache.getView(nextBackgroundImageId_) != VK_NULL_HANDLE) {
+        cache.release(backgroundImageId_);
+        backgroundImageId_ = nextBackgroundImageId_;
+        nextBackgroundImageId_ = 0;
+        markAllDirty();
+    }
+}
+
+VkImageView TerminalSession::getBackgroundImage_() const {
+    return backgroundImageId_ != 0 ? renderer_->getImageCache().getView(backgroundImageId_) : VK_NULL_HANDLE;
+}
+
+bool TerminalSession::hasDirtyRows() const {
+    return dirty_ || getCursorRow() != drawnCursorRow_ || getCursorCol() != drawnCursorCol_;
+}
+
+void TerminalSession::takeDirtyRows(std::vector<bool>& rows) {
+    uint32_t cursorRow = getCursorRow();
+    uint32_t cursorCol = getCursorCol();
+    if (cursorRow != drawnCursorRow_ || cursorCol != drawnCursorCol_) {
+        markRowDirty(drawnCursorRow_);
+        markRowDirty(cursorRow);
+        drawnCursorRow_ = cursorRow;
+        drawnCursorCol_ = cursorCol;
     }
+    
+    rows.assign(dirtyRows_.begin(), dirtyRows_.end());
+    std::fill(dirtyRows_.begin(), dirtyRows_.end(), false);
+    dirty_ = false;
+}
+
+void TerminalSession::markRowDirty(uint32_t row) {
+    if (row < dirtyRows_.size()) {
+        dirtyRows_[row] = true;
+        dirty_ = true;
+    }
+}
+
+void TerminalSession::markAllDirty() {
+    dirtyRows_.assign(rows_, true);
+    dirty_ = true;
 }
 
 std::vector<std::vector<Cell>>& TerminalSession::getActiveCells() {
@@ -269,6 +326,7 @@ void TerminalSession::putChar(char32_t c) {
         currentCells[currentCursorRow][currentCursorCol].bgColor = currentBgColor_;
         currentCells[currentCursorRow][currentCursorCol].bold = currentBold_;
         currentCells[currentCursorRow][currentCursorCol].underline = currentUnderline_;
+        markRowDirty(currentCursorRow);
 
         currentCursorCol++;
         if (currentCursorCol >= cols_) {
@@ -289,6 +347,7 @@ void TerminalSession::newLine() {
         if (!useAlternateBuffer_) {
             if (scrollback_.size() >= MAX_SCROLLBACK_LINES) {
                 scrollback_.pop_front();
+                scrollbackBase_++;
             }
             scrollback_.push_back(currentCells.front());
         }
@@ -297,6 +356,7 @@ void TerminalSession::newLine() {
         currentCells.erase(currentCells.begin());
         currentCells.push_back(std::vector<Cell>(cols_));
         currentCursorRow = rows_ - 1;
+        markAllDirty();
     }
 }
 
@@ -308,15 +368,18 @@ void TerminalSession::backspace() {
     if (currentCursorCol > 0) {
         currentCursorCol--;
         currentCells[currentCursorRow][currentCursorCol] = Cell();
+        markRowDirty(currentCursorRow);
     }
 }
 
 void TerminalSession::destroyBackgroundImage() {
-    if (renderer_ && backgroundImageTextureView_ != VK_NULL_HANDLE) {
-        renderer_->destroyTexture(backgroundImageTexture_, backgroundImageTextureMemory_, backgroundImageTextureView_);
-        backgroundImageTexture_ = VK_NULL_HANDLE;
-        backgroundImageTextureMemory_ = VK_NULL_HANDLE;
-        backgroundImageTextureView_ = VK_NULL_HANDLE;
+    if (renderer_ && backgroundImageId_ != 0) {
+        renderer_->getImageCache().release(backgroundImageId_);
+        backgroundImageId_ = 0;
+    }
+    if (renderer_ && nextBackgroundImageId_ != 0) {
+        renderer_->getImageCache().release(nextBackgroundImageId_);
+        nextBackgroundImageId_ = 0;
     }
 }
 
@@ -502,6 +565,7 @@ void TerminalSession::parseCSI(const std::string& params) {
                 currentCells[getActiveCursorRow()][col] = Cell();
             }
         }
+        markRowDirty(getActiveCursorRow());
     } else if (cmd == 'h' || cmd == 'l') { // Set Mode / Reset Mode
         if (nums == "?1049") { // Alternate Screen Buffer
             if (cmd == 'h') { // Enable alternate buffer
@@ -513,6 +577,7 @@ void TerminalSession::parseCSI(const std::string& params) {
             } else { // Disable alternate buffer
                 useAlternateBuffer_ = false;
             }
+            markAllDirty();
         }
     }
 }
@@ -536,8 +601,10 @@ void TerminalSession::clearScreen() {
     }
     // Only clear scrollback if not in alternate buffer
     if (!useAlternateBuffer_) {
+        scrollbackBase_ += scrollback_.size();
         scrollback_.clear();
     }
+    markAllDirty();
     currentCursorRow = 0;
     currentCursorCol = 0;
 }
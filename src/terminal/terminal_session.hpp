@@ -40,17 +40,30 @@ public:
     const std::vector<std::vector<Cell>>& getCells() const { return useAlternateBuffer_ ? altCells_ : cells_; }
     const std::deque<std::vector<Cell>>& getScrollback() const { return scrollback_; } // Scrollback is shared
     size_t getScrollbackSize() const { return scrollback_.size(); }
+    uint64_t getScrollbackBase() const { return scrollbackBase_; } // Absolute index of scrollback_[0]; lines never change index
     uint32_t getRows() const { return rows_; }
     uint32_t getCols() const { return cols_; }
     uint32_t getCursorRow() const { return useAlternateBuffer_ ? altCursorRow_ : cursorRow_; }
     uint32_t getCursorCol() const { return useAlternateBuffer_ ? altCursorCol_ : cursorCol_; }
     
+    // Screen rows changed since the last takeDirtyRows(), for partial redraws.
+    // The rows the cursor left and entered count as changed.
+    bool hasDirtyRows() const;
+    void takeDirtyRows(std::vector<bool>& rows);
+    
     void setBackgroundImage(const std::string& path);
     const std::string& getBackgroundImage() const { return backgroundImage_; }
-    VkImageView getBackgroundImage_() const { return backgroundImageTextureView_; }
+    VkImageView getBackgroundImage_() const; // Null while the image is still loading
+    // Decodes the image again if the window grew past the size it was decoded
+    // for; the smaller copy is shown until the larger one has loaded
+    void fitBackgroundImage(uint32_t width, uint32_t height);
     
     int getMasterFd() const { return masterFd_; }
     
+    // Totals since the session started, for throughput figures
+    uint64_t getBytesProcessed() const { return bytesProcessed_; }
+    double getParseSeconds() const { return parseSeconds_; }
+    
     std::function<void()> onOutput;
     
 private:
@@ -60,6 +73,7 @@ private:
     // Main screen buffer
     std::vector<std::vector<Cell>> cells_;
     std::deque<std::vector<Cell>> scrollback_;
+    uint64_t scrollbackBase_ = 0; // Lines dropped from the front so far
     uint32_t cursorRow_;
     uint32_t cursorCol_;
 
@@ -76,9 +90,8 @@ private:
     VulkanRenderer* renderer_; // Restored
     const ColorScheme* colorScheme_;
     std::string backgroundImage_;
-    VkImage backgroundImageTexture_;
-    VkDeviceMemory backgroundImageTextureMemory_;
-    VkImageView backgroundImageTextureView_;
+    uint32_t backgroundImageId_; // Reference into the renderer's image cache, 0 if none
+    uint32_t nextBackgroundImageId_ = 0; // Larger copy still loading, see fitBackgroundImage()
     
     uint32_t currentFgColor_;
     uint32_t currentBgColor_;
@@ -86,10 +99,19 @@ private:
     bool currentUnderline_;
     std::string escapeBuffer_;
     
+    // Damage tracking for the active buffer
+    std::vector<bool> dirtyRows_;
+    bool dirty_;
+    uint32_t drawnCursorRow_;
+    uint32_t drawnCursorCol_;
+    
     // For UTF-8 decoding
     uint32_t utf8_state_ = 0;
     uint32_t utf8_codepoint_ = 0;
     
+    uint64_t bytesProcessed_ = 0;
+    double parseSeconds_ = 0.0;
+    
     void destroyBackgroundImage();
     void parseEscapeSequence(const std::string& sequence);
     void parseCSI(const std::string& params);
@@ -102,6 +124,8 @@ private:
     void newLine(); // Operates on active buffer
     void backspace(); // Operates on active buffer
     void processByte(unsigned char byte);
+    void markRowDirty(uint32_t row);
+    void markAllDirty();
 
     // Helper to get a reference to the currently active cells and cursor
     std::vector<std::vector<Cell>>& getActiveCells();
@@ -48,17 +48,23 @@ void MenuBar::createMenuItems() {
 void MenuBar::render(float width, [[maybe_unused]] float height) {
     if (!renderer_) return;
     
-    // Render menu bar background (dark gray)
-    renderer_->renderQuad(0.0f, 0.0f, width, menuBarHeight_, VK_NULL_HANDLE, 0.25f, 0.25f, 0.25f, 1.0f);
-    
-    // Render menu items
-    if (fontRenderer_) {
-        for (const auto& item : menuItems_) {
-            // Render item background on hover would go here
-            // For now, just render text
-            fontRenderer_->renderString(item.x + 5.0f, item.y + 5.0f, item.label, 0.9f, 0.9f, 0.9f);
-        }
+    // The items are fixed, so the bar is only recorded again for a new window size or font
+    if (!layer_) {
+        layer_ = std::make_unique<UiLayer>(renderer_, fontRenderer_);
     }
+    layer_->draw("", [&]() {
+        // Render menu bar background (dark gray)
+        renderer_->renderQuad(0.0f, 0.0f, width, menuBarHeight_, VK_NULL_HANDLE, 0.25f, 0.25f, 0.25f, 1.0f);
+        
+        // Render menu items
+        if (fontRenderer_) {
+            for (const auto& item : menuItems_) {
+                // Render item background on hover would go here
+                // For now, just render text
+                fontRenderer_->renderString(item.x + 5.0f, item.y + 5.0f, item.label, 0.9f, 0.9f, 0.9f);
+            }
+        }
+    });
 }
 
 bool MenuBar::handleClick(float x, float y) {
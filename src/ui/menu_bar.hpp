@@ -1,6 +1,8 @@
 #pragma once
 
+#include "ui_layer.hpp"
 #include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -38,6 +40,7 @@ private:
     
     VulkanRenderer* renderer_ = nullptr;
     FontRenderer* fontRenderer_ = nullptr;
+    std::unique_ptr<UiLayer> layer_; // Created on the first render, once both renderers are set
     
     void createMenuItems();
 };
\ No newline at end of file
@@ -2,9 +2,13 @@
 #include "../application.hpp" // For Application::drawTerminalContent
 #include "../settings/settings.hpp"
 #include <iostream>
+#include <algorithm>
+#include <iterator>
 #include <unistd.h>
 #include <sys/select.h>
 #include <cerrno>
+#include <chrono>
+#include <cmath>
 #include <cstring>
 
 namespace {
@@ -12,6 +16,12 @@ namespace {
     constexpr uint32_t DEFAULT_TERMINAL_COLS = 80;
     constexpr uint32_t DEFAULT_TERMINAL_ROWS = 24;
     constexpr size_t PTY_BUFFER_SIZE = 4096;
+    // Seconds a pane's size must hold still before its session is resized
+    constexpr double RESIZE_SETTLE_TIME = 0.1;
+
+    double secondsNow() {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
 }
 
 PaneManager::PaneManager(Application* app, VulkanRenderer* renderer, Settings* settings)
@@ -20,6 +30,9 @@ PaneManager::PaneManager(Application* app, VulkanRenderer* renderer, Settings* s
 
 PaneManager::~PaneManager() {
     // All panes will be deallocated automatically by unique_ptr
+    for (auto& entry : surfaces_) {
+        renderer_->destroyRenderTarget(entry.second.target);
+    }
 }
 
 Pane* PaneManager::createRootPane() {
@@ -143,6 +156,21 @@ Pane* PaneManager::getPaneById(int id) {
     return nullptr;
 }
 
+void PaneManager::forEachSession(const std::function<void(const Pane&)>& visit) const {
+    std::function<void(const Pane*)> walk = [&](const Pane* pane) {
+        if (!pane) return;
+        if (pane->session) {
+            visit(*pane);
+        }
+        for (const auto& child : pane->children) {
+            walk(child.get());
+        }
+    };
+    for (const auto& root : rootPanes_) {
+        walk(root.get());
+    }
+}
+
 Pane* PaneManager::findPaneRecursive(Pane* current, int id) {
     if (!current) return nullptr;
     if (current->id == id) return current;
@@ -156,6 +184,10 @@ Pane* PaneManager::findPaneRecursive(Pane* current, int id) {
 
 
 void PaneManager::update() {
+    if (resizePending_) {
+        applySettledResizes();
+    }
+    
     fd_set readfds;
     FD_ZERO(&readfds);
     int maxFd = -1;
@@ -224,6 +256,190 @@ void PaneManager::render(float x, float y, float width, float height) {
     if (!rootPanes_.empty()) {
         renderPane(rootPanes_.front().get(), x, y, width, height);
     }
+    
+    // Drop the images of panes that are gone
+    for (auto it = surfaces_.begin(); it != surfaces_.end();) {
+        if (!it->second.used) {
+            renderer_->destroyRenderTarget(it->second.target);
+            it = surfaces_.erase(it);
+        } else {
+            it->second.used = false;
+            ++it;
+        }
+    }
+    invalidated_ = false;
+}
+
+void PaneManager::invalidatePanes() {
+    invalidated_ = true;
+}
+
+void PaneManager::clearRowCaches() {
+    for (auto& [id, surface] : surfaces_) {
+        if (surface.rowCache) {
+            surface.rowCache->clear();
+        }
+    }
+}
+
+void PaneManager::updateHighlights() {
+    forEachSession([&](const Pane& pane) {
+        auto it = surfaces_.find(pane.id);
+        if (it != surfaces_.end() && it->second.target.view != VK_NULL_HANDLE) {
+            updateGrid(pane, it->second);
+        }
+    });
+}
+
+void PaneManager::updateGrid(const Pane& pane, PaneSurface& surface) {
+    GridState grid = app_->getGridState(pane.session.get(), static_cast<float>(surface.target.width),
+                                        static_cast<float>(surface.target.height), &pane == activePane_);
+    grid.originX += surface.x;
+    grid.originY += surface.y;
+    if (grid == surface.grid) {
+        return;
+    }
+    
+    // A cursor that only moved or blinked damages the cells it left and entered;
+    // any other change, the whole pane
+    GridState previous = surface.grid;
+    std::copy(std::begin(grid.cursor), std::end(grid.cursor), std::begin(previous.cursor));
+    previous.cursorShape = grid.cursorShape;
+    previous.cursorAlpha = grid.cursorAlpha;
+    if (previous == grid) {
+        for (const GridState* state : {&surface.grid, &grid}) {
+            if (state->showsCursor()) {
+                renderer_->addDamage(state->originX + state->cursor[0] * state->cellWidth,
+                                     state->originY + state->cursor[1] * state->cellHeight, state->cellWidth, state->cellHeight);
+            }
+        }
+    } else {
+        renderer_->addDamage(surface.x, surface.y, surface.target.width, surface.target.height);
+    }
+    surface.grid = grid;
+}
+
+bool PaneManager::hasDirtySessions() const {
+    for (const auto& rootPane : rootPanes_) {
+        if (hasDirtySession(rootPane.get())) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool PaneManager::hasDirtySession(const Pane* pane) const {
+    if (!pane) return false;
+    if (pane->session && pane->session->hasDirtyRows()) {
+        return true;
+    }
+    for (const auto& child : pane->children) {
+        if (hasDirtySession(child.get())) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void PaneManager::renderSurface(Pane* pane) {
+    TerminalSession* session = pane->session.get();
+    
+    // Pixel-aligned so the image is composited 1:1
+    int32_t x0 = static_cast<int32_t>(std::lround(pane->x));
+    int32_t y0 = static_cast<int32_t>(std::lround(pane->y));
+    uint32_t width = static_cast<uint32_t>(std::max<long>(std::lround(pane->x + pane->width) - x0, 1));
+    uint32_t height = static_cast<uint32_t>(std::max<long>(std::lround(pane->y + pane->height) - y0, 1));
+    
+    PaneSurface& surface = surfaces_[pane->id];
+    surface.used = true;
+    fitSession(pane, surface, width, height);
+    
+    bool moved = surface.target.width != width || surface.target.height != height || surface.x != x0 || surface.y != y0;
+    if (moved) {
+        renderer_->addDamage(surface.x, surface.y, surface.target.width, surface.target.height);
+        renderer_->addDamage(x0, y0, width, height);
+        if (surface.target.width != width || surface.target.height != height) {
+            renderer_->destroyRenderTarget(surface.target);
+            renderer_->createRenderTarget(width, height, surface.target);
+        }
+        surface.x = x0;
+        surface.y = y0;
+    }
+    updateGrid(*pane, surface);
+    
+    if (moved || invalidated_ || session->hasDirtyRows() || surface.missingGlyphs) {
+        if (surface.missingGlyphs) {
+            renderer_->addDamage(x0, y0, width, height);
+        }
+        session->takeDirtyRows(dirtyRows_);
+        uint32_t rows = session->getRows();
+        if (!moved && rows > 0) {
+            // Only the changed rows need compositing again; half a cell of slack covers glyph overhang
+            float cellHeight = static_cast<float>(height) / rows;
+            for (uint32_t i = 0; i < rows && i < dirtyRows_.size(); ++i) {
+                if (dirtyRows_[i]) {
+                    renderer_->addDamage(x0, y0 + (i - 0.5f) * cellHeight, width, cellHeight * 2.0f);
+                }
+            }
+        }
+        
+        if (!surface.rowCache) {
+            surface.rowCache = std::make_unique<RowStripCache>(renderer_);
+        }
+        renderer_->beginTarget(surface.target);
+        surface.missingGlyphs = !app_->drawTerminalContent(session, 0.0f, 0.0f, static_cast<float>(width), static_cast<float>(height),
+                                                           surface.rowCache.get());
+        renderer_->endTarget();
+    }
+    
+    // Composited with its cursor and highlights, which are timed as overlays
+    renderer_->setRenderPhase(RenderPhase::Overlays);
+    renderer_->renderGrid(x0, y0, width, height, surface.target.view, surface.grid);
+    renderer_->setRenderPhase(RenderPhase::PaneContent);
+}
+
+void PaneManager::fitSession(Pane* pane, PaneSurface& surface, uint32_t width, uint32_t height) {
+    float cellWidth, cellHeight;
+    if (!app_->getCellSize(cellWidth, cellHeight)) return;
+    uint32_t rows = std::max(1u, static_cast<uint32_t>(height / cellHeight));
+    uint32_t cols = std::max(1u, static_cast<uint32_t>(width / cellWidth));
+    if (rows == surface.rows && cols == surface.cols) return;
+    
+    if (surface.rows == 0) {
+        // A new pane gets its grid before it is first drawn
+        pane->session->resize(rows, cols);
+    } else {
+        // While a window edge is dragged the size changes every frame; the
+        // shell only hears about it (TIOCSWINSZ) once the size has settled
+        surface.resizeDue = secondsNow() + RESIZE_SETTLE_TIME;
+        resizePending_ = true;
+    }
+    surface.rows = rows;
+    surface.cols = cols;
+}
+
+void PaneManager::applySettledResizes() {
+    double now = secondsNow();
+    resizePending_ = false;
+    std::function<void(Pane*)> apply = [&](Pane* pane) {
+        if (pane->session) {
+            auto it = surfaces_.find(pane->id);
+            if (it != surfaces_.end() && it->second.rows > 0 &&
+                (it->second.rows != pane->session->getRows() || it->second.cols != pane->session->getCols())) {
+                if (now >= it->second.resizeDue) {
+                    pane->session->resize(it->second.rows, it->second.cols);
+                } else {
+                    resizePending_ = true;
+                }
+            }
+        }
+        for (const auto& child : pane->children) {
+            apply(child.get());
+        }
+    };
+    for (const auto& rootPane : rootPanes_) {
+        apply(rootPane.get());
+    }
 }
 
 void PaneManager::renderPane(Pane* pane, float x, float y, float width, float height) {
@@ -235,8 +451,7 @@ void PaneManager::renderPane(Pane* pane, float x, float y, float width, float he
     pane->height = height;
 
     if (pane->session) {
-        // Render the terminal session content using Application's method
-        app_->drawTerminalContent(pane->session.get(), pane->x, pane->y, pane->width, pane->height);
+        renderSurface(pane);
     } else {
         // This is a container pane, render its children
         if (!pane->children.empty()) {
@@ -1,7 +1,10 @@
 #pragma once
 
 #include "pane.hpp"
+#include "renderer/row_strip_cache.hpp"
+#include "renderer/vulkan_renderer.hpp"
 #include <memory>
+#include <unordered_map>
 #include <vector>
 #include <functional> // For std::function
 // Forward declarations
@@ -27,9 +30,18 @@ public:
     // Tree traversal/rendering
     void update(); // Update all terminal sessions
     void render(float x, float y, float width, float height); // Render all panes recursively
+    bool hasDirtySessions() const; // Any session with rows to redraw
+    void invalidatePanes(); // Re-render every pane next frame, e.g. after a scroll
+    void clearRowCaches();  // Drop every cached scrollback strip
+    // Damages whatever the cursor, selection and search highlights changed since the
+    // last frame; they are drawn over the pane images, which stay as they are
+    void updateHighlights();
 
     // Get a specific pane by its ID (useful for external interaction)
     Pane* getPaneById(int id);
+    
+    // Every leaf pane that has a session, in tree order
+    void forEachSession(const std::function<void(const Pane&)>& visit) const;
 
 private:
     Application* app_;
@@ -39,10 +51,34 @@ private:
     std::vector<std::unique_ptr<Pane>> rootPanes_; // Each root pane represents a 'tab'
     Pane* activePane_;
     int nextPaneId_;
+    
+    // Each leaf pane is rendered into its own image, refreshed only when its
+    // session changed; the frame itself just composites the images
+    struct PaneSurface {
+        RenderTarget target;
+        std::unique_ptr<RowStripCache> rowCache;
+        int32_t x = 0; // Where it was last composited
+        int32_t y = 0;
+        bool used = false;
+        uint32_t rows = 0; // Grid that fits the pane, applied to the session once settled
+        uint32_t cols = 0;
+        double resizeDue = 0.0;
+        GridState grid; // Cursor and highlights it is composited with, in frame pixels
+        bool missingGlyphs = false; // Drawn with placeholders, so drawn again next frame
+    };
+    std::unordered_map<int, PaneSurface> surfaces_;
+    std::vector<bool> dirtyRows_;
+    bool invalidated_ = true;
+    bool resizePending_ = false;
 
     // Helper functions for recursive operations on the pane tree
     void renderPane(Pane* pane, float x, float y, float width, float height);
     void updatePane(Pane* pane);
+    void renderSurface(Pane* pane);
+    void updateGrid(const Pane& pane, PaneSurface& surface);
+    bool hasDirtySession(const Pane* pane) const;
+    void fitSession(Pane* pane, PaneSurface& surface, uint32_t width, uint32_t height);
+    void applySettledResizes();
 
     // Helper to find a pane recursively
     Pane* findPaneRecursive(Pane* current, int id);
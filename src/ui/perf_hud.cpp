@@ -0,0 +1,165 @@
+#include "perf_hud.hpp"
+#include "../renderer/vulkan_renderer.hpp"
+#include "../renderer/font_renderer.hpp"
+#include "../terminal/terminal_session.hpp"
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+    // Longer gaps between frames mean the terminal was idle, not slow
+    constexpr double IDLE_GAP_MS = 100.0;
+
+    std::string format(const char* fmt, double a, double b = 0.0, double c = 0.0) {
+        char buffer[96];
+        std::snprintf(buffer, sizeof(buffer), fmt, a, b, c);
+        return buffer;
+    }
+}
+
+PerfHud::PerfHud() : frameStats_(240), cpuStats_(240) {
+}
+
+void PerfHud::setRenderer(VulkanRenderer* renderer) {
+    renderer_ = renderer;
+}
+
+void PerfHud::setFontRenderer(FontRenderer* fontRenderer) {
+    fontRenderer_ = fontRenderer;
+}
+
+void PerfHud::recordFrame(double frameMs, double cpuMs) {
+    cpuStats_.add(cpuMs);
+    if (frameMs > IDLE_GAP_MS) {
+        return;
+    }
+    frameStats_.add(frameMs);
+    history_[historyNext_] = static_cast<float>(frameMs);
+    historyNext_ = (historyNext_ + 1) % history_.size();
+}
+
+bool PerfHud::sample(double now, const std::vector<std::pair<int, const TerminalSession*>>& sessions) {
+    if (!renderer_ || now - lastSample_ < SAMPLE_INTERVAL) {
+        return false;
+    }
+    double elapsed = now - lastSample_;
+    bool first = lastSample_ == 0.0;
+    lastSample_ = now;
+
+    // PTY throughput per pane, and the parser's speed over all of them
+    uint64_t parsedBytes = 0;
+    double parseSeconds = 0.0;
+    paneRates_.clear();
+    std::unordered_map<int, SessionTotals> totals;
+    for (const auto& [paneId, session] : sessions) {
+        SessionTotals current{session->getBytesProcessed(), session->getParseSeconds()};
+        auto previous = sessionTotals_.find(paneId);
+        if (!first && previous != sessionTotals_.end() && current.bytes >= previous->second.bytes) {
+            uint64_t bytes = current.bytes - previous->second.bytes;
+            parsedBytes += bytes;
+            parseSeconds += current.parseSeconds - previous->second.parseSeconds;
+            paneRates_.push_back({paneId, bytes / elapsed});
+        } else {
+            paneRates_.push_back({paneId, 0.0});
+        }
+        totals[paneId] = current;
+    }
+    sessionTotals_ = std::move(totals);
+    if (parseSeconds > 0.0) {
+        parserBytesPerSecond_ = parsedBytes / parseSeconds;
+    }
+
+    if (fontRenderer_) {
+        sampleAtlas(fontRenderer_->getGlyphCacheStats(), grayAtlas_);
+        sampleAtlas(fontRenderer_->getColorGlyphCacheStats(), colorAtlas_);
+    }
+
+    // The text only changes here, so the numbers hold still long enough to read
+    lines_.clear();
+    lines_.push_back(format("frame  min %.2f  avg %.2f  p99 %.2f ms", frameStats_.getMin(), frameStats_.getAverage(), frameStats_.getP99()));
+    lines_.push_back(format("cpu    avg %.2f  p99 %.2f ms", cpuStats_.getAverage(), cpuStats_.getP99()));
+    if (renderer_->hasGpuTimings()) {
+        const RollingStats& gpu = renderer_->getGpuFrameStats();
+        lines_.push_back(format("gpu    avg %.2f  p99 %.2f ms", gpu.getAverage(), gpu.getP99()));
+        for (size_t i = 0; i < static_cast<size_t>(RenderPhase::Count); ++i) {
+            RenderPhase phase = static_cast<RenderPhase>(i);
+            const RollingStats& stats = renderer_->getPhaseStats(phase);
+            if (!stats.empty()) {
+                lines_.push_back("  " + std::string(VulkanRenderer::getRenderPhaseName(phase)) +
+                                 format("  avg %.3f  p99 %.3f ms", stats.getAverage(), stats.getP99()));
+            }
+        }
+    } else {
+        lines_.push_back("gpu    no timestamp support");
+    }
+
+    const FrameCounters& counters = renderer_->getFrameCounters();
+    lines_.push_back(format("draws %.0f  quads %.0f  pipelines %.0f", counters.drawCalls, counters.quads, counters.pipelineBinds));
+    lines_.push_back(format("descriptor sets %.0f  new %.0f", counters.descriptorSets, counters.descriptorAllocations));
+    if (fontRenderer_) {
+        GlyphCacheStats glyphs = fontRenderer_->getGlyphCacheStats();
+        lines_.push_back(format("text  hits %.1f%%  %.0f evicted", grayAtlas_.hitRate * 100.0, static_cast<double>(glyphs.evictions)));
+        lines_.push_back(format("      %.1f%% full  %.0f / %.0f pages", glyphs.occupancy * 100.0, glyphs.pages, glyphs.maxPages));
+        GlyphCacheStats color = fontRenderer_->getColorGlyphCacheStats();
+        lines_.push_back(format("color hits %.1f%%  %.0f evicted", colorAtlas_.hitRate * 100.0, static_cast<double>(color.evictions)));
+        lines_.push_back(format("      %.1f%% full  %.0f / %.0f pages", color.occupancy * 100.0, color.pages, color.maxPages));
+    }
+    MemoryStats memory = renderer_->getMemoryStats();
+    lines_.push_back(format("memory %.1f / %.1f MiB  %.0f allocations", memory.used / 1048576.0, memory.reserved / 1048576.0,
+                            static_cast<double>(memory.allocations)));
+    lines_.push_back(format("parser %.1f MB/s", parserBytesPerSecond_ / 1.0e6));
+    lines_.push_back(format("startup %.0f ms to first frame", renderer_->getFirstFrameTime()) +
+                     (renderer_->isPipelineCacheWarm() ? ", warm pipeline cache" : ", cold pipeline cache"));
+    for (size_t i = 0; i < paneRates_.size() && i < MAX_PANE_LINES; ++i) {
+        lines_.push_back(format("pane %.0f  %.1f KB/s", paneRates_[i].paneId, paneRates_[i].bytesPerSecond / 1.0e3));
+    }
+    return true;
+}
+
+void PerfHud::sampleAtlas(const GlyphCacheStats& stats, AtlasTotals& totals) {
+    uint64_t hits = stats.hits - std::min(stats.hits, totals.hits);
+    uint64_t misses = stats.misses - std::min(stats.misses, totals.misses);
+    if (hits + misses > 0) {
+        totals.hitRate = static_cast<float>(hits) / static_cast<float>(hits + misses);
+    }
+    totals.hits = stats.hits;
+    totals.misses = stats.misses;
+}
+
+void PerfHud::getBounds(float width, float& x, float& y, float& w, float& h) const {
+    float lineHeight = fontRenderer_ ? static_cast<float>(fontRenderer_->getLineHeight()) : 16.0f;
+    x = std::max(0.0f, width - WIDTH - MARGIN);
+    y = TOP;
+    w = WIDTH;
+    h = MARGIN * 3.0f + lines_.size() * lineHeight + HISTOGRAM_HEIGHT;
+}
+
+void PerfHud::render(float width, [[maybe_unused]] float height) {
+    if (!visible_ || !renderer_) return;
+
+    float x, y, w, h;
+    getBounds(width, x, y, w, h);
+    renderer_->renderQuad(x, y, w, h, VK_NULL_HANDLE, 0.0f, 0.0f, 0.0f, 0.8f);
+
+    float lineHeight = fontRenderer_ ? static_cast<float>(fontRenderer_->getLineHeight()) : 16.0f;
+    if (fontRenderer_) {
+        for (size_t i = 0; i < lines_.size(); ++i) {
+            fontRenderer_->renderString(x + MARGIN, y + MARGIN + i * lineHeight, lines_[i], 0.9f, 0.9f, 0.9f);
+        }
+    }
+
+    // One bar per frame, oldest on the left; green within 60 Hz, yellow within 30 Hz, red beyond
+    float barWidth = (w - MARGIN * 2.0f) / history_.size();
+    float baseline = y + h - MARGIN;
+    for (size_t i = 0; i < history_.size(); ++i) {
+        float ms = history_[(historyNext_ + i) % history_.size()];
+        if (ms <= 0.0f) continue;
+        float barHeight = std::min(1.0f, static_cast<float>(ms / HISTOGRAM_SCALE_MS)) * HISTOGRAM_HEIGHT;
+        float r = ms > 16.7f ? 1.0f : 0.2f;
+        float g = ms > 33.3f ? 0.2f : 0.9f;
+        renderer_->renderQuad(x + MARGIN + i * barWidth, baseline - barHeight, std::max(1.0f, barWidth - 1.0f), barHeight,
+                              VK_NULL_HANDLE, r, g, 0.2f, 1.0f);
+    }
+    // 60 Hz budget line
+    float budget = static_cast<float>(16.7 / HISTOGRAM_SCALE_MS) * HISTOGRAM_HEIGHT;
+    renderer_->renderQuad(x + MARGIN, baseline - budget, w - MARGIN * 2.0f, 1.0f, VK_NULL_HANDLE, 1.0f, 1.0f, 1.0f, 0.4f);
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "../renderer/rolling_stats.hpp"
+#include "../renderer/glyph_atlas.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Forward declarations
+class VulkanRenderer;
+class FontRenderer;
+class TerminalSession;
+
+// Performance overlay in the top right corner, toggled with F12. Frame
+// times are recorded all the time so the histogram has history when the
+// overlay opens; everything else is only gathered while it is visible.
+class PerfHud {
+public:
+    PerfHud();
+
+    void setRenderer(VulkanRenderer* renderer);
+    void setFontRenderer(FontRenderer* fontRenderer);
+
+    void toggle() { visible_ = !visible_; }
+    bool isVisible() const { return visible_; }
+
+    // Once per drawn frame: time since the previous frame and the CPU time spent building it
+    void recordFrame(double frameMs, double cpuMs);
+
+    // Throughput is sampled from the sessions' totals a few times a second;
+    // returns whether new figures are due, i.e. the overlay should be redrawn
+    bool sample(double now, const std::vector<std::pair<int, const TerminalSession*>>& sessions);
+
+    // Screen area the overlay covers, for damage
+    void getBounds(float width, float& x, float& y, float& w, float& h) const;
+    void render(float width, float height);
+
+private:
+    struct PaneRate {
+        int paneId;
+        double bytesPerSecond;
+    };
+
+    struct SessionTotals {
+        uint64_t bytes = 0;
+        double parseSeconds = 0.0;
+    };
+    
+    struct AtlasTotals {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        float hitRate = 1.0f; // Over the last sample interval
+    };
+
+    VulkanRenderer* renderer_ = nullptr;
+    FontRenderer* fontRenderer_ = nullptr;
+    bool visible_ = false;
+
+    RollingStats frameStats_;
+    RollingStats cpuStats_;
+    std::array<float, 120> history_{}; // Frame times for the histogram, oldest at historyNext_
+    size_t historyNext_ = 0;
+
+    double lastSample_ = 0.0;
+    std::unordered_map<int, SessionTotals> sessionTotals_; // By pane id, as of the last sample
+    std::vector<PaneRate> paneRates_;
+    double parserBytesPerSecond_ = 0.0; // While parsing, i.e. parser throughput
+    AtlasTotals grayAtlas_;  // Text glyphs
+    AtlasTotals colorAtlas_; // Color glyphs (emoji)
+
+    std::vector<std::string> lines_; // Rebuilt by sample()
+    
+    static void sampleAtlas(const GlyphCacheStats& stats, AtlasTotals& totals);
+
+    static constexpr float WIDTH = 320.0f;
+    static constexpr float TOP = 40.0f;            // Clear of the menu bar
+    static constexpr float MARGIN = 10.0f;
+    static constexpr float HISTOGRAM_HEIGHT = 48.0f;
+    static constexpr double HISTOGRAM_SCALE_MS = 33.3; // Bars this tall reach the top
+    static constexpr double SAMPLE_INTERVAL = 0.25;    // Seconds
+    static constexpr size_t MAX_PANE_LINES = 4;
+};
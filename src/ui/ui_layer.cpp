@@ -0,0 +1,39 @@
+#include "ui_layer.hpp"
+#include "../renderer/font_renderer.hpp"
+
+UiLayer::UiLayer(VulkanRenderer* renderer, FontRenderer* fontRenderer)
+    : renderer_(renderer), fontRenderer_(fontRenderer), list_(renderer->createDrawList()) {
+}
+
+UiLayer::~UiLayer() {
+    renderer_->destroyDrawList(list_);
+}
+
+void UiLayer::draw(const std::string& key, const std::function<void()>& record) {
+    uint32_t width = renderer_->getWidth();
+    uint32_t height = renderer_->getHeight();
+    uint64_t glyphGeneration = fontRenderer_ ? fontRenderer_->getGlyphGeneration() : 0;
+    if (!recorded_ || key != key_ || width != width_ || height != height_ || glyphGeneration != glyphGeneration_) {
+        if (missingGlyphs_) {
+            // Nothing else need change for the placeholders to be replaced on screen
+            renderer_->damageAll();
+        }
+        uint64_t placeholders = fontRenderer_ ? fontRenderer_->getPlaceholderCount() : 0;
+        renderer_->beginRecording(list_);
+        record();
+        renderer_->endRecording();
+        textures_ = renderer_->getDrawListTextures(list_);
+        missingGlyphs_ = fontRenderer_ && fontRenderer_->getPlaceholderCount() != placeholders;
+        recorded_ = !missingGlyphs_; // Recorded again next frame
+        key_ = key;
+        width_ = width;
+        height_ = height;
+        glyphGeneration_ = glyphGeneration;
+    }
+    
+    // The copied glyphs bypass the font renderer, which would otherwise let their pages go
+    if (fontRenderer_) {
+        fontRenderer_->touchPages(textures_);
+    }
+    renderer_->drawList(list_);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "../renderer/vulkan_renderer.hpp"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+class FontRenderer;
+
+// A piece of UI kept as a recorded draw list and drawn each frame by copying
+// it, rather than by laying out its quads and text again. It is recorded anew
+// only when its key, the window size or the font renderer's glyphs change, or
+// the frame after it was recorded with placeholder glyphs, so the key must
+// cover everything else the drawing depends on.
+class UiLayer {
+public:
+    UiLayer(VulkanRenderer* renderer, FontRenderer* fontRenderer);
+    ~UiLayer();
+    UiLayer(const UiLayer&) = delete;
+    UiLayer& operator=(const UiLayer&) = delete;
+
+    // Draws the layer, calling record() to redraw it first if it is out of date
+    void draw(const std::string& key, const std::function<void()>& record);
+
+private:
+    VulkanRenderer* renderer_;
+    FontRenderer* fontRenderer_;
+    uint32_t list_;
+    bool recorded_ = false;
+    bool missingGlyphs_ = false; // Recorded with placeholders
+    std::string key_;
+    uint32_t width_ = 0;
+    uint32_t height_ = 0;
+    uint64_t glyphGeneration_ = 0;
+    std::vector<VkImageView> textures_; // Atlas pages among them are kept from eviction
+};
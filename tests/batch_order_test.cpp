@@ -0,0 +1,35 @@
+#include <gtest/gtest.h>
+#include "renderer/batch_order.hpp"
+
+TEST(BatchOrderTest, GroupsStatesAcrossDisjointBatches) {
+    // Cell backgrounds and glyphs alternating along a row, each in its own cell
+    std::vector<BatchBounds> batches = {
+        {0, 0, 0, 0, 10, 10},  // Solid
+        {1, 0, 10, 0, 20, 10}, // Glyph
+        {0, 0, 20, 0, 30, 10},
+        {1, 0, 30, 0, 40, 10},
+    };
+    std::vector<uint32_t> order = orderBatches(batches);
+    EXPECT_EQ(order, (std::vector<uint32_t>{0, 2, 1, 3}));
+}
+
+TEST(BatchOrderTest, KeepsOverlapsAndGroupsInOrder) {
+    std::vector<BatchBounds> batches = {
+        {0, 0, 0, 0, 10, 10},
+        {1, 0, 0, 0, 10, 10}, // Drawn over the first
+        {0, 0, 5, 5, 15, 15}, // Must stay over the second
+        {1, 1, 20, 0, 30, 10}, // Next group
+        {0, 1, 40, 0, 50, 10},
+    };
+    std::vector<uint32_t> order = orderBatches(batches);
+    EXPECT_EQ(order, (std::vector<uint32_t>{0, 1, 2, 3, 4}));
+
+    // The last batch only touches the one before it, so it may join the other glyph
+    std::vector<BatchBounds> touching = {
+        {0, 0, 0, 0, 10, 10},
+        {1, 0, 10, 0, 20, 10},
+        {0, 0, 10, 0, 20, 10}, // Covers the glyph exactly
+        {1, 0, 20, 0, 30, 10},
+    };
+    EXPECT_EQ(orderBatches(touching), (std::vector<uint32_t>{0, 1, 3, 2}));
+}
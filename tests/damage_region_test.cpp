@@ -0,0 +1,67 @@
+#include <gtest/gtest.h>
+#include "renderer/damage_region.hpp"
+
+TEST(DamageRegionTest, ClampsAndMergesOverlappingRects) {
+    DamageRegion region;
+    region.setBounds(100, 50);
+
+    region.add(-10, -10, 20, 20);
+    region.add(90, 40, 50, 50);
+    region.add(200, 0, 10, 10); // Off surface
+    ASSERT_EQ(region.getRects().size(), 2u);
+    EXPECT_FALSE(region.isFull());
+
+    // Bridges both rects into one
+    region.add(5, 5, 90, 40);
+    ASSERT_EQ(region.getRects().size(), 1u);
+    DamageRect rect = region.getRects()[0];
+    EXPECT_EQ(rect.x, 0);
+    EXPECT_EQ(rect.y, 0);
+    EXPECT_EQ(rect.width, 100);
+    EXPECT_EQ(rect.height, 50);
+    EXPECT_TRUE(region.isFull());
+}
+
+TEST(DamageRegionTest, KeepsDisjointRectsAndCollapsesPastLimit) {
+    DamageRegion region(3);
+    region.setBounds(100, 100);
+
+    region.add(0, 0, 10, 10);
+    region.add(10, 0, 10, 10); // Touching, not overlapping
+    region.add(0, 50, 10, 10);
+    EXPECT_EQ(region.getRects().size(), 3u);
+    EXPECT_TRUE(region.intersects(12.0f, 2.0f, 14.0f, 4.0f));
+    EXPECT_FALSE(region.intersects(30.0f, 30.0f, 40.0f, 40.0f));
+
+    region.add(80, 80, 10, 10);
+    ASSERT_EQ(region.getRects().size(), 1u);
+    DamageRect bounds = region.getBounds();
+    EXPECT_EQ(bounds.x, 0);
+    EXPECT_EQ(bounds.y, 0);
+    EXPECT_EQ(bounds.width, 90);
+    EXPECT_EQ(bounds.height, 90);
+    EXPECT_TRUE(region.intersects(30.0f, 30.0f, 40.0f, 40.0f));
+}
+
+TEST(DamageRegionTest, AddAllAndUnion) {
+    DamageRegion frame;
+    frame.setBounds(64, 64);
+    DamageRegion image;
+    image.setBounds(64, 64);
+
+    EXPECT_TRUE(frame.empty());
+    frame.add(4, 4, 8, 8);
+    image.add(frame);
+    EXPECT_EQ(image.getRects().size(), 1u);
+
+    frame.addAll();
+    EXPECT_TRUE(frame.isFull());
+    image.add(frame);
+    EXPECT_TRUE(image.isFull());
+    image.add(1, 1, 2, 2);
+    EXPECT_EQ(image.getRects().size(), 1u);
+
+    image.clear();
+    EXPECT_TRUE(image.empty());
+    EXPECT_FALSE(image.isFull());
+}
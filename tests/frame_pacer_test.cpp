@@ -0,0 +1,23 @@
+#include <gtest/gtest.h>
+#include "renderer/frame_pacer.hpp"
+
+TEST(FramePacerTest, LatchesMarginBeforeNextVblank) {
+    FramePacer pacer(0.010, 0.002);
+    pacer.setVblank(1.000);
+
+    // Vblanks at 1.000, 1.010, 1.020...; the frame starts 2 ms before one
+    EXPECT_NEAR(pacer.getLatchTime(1.001), 1.008, 1e-9);
+    EXPECT_NEAR(pacer.getLatchTime(1.008), 1.008, 1e-9);
+
+    // Too late for 1.010: wait for the one after
+    EXPECT_NEAR(pacer.getLatchTime(1.0085), 1.018, 1e-9);
+
+    // The known vblank may lie many periods back
+    EXPECT_NEAR(pacer.getLatchTime(2.0031), 2.008, 1e-9);
+}
+
+TEST(FramePacerTest, StartsAtOnceWithoutVblank) {
+    FramePacer pacer(0.010, 0.002);
+    EXPECT_FALSE(pacer.hasVblank());
+    EXPECT_EQ(pacer.getLatchTime(5.0), 5.0);
+}
@@ -0,0 +1,193 @@
+#include <gtest/gtest.h>
+#include "renderer/glyph_atlas.hpp"
+#include "renderer/atlas_cache.hpp"
+#include <cstdio>
+#include <string>
+
+TEST(SkylinePackerTest, PackedRectsDoNotOverlap) {
+    SkylinePacker packer(64, 64);
+    struct Rect { uint32_t x, y, w, h; };
+    std::vector<Rect> rects;
+    uint32_t sizes[][2] = {{10, 12}, {7, 20}, {30, 5}, {12, 12}, {25, 9}, {3, 3}, {16, 16}};
+    for (auto& size : sizes) {
+        uint32_t x, y;
+        ASSERT_TRUE(packer.pack(size[0], size[1], x, y));
+        ASSERT_LE(x + size[0], 64u);
+        ASSERT_LE(y + size[1], 64u);
+        rects.push_back({x, y, size[0], size[1]});
+    }
+    for (size_t i = 0; i < rects.size(); ++i) {
+        for (size_t j = i + 1; j < rects.size(); ++j) {
+            const Rect& a = rects[i];
+            const Rect& b = rects[j];
+            bool separate = a.x + a.w <= b.x || b.x + b.w <= a.x || a.y + a.h <= b.y || b.y + b.h <= a.y;
+            ASSERT_TRUE(separate) << "rects " << i << " and " << j << " overlap";
+        }
+    }
+}
+
+TEST(SkylinePackerTest, RejectsWhenFullAndRecoversAfterReset) {
+    SkylinePacker packer(16, 16);
+    uint32_t x, y;
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_TRUE(packer.pack(8, 8, x, y));
+    }
+    ASSERT_FALSE(packer.pack(8, 8, x, y));
+    ASSERT_EQ(packer.getUsedArea(), 256u);
+
+    packer.reset();
+    ASSERT_EQ(packer.getUsedArea(), 0u);
+    ASSERT_TRUE(packer.pack(16, 16, x, y));
+}
+
+TEST(GlyphAtlasTest, OpensNewPagesUntilLimit) {
+    GlyphAtlas atlas(16, 2, 2);
+    AtlasRegion region;
+    std::vector<uint64_t> evicted;
+    ASSERT_TRUE(atlas.allocate(1, 16, 16, region, evicted));
+    ASSERT_EQ(region.page, 0u);
+    ASSERT_TRUE(atlas.allocate(2, 16, 16, region, evicted));
+    ASSERT_EQ(region.page, 1u);
+    ASSERT_EQ(atlas.getPageCount(), 2u);
+    ASSERT_TRUE(evicted.empty());
+}
+
+TEST(GlyphAtlasTest, EvictsLeastRecentlyUsedPage) {
+    GlyphAtlas atlas(16, 2, 2);
+    AtlasRegion region;
+    std::vector<uint64_t> evicted;
+    ASSERT_TRUE(atlas.allocate(1, 16, 16, region, evicted)); // page 0
+    ASSERT_TRUE(atlas.allocate(2, 16, 16, region, evicted)); // page 1
+
+    for (int i = 0; i < 5; ++i) {
+        atlas.beginFrame();
+        atlas.touch(1); // Keep page 1 hot
+    }
+
+    ASSERT_TRUE(atlas.allocate(3, 16, 16, region, evicted));
+    ASSERT_EQ(region.page, 0u);
+    ASSERT_EQ(evicted.size(), 1u);
+    ASSERT_EQ(evicted[0], 1u);
+    ASSERT_EQ(atlas.getStats().evictions, 1u);
+}
+
+TEST(GlyphAtlasTest, NeverEvictsPagesInFlight) {
+    GlyphAtlas atlas(16, 1, 2);
+    AtlasRegion region;
+    std::vector<uint64_t> evicted;
+    ASSERT_TRUE(atlas.allocate(1, 16, 16, region, evicted));
+    atlas.beginFrame();
+    atlas.touch(0);
+    ASSERT_FALSE(atlas.allocate(2, 16, 16, region, evicted));
+    ASSERT_TRUE(evicted.empty());
+}
+
+TEST(GlyphAtlasTest, PlacesGlyphOnceFramesRetire) {
+    GlyphAtlas atlas(16, 1, 2);
+    AtlasRegion region;
+    std::vector<uint64_t> evicted;
+    ASSERT_TRUE(atlas.allocate(1, 16, 16, region, evicted));
+    atlas.beginFrame();
+    atlas.touch(0);
+    ASSERT_FALSE(atlas.allocate(2, 16, 16, region, evicted));
+
+    // FontRenderer retries a deferred glyph every frame until it gets a page
+    int frames = 0;
+    bool allocated = false;
+    while (!allocated && frames < 10) {
+        atlas.beginFrame();
+        frames++;
+        allocated = atlas.allocate(2, 16, 16, region, evicted);
+    }
+    ASSERT_TRUE(allocated);
+    EXPECT_EQ(frames, 3); // The touching frame plus the two safe frames
+    EXPECT_EQ(region.page, 0u);
+    ASSERT_EQ(evicted.size(), 1u);
+    EXPECT_EQ(evicted[0], 1u);
+}
+
+TEST(GlyphAtlasTest, ReportsOccupancyAndCounters) {
+    GlyphAtlas atlas(16, 4, 2);
+    AtlasRegion region;
+    std::vector<uint64_t> evicted;
+    ASSERT_TRUE(atlas.allocate(1, 8, 8, region, evicted));
+    atlas.recordHit();
+    atlas.recordHit();
+    atlas.recordMiss();
+
+    GlyphCacheStats stats = atlas.getStats();
+    ASSERT_EQ(stats.hits, 2u);
+    ASSERT_EQ(stats.misses, 1u);
+    ASSERT_EQ(stats.pages, 1u);
+    ASSERT_FLOAT_EQ(stats.occupancy, 0.25f);
+}
+
+TEST(GlyphAtlasTest, SaveAndLoadRestoresPackingState) {
+    GlyphAtlas original(64, 4, 2);
+    AtlasRegion region;
+    std::vector<uint64_t> evicted;
+    for (uint64_t key = 0; key < 20; ++key) {
+        ASSERT_TRUE(original.allocate(key, 10 + key % 7, 12, region, evicted));
+    }
+
+    ByteWriter writer;
+    original.save(writer);
+
+    GlyphAtlas restored(64, 4, 2);
+    ByteReader reader(writer.getBytes().data(), writer.getBytes().size());
+    ASSERT_TRUE(restored.load(reader));
+    ASSERT_EQ(restored.getPageCount(), original.getPageCount());
+    ASSERT_FLOAT_EQ(restored.getStats().occupancy, original.getStats().occupancy);
+
+    // Both atlases must place the next glyph at the same spot
+    AtlasRegion expected, actual;
+    ASSERT_TRUE(original.allocate(100, 9, 9, expected, evicted));
+    ASSERT_TRUE(restored.allocate(100, 9, 9, actual, evicted));
+    ASSERT_EQ(actual.page, expected.page);
+    ASSERT_EQ(actual.x, expected.x);
+    ASSERT_EQ(actual.y, expected.y);
+}
+
+TEST(GlyphAtlasTest, LoadRejectsTruncatedOrMismatchedData) {
+    GlyphAtlas original(64, 4, 2);
+    AtlasRegion region;
+    std::vector<uint64_t> evicted;
+    ASSERT_TRUE(original.allocate(1, 8, 8, region, evicted));
+
+    ByteWriter writer;
+    original.save(writer);
+    const std::vector<uint8_t>& bytes = writer.getBytes();
+
+    GlyphAtlas truncated(64, 4, 2);
+    ByteReader shortReader(bytes.data(), bytes.size() - 1);
+    ASSERT_FALSE(truncated.load(shortReader));
+    ASSERT_EQ(truncated.getPageCount(), 0u);
+
+    GlyphAtlas otherSize(128, 4, 2);
+    ByteReader reader(bytes.data(), bytes.size());
+    ASSERT_FALSE(otherSize.load(reader));
+}
+
+TEST(AtlasCachePathTest, FollowsFontFileAndOptions) {
+    std::string fontPath = testing::TempDir() + "atlas_cache_font.ttf";
+    FILE* file = fopen(fontPath.c_str(), "wb");
+    ASSERT_NE(file, nullptr);
+    fputs("font", file);
+    fclose(file);
+
+    std::string path = getAtlasCachePath({fontPath}, 16, 0);
+    ASSERT_FALSE(path.empty());
+    EXPECT_EQ(getAtlasCachePath({fontPath}, 16, 0), path);
+    EXPECT_NE(getAtlasCachePath({fontPath}, 17, 0), path);
+    EXPECT_NE(getAtlasCachePath({fontPath}, 16, 1), path);
+
+    // A font replaced by a different file gets a new cache
+    file = fopen(fontPath.c_str(), "wb");
+    ASSERT_NE(file, nullptr);
+    fputs("other font", file);
+    fclose(file);
+    EXPECT_NE(getAtlasCachePath({fontPath}, 16, 0), path);
+
+    remove(fontPath.c_str());
+    EXPECT_TRUE(getAtlasCachePath({fontPath}, 16, 0).empty());
+}
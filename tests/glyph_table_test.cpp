@@ -0,0 +1,64 @@
+#include <gtest/gtest.h>
+#include "renderer/glyph_table.hpp"
+#include <vector>
+
+TEST(GlyphTableTest, FindsEntriesAcrossAllRanges) {
+    GlyphTable<int> table;
+    char32_t codepoints[] = {U'A', U'é', U'─', U'�', U'\U0001F600'};
+    for (size_t i = 0; i < 5; ++i) {
+        table.insert(codepoints[i], static_cast<int>(i) + 1);
+    }
+    EXPECT_EQ(table.size(), 5u);
+    for (size_t i = 0; i < 5; ++i) {
+        const int* value = table.find(codepoints[i]);
+        ASSERT_NE(value, nullptr);
+        EXPECT_EQ(*value, static_cast<int>(i) + 1);
+    }
+    EXPECT_EQ(table.find(U'B'), nullptr);
+    EXPECT_EQ(table.find(U'━'), nullptr);  // Allocated block, empty slot
+    EXPECT_EQ(table.find(U'一'), nullptr);  // Unallocated block
+    EXPECT_EQ(table.find(U'\U0001F601'), nullptr);
+}
+
+TEST(GlyphTableTest, OverwriteAndEraseKeepSizeConsistent) {
+    GlyphTable<int> table;
+    table.insert(U'x', 1);
+    table.insert(U'x', 2);
+    table.insert(U'\U0001F600', 3);
+    table.insert(U'\U0001F600', 4);
+    EXPECT_EQ(table.size(), 2u);
+    EXPECT_EQ(*table.find(U'x'), 2);
+    EXPECT_EQ(*table.find(U'\U0001F600'), 4);
+
+    table.erase(U'x');
+    table.erase(U'x');
+    table.erase(U'\U0001F600');
+    table.erase(U'一');
+    EXPECT_EQ(table.size(), 0u);
+    EXPECT_EQ(table.find(U'x'), nullptr);
+    EXPECT_EQ(table.find(U'\U0001F600'), nullptr);
+}
+
+TEST(GlyphTableTest, ClearAndForEach) {
+    GlyphTable<int> table;
+    table.insert(U'\U0001F600', 3);
+    table.insert(U'─', 2);
+    table.insert(U'a', 1);
+
+    std::vector<char32_t> visited;
+    table.forEach([&](char32_t codepoint, int value) {
+        visited.push_back(codepoint);
+        EXPECT_EQ(*table.find(codepoint), value);
+    });
+    ASSERT_EQ(visited.size(), 3u);
+    EXPECT_EQ(visited[0], U'a');
+    EXPECT_EQ(visited[1], U'─');
+    EXPECT_EQ(visited[2], U'\U0001F600');
+
+    table.clear();
+    EXPECT_EQ(table.size(), 0u);
+    EXPECT_EQ(table.find(U'a'), nullptr);
+    EXPECT_EQ(table.find(U'─'), nullptr);
+    table.insert(U'a', 5);
+    EXPECT_EQ(*table.find(U'a'), 5);
+}
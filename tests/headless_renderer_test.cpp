@@ -0,0 +1,295 @@
+#include <gtest/gtest.h>
+#include "renderer/vulkan_renderer.hpp"
+#include <cstdlib>
+#include <exception>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+    // Needs a Vulkan implementation, but no display; lavapipe will do.
+    // Without one the tests skip, unless HYPERTERM_REQUIRE_VULKAN is set (as in CI).
+    std::unique_ptr<VulkanRenderer> createHeadless(uint32_t width, uint32_t height) {
+        auto renderer = std::make_unique<VulkanRenderer>(width, height);
+        try {
+            renderer->init();
+        } catch (const std::exception& e) {
+            const char* required = std::getenv("HYPERTERM_REQUIRE_VULKAN");
+            if (required && *required && std::string(required) != "0") {
+                ADD_FAILURE() << "HYPERTERM_REQUIRE_VULKAN is set, but Vulkan failed: " << e.what();
+            }
+            return nullptr;
+        }
+        return renderer;
+    }
+
+    void expectPixel(const std::vector<uint8_t>& pixels, uint32_t width, uint32_t x, uint32_t y,
+                     uint8_t r, uint8_t g, uint8_t b) {
+        const uint8_t* pixel = &pixels[(y * width + x) * 4];
+        EXPECT_EQ(pixel[0], r) << "at " << x << "," << y;
+        EXPECT_EQ(pixel[1], g) << "at " << x << "," << y;
+        EXPECT_EQ(pixel[2], b) << "at " << x << "," << y;
+        EXPECT_EQ(pixel[3], 255) << "at " << x << "," << y;
+    }
+}
+
+TEST(HeadlessRendererTest, CapturesRenderedFrame) {
+    auto renderer = createHeadless(64, 32);
+    if (!renderer) {
+        GTEST_SKIP() << "No Vulkan device available";
+    }
+    ASSERT_TRUE(renderer->isHeadless());
+    ASSERT_EQ(renderer->getWidth(), 64u);
+    ASSERT_EQ(renderer->getHeight(), 32u);
+
+    renderer->beginFrame();
+    renderer->damageAll();
+    renderer->renderQuad(0.0f, 0.0f, 32.0f, 32.0f, VK_NULL_HANDLE, 1.0f, 0.0f, 0.0f);
+    renderer->renderQuad(32.0f, 0.0f, 32.0f, 32.0f, VK_NULL_HANDLE, 0.0f, 0.0f, 1.0f);
+    renderer->requestCapture();
+    renderer->endFrame();
+
+    std::vector<uint8_t> pixels;
+    ASSERT_TRUE(renderer->readCapture(pixels));
+    ASSERT_EQ(pixels.size(), 64u * 32u * 4u);
+    expectPixel(pixels, 64, 4, 4, 255, 0, 0);
+    expectPixel(pixels, 64, 31, 31, 255, 0, 0);
+    expectPixel(pixels, 64, 32, 0, 0, 0, 255);
+    expectPixel(pixels, 64, 60, 28, 0, 0, 255);
+
+    // Nothing is captured unless asked for
+    EXPECT_FALSE(renderer->readCapture(pixels));
+    renderer->cleanup();
+}
+
+TEST(HeadlessRendererTest, KeepsUndamagedPixels) {
+    auto renderer = createHeadless(64, 32);
+    if (!renderer) {
+        GTEST_SKIP() << "No Vulkan device available";
+    }
+
+    renderer->beginFrame();
+    renderer->damageAll();
+    renderer->renderQuad(0.0f, 0.0f, 64.0f, 32.0f, VK_NULL_HANDLE, 0.0f, 0.0f, 1.0f);
+    renderer->endFrame();
+
+    // Only the left half is redrawn; the quad is clipped to the damage
+    renderer->beginFrame();
+    renderer->addDamage(0.0f, 0.0f, 32.0f, 32.0f);
+    renderer->renderQuad(0.0f, 0.0f, 64.0f, 32.0f, VK_NULL_HANDLE, 0.0f, 1.0f, 0.0f);
+    renderer->requestCapture();
+    renderer->endFrame();
+
+    std::vector<uint8_t> pixels;
+    ASSERT_TRUE(renderer->readCapture(pixels));
+    expectPixel(pixels, 64, 8, 16, 0, 255, 0);
+    expectPixel(pixels, 64, 48, 16, 0, 0, 255);
+    renderer->cleanup();
+}
+
+TEST(HeadlessRendererTest, KeepsUndamagedRows) {
+    auto renderer = createHeadless(64, 32);
+    if (!renderer) {
+        GTEST_SKIP() << "No Vulkan device available";
+    }
+
+    renderer->beginFrame();
+    renderer->damageAll();
+    renderer->renderQuad(0.0f, 0.0f, 64.0f, 32.0f, VK_NULL_HANDLE, 0.0f, 0.0f, 1.0f);
+    renderer->endFrame();
+
+    // Only a strip along the top is redrawn; rows are counted from the top
+    // alike by the shaders and by damage, so the bottom keeps its pixels
+    renderer->beginFrame();
+    renderer->addDamage(0.0f, 0.0f, 64.0f, 8.0f);
+    renderer->renderQuad(0.0f, 0.0f, 64.0f, 4.0f, VK_NULL_HANDLE, 0.0f, 1.0f, 0.0f);
+    renderer->renderQuad(0.0f, 4.0f, 64.0f, 28.0f, VK_NULL_HANDLE, 1.0f, 0.0f, 0.0f);
+    renderer->requestCapture();
+    renderer->endFrame();
+
+    std::vector<uint8_t> pixels;
+    ASSERT_TRUE(renderer->readCapture(pixels));
+    expectPixel(pixels, 64, 8, 1, 0, 255, 0);
+    expectPixel(pixels, 64, 8, 6, 255, 0, 0);
+    expectPixel(pixels, 64, 8, 8, 0, 0, 255);
+    expectPixel(pixels, 64, 8, 30, 0, 0, 255);
+    renderer->cleanup();
+}
+
+TEST(HeadlessRendererTest, DrawsGlyphInstances) {
+    auto renderer = createHeadless(64, 32);
+    if (!renderer) {
+        GTEST_SKIP() << "No Vulkan device available";
+    }
+
+    // Full coverage, so the glyph is a solid block in its color
+    std::vector<uint8_t> coverage(4 * 4, 255);
+    VkImage image = VK_NULL_HANDLE;
+    MemoryAllocation memory;
+    VkImageView view = VK_NULL_HANDLE;
+    renderer->createTexture(4, 4, coverage.data(), image, memory, view, VK_FORMAT_R8_UNORM);
+
+    // An 8x8 quad sitting on the pen's baseline
+    renderer->setGlyphSlot(0, {0.0f, 0.0f, 1.0f, 1.0f, 0.0f, -8.0f, 8.0f, 8.0f});
+
+    renderer->beginFrame();
+    renderer->damageAll();
+    renderer->renderGlyph(16.0f, 16.0f, 0, view, packColor(0x00FF00u));
+    renderer->renderGlyph(40.4f, 24.0f, 0, view, packColor(1.0f, 0.0f, 0.0f));
+    renderer->requestCapture();
+    renderer->endFrame();
+
+    std::vector<uint8_t> pixels;
+    ASSERT_TRUE(renderer->readCapture(pixels));
+    expectPixel(pixels, 64, 16, 8, 0, 255, 0);
+    expectPixel(pixels, 64, 23, 15, 0, 255, 0);
+    expectPixel(pixels, 64, 24, 15, 0, 0, 0);
+    expectPixel(pixels, 64, 40, 16, 255, 0, 0);
+    expectPixel(pixels, 64, 47, 23, 255, 0, 0);
+    expectPixel(pixels, 64, 20, 20, 0, 0, 0);
+
+    renderer->destroyTexture(image, memory, view);
+    renderer->cleanup();
+}
+
+TEST(HeadlessRendererTest, DrawsGridHighlights) {
+    auto renderer = createHeadless(32, 16);
+    if (!renderer) {
+        GTEST_SKIP() << "No Vulkan device available";
+    }
+    RenderTarget target;
+    renderer->createRenderTarget(32, 16, target);
+
+    // A 4x2 grid of 8x8 cells, black but for a red cell at (1, 0)
+    GridState grid;
+    grid.cellWidth = 8.0f;
+    grid.cellHeight = 8.0f;
+    grid.selectionStart[0] = 1; // Just cell (1, 0)
+    grid.selectionEnd[0] = 2;
+    grid.cursor[0] = 3;
+    grid.cursor[1] = 1;
+    grid.cursorShape = CursorShape::Block;
+    grid.cursorAlpha = 1.0f;
+
+    renderer->beginFrame();
+    renderer->damageAll();
+    renderer->beginTarget(target);
+    renderer->renderQuad(8.0f, 0.0f, 8.0f, 8.0f, VK_NULL_HANDLE, 1.0f, 0.0f, 0.0f);
+    renderer->endTarget();
+    renderer->renderGrid(0.0f, 0.0f, 32.0f, 16.0f, target.view, grid);
+    renderer->requestCapture();
+    renderer->endFrame();
+
+    std::vector<uint8_t> pixels;
+    ASSERT_TRUE(renderer->readCapture(pixels));
+    expectPixel(pixels, 32, 12, 4, 0, 255, 255);    // Selected, inverted
+    expectPixel(pixels, 32, 20, 4, 0, 0, 0);        // Past the selection's end
+    expectPixel(pixels, 32, 28, 12, 255, 255, 255); // Block cursor
+    expectPixel(pixels, 32, 4, 12, 0, 0, 0);
+
+    // Blinked off: the same image, drawn without the cursor
+    grid.cursorAlpha = 0.0f;
+    renderer->beginFrame();
+    renderer->damageAll();
+    renderer->renderGrid(0.0f, 0.0f, 32.0f, 16.0f, target.view, grid);
+    renderer->requestCapture();
+    renderer->endFrame();
+
+    ASSERT_TRUE(renderer->readCapture(pixels));
+    expectPixel(pixels, 32, 12, 4, 0, 255, 255);
+    expectPixel(pixels, 32, 28, 12, 0, 0, 0);
+
+    renderer->destroyRenderTarget(target);
+    renderer->cleanup();
+}
+
+TEST(HeadlessRendererTest, DrawsGridHighlightsBelowAnOffset) {
+    auto renderer = createHeadless(32, 32);
+    if (!renderer) {
+        GTEST_SKIP() << "No Vulkan device available";
+    }
+    RenderTarget target;
+    renderer->createRenderTarget(32, 16, target);
+
+    // The same grid composited 12 pixels down, as panes sit below the menu bar
+    GridState grid;
+    grid.cellWidth = 8.0f;
+    grid.cellHeight = 8.0f;
+    grid.originY = 12.0f;
+    grid.selectionStart[0] = 1;
+    grid.selectionEnd[0] = 2;
+    grid.cursor[0] = 3;
+    grid.cursor[1] = 1;
+    grid.cursorShape = CursorShape::Block;
+    grid.cursorAlpha = 1.0f;
+
+    renderer->beginFrame();
+    renderer->damageAll();
+    renderer->beginTarget(target);
+    renderer->renderQuad(8.0f, 0.0f, 8.0f, 8.0f, VK_NULL_HANDLE, 1.0f, 0.0f, 0.0f);
+    renderer->endTarget();
+    renderer->renderGrid(0.0f, 12.0f, 32.0f, 16.0f, target.view, grid);
+    renderer->requestCapture();
+    renderer->endFrame();
+
+    std::vector<uint8_t> pixels;
+    ASSERT_TRUE(renderer->readCapture(pixels));
+    expectPixel(pixels, 32, 12, 4, 0, 0, 0);          // Above the grid
+    expectPixel(pixels, 32, 12, 13, 0, 255, 255);     // First row of cell (1, 0)
+    expectPixel(pixels, 32, 12, 19, 0, 255, 255);     // Last row of cell (1, 0)
+    expectPixel(pixels, 32, 12, 21, 0, 0, 0);         // Cell (1, 1)
+    expectPixel(pixels, 32, 28, 21, 255, 255, 255);   // Block cursor at (3, 1)
+    expectPixel(pixels, 32, 28, 18, 0, 0, 0);         // Cell (3, 0)
+    expectPixel(pixels, 32, 28, 30, 0, 0, 0);         // Below the grid
+
+    renderer->destroyRenderTarget(target);
+    renderer->cleanup();
+}
+
+TEST(HeadlessRendererTest, ReplaysDrawLists) {
+    auto renderer = createHeadless(64, 32);
+    if (!renderer) {
+        GTEST_SKIP() << "No Vulkan device available";
+    }
+    uint32_t list = renderer->createDrawList();
+
+    // Recording keeps the quads out of the frame they were made in
+    renderer->beginFrame();
+    renderer->damageAll();
+    renderer->renderQuad(0.0f, 0.0f, 64.0f, 32.0f, VK_NULL_HANDLE, 0.0f, 0.0f, 1.0f);
+    renderer->beginRecording(list);
+    renderer->renderQuad(0.0f, 0.0f, 32.0f, 32.0f, VK_NULL_HANDLE, 1.0f, 0.0f, 0.0f);
+    renderer->endRecording();
+    renderer->renderQuad(48.0f, 0.0f, 16.0f, 32.0f, VK_NULL_HANDLE, 0.0f, 1.0f, 0.0f);
+    renderer->requestCapture();
+    renderer->endFrame();
+
+    std::vector<uint8_t> pixels;
+    ASSERT_TRUE(renderer->readCapture(pixels));
+    expectPixel(pixels, 64, 8, 16, 0, 0, 255);
+    expectPixel(pixels, 64, 56, 16, 0, 255, 0);
+
+    // Later frames draw the list without making the quads again
+    for (int frame = 0; frame < 2; ++frame) {
+        renderer->beginFrame();
+        renderer->damageAll();
+        renderer->renderQuad(0.0f, 0.0f, 64.0f, 32.0f, VK_NULL_HANDLE, 0.0f, 0.0f, 1.0f);
+        renderer->drawList(list);
+        renderer->requestCapture();
+        renderer->endFrame();
+
+        ASSERT_TRUE(renderer->readCapture(pixels));
+        expectPixel(pixels, 64, 8, 16, 255, 0, 0);
+        expectPixel(pixels, 64, 40, 16, 0, 0, 255);
+    }
+
+    renderer->destroyDrawList(list);
+    renderer->cleanup();
+}
+
+TEST(HeadlessRendererTest, PacksColorsRedFirst) {
+    EXPECT_EQ(packColor(0x112233u), 0xFF332211u);
+    EXPECT_EQ(packColor(0x112233u, 0x80u), 0x80332211u);
+    EXPECT_EQ(packColor(1.0f, 0.0f, 0.0f), 0xFF0000FFu);
+    EXPECT_EQ(packColor(0.0f, 0.0f, 1.0f, 0.0f), 0x00FF0000u);
+}
@@ -0,0 +1,55 @@
+#include <gtest/gtest.h>
+#include "renderer/image_loader.hpp"
+#include "renderer/image_cache.hpp"
+
+namespace {
+    ImageData solidImage(uint32_t width, uint32_t height, uint8_t value) {
+        ImageData image;
+        image.width = width;
+        image.height = height;
+        image.channels = 4;
+        image.pixels.assign(static_cast<size_t>(width) * height * 4, value);
+        return image;
+    }
+}
+
+TEST(ImageLoaderTest, DownscaleAveragesBlocksPerAxis) {
+    ImageData image = solidImage(4, 2, 0);
+    // Left half white, right half black
+    for (uint32_t y = 0; y < 2; ++y) {
+        for (uint32_t x = 0; x < 2; ++x) {
+            for (int c = 0; c < 4; ++c) {
+                image.pixels[(y * 4 + x) * 4 + c] = 255;
+            }
+        }
+    }
+
+    ImageData scaled = ImageLoader::downscale(image, 2, 100); // Height is never enlarged
+    ASSERT_EQ(scaled.width, 2u);
+    ASSERT_EQ(scaled.height, 2u);
+    EXPECT_EQ(scaled.pixels[0], 255);
+    EXPECT_EQ(scaled.pixels[4], 0);
+
+    ImageData single = ImageLoader::downscale(image, 1, 1);
+    ASSERT_EQ(single.pixels.size(), 4u);
+    EXPECT_EQ(single.pixels[0], 128);
+}
+
+TEST(ImageLoaderTest, MipChainHalvesDownToOnePixel) {
+    ImageData image = solidImage(8, 2, 200);
+    uint32_t levels = 0;
+    std::vector<uint8_t> chain = ImageLoader::buildMipChain(image, levels);
+
+    // 8x2, 4x1, 2x1, 1x1
+    EXPECT_EQ(levels, 4u);
+    EXPECT_EQ(chain.size(), (16u + 4u + 2u + 1u) * 4u);
+    EXPECT_EQ(chain.back(), 200);
+}
+
+TEST(ImageLoaderTest, CacheRejectsUnsafePaths) {
+    EXPECT_TRUE(ImageCache::isPathSafe("wallpapers/sky-1.png"));
+    EXPECT_FALSE(ImageCache::isPathSafe("/etc/passwd"));
+    EXPECT_FALSE(ImageCache::isPathSafe("images/../secret.png"));
+    EXPECT_FALSE(ImageCache::isPathSafe("./image.png"));
+    EXPECT_FALSE(ImageCache::isPathSafe("image name.png"));
+}
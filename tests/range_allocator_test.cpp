@@ -0,0 +1,44 @@
+#include <gtest/gtest.h>
+#include "renderer/range_allocator.hpp"
+
+TEST(RangeAllocatorTest, AlignsAndFillsFirstFit) {
+    RangeAllocator ranges(1024);
+
+    uint64_t a = 0, b = 0, c = 0;
+    ASSERT_TRUE(ranges.allocate(10, 1, a));
+    ASSERT_TRUE(ranges.allocate(100, 256, b));
+    EXPECT_EQ(a, 0u);
+    EXPECT_EQ(b, 256u);
+
+    // The gap left by alignment is used by a later small allocation
+    ASSERT_TRUE(ranges.allocate(16, 16, c));
+    EXPECT_EQ(c, 16u);
+    EXPECT_EQ(ranges.getUsed(), 126u);
+
+    uint64_t d = 0;
+    EXPECT_FALSE(ranges.allocate(2048, 1, d));
+}
+
+TEST(RangeAllocatorTest, FreeMergesNeighbours) {
+    RangeAllocator ranges(300);
+
+    uint64_t a = 0, b = 0, c = 0;
+    ASSERT_TRUE(ranges.allocate(100, 1, a));
+    ASSERT_TRUE(ranges.allocate(100, 1, b));
+    ASSERT_TRUE(ranges.allocate(100, 1, c));
+    EXPECT_EQ(ranges.getFreeRangeCount(), 0u);
+
+    ranges.free(a, 100);
+    ranges.free(c, 100);
+    EXPECT_EQ(ranges.getFreeRangeCount(), 2u);
+    EXPECT_EQ(ranges.getLargestFree(), 100u);
+
+    uint64_t big = 0;
+    EXPECT_FALSE(ranges.allocate(200, 1, big));
+
+    ranges.free(b, 100);
+    EXPECT_EQ(ranges.getFreeRangeCount(), 1u);
+    EXPECT_TRUE(ranges.empty());
+    ASSERT_TRUE(ranges.allocate(300, 1, big));
+    EXPECT_EQ(big, 0u);
+}
@@ -0,0 +1,38 @@
+#include <gtest/gtest.h>
+#include "renderer/rolling_stats.hpp"
+
+TEST(RollingStatsTest, EmptyReportsZero) {
+    RollingStats stats(8);
+    EXPECT_TRUE(stats.empty());
+    EXPECT_EQ(stats.getMin(), 0.0);
+    EXPECT_EQ(stats.getAverage(), 0.0);
+    EXPECT_EQ(stats.getP99(), 0.0);
+}
+
+TEST(RollingStatsTest, SummarizesSamples) {
+    RollingStats stats(100);
+    for (int i = 100; i >= 1; --i) {
+        stats.add(i);
+    }
+    EXPECT_EQ(stats.getCount(), 100u);
+    EXPECT_EQ(stats.getLast(), 1.0);
+    EXPECT_EQ(stats.getMin(), 1.0);
+    EXPECT_DOUBLE_EQ(stats.getAverage(), 50.5);
+    EXPECT_EQ(stats.getPercentile(0.5), 50.0);
+    EXPECT_EQ(stats.getP99(), 99.0);
+    EXPECT_EQ(stats.getPercentile(1.0), 100.0);
+}
+
+TEST(RollingStatsTest, ForgetsSamplesOutsideTheWindow) {
+    RollingStats stats(4);
+    stats.add(100.0); // A one-off spike
+    for (int i = 0; i < 4; ++i) {
+        stats.add(2.0);
+    }
+    EXPECT_EQ(stats.getCount(), 4u);
+    EXPECT_EQ(stats.getP99(), 2.0);
+    EXPECT_DOUBLE_EQ(stats.getAverage(), 2.0);
+
+    stats.clear();
+    EXPECT_TRUE(stats.empty());
+}
@@ -24,3 +24,24 @@ TEST(SettingsTest, InvalidIntReturnsDefault) {
     // We expect a warning to be printed to stderr, but the test should pass.
     ASSERT_EQ(s.getInt("test.invalid.int", 42), 42);
 }
+
+TEST(SettingsTest, FontFallbacksAreSplitAndTrimmed) {
+    Settings s;
+    s.setString("font.fallbacks", " fonts/a.ttf, ,fonts/b.otf ,");
+    std::vector<std::string> fallbacks = s.getFontFallbacks();
+    ASSERT_EQ(fallbacks.size(), 2u);
+    EXPECT_EQ(fallbacks[0], "fonts/a.ttf");
+    EXPECT_EQ(fallbacks[1], "fonts/b.otf");
+
+    s.setString("font.fallbacks", "");
+    EXPECT_TRUE(s.getFontFallbacks().empty());
+}
+
+TEST(SettingsTest, FramesInFlightIsClamped) {
+    Settings s;
+    EXPECT_EQ(s.getFramesInFlight(), 2u);
+    s.setInt("render.frames_in_flight", 0);
+    EXPECT_EQ(s.getFramesInFlight(), 1u);
+    s.setInt("render.frames_in_flight", 8);
+    EXPECT_EQ(s.getFramesInFlight(), 3u);
+}
@@ -0,0 +1,53 @@
+#include <gtest/gtest.h>
+#include "renderer/text_shaper.hpp"
+
+namespace {
+    std::vector<ShapedGlyph> makeGlyphs(uint32_t glyphIndex) {
+        return {{NO_CODEPOINT, 0, glyphIndex, 0, 0.0f, 0.0f}};
+    }
+}
+
+TEST(TextShaperTest, CombiningMarks) {
+    EXPECT_FALSE(isCombiningMark(U'a'));
+    EXPECT_FALSE(isCombiningMark(U'\u0F40'));  // Tibetan letter KA
+    EXPECT_TRUE(isCombiningMark(U'\u0301'));  // Combining acute accent
+    EXPECT_TRUE(isCombiningMark(U'\u0F72'));  // Tibetan vowel sign I
+    EXPECT_TRUE(isCombiningMark(U'\u0F90'));  // Tibetan subjoined KA
+    EXPECT_TRUE(isCombiningMark(U'\uFE0F'));  // Variation selector 16
+    EXPECT_FALSE(isCombiningMark(U'\U0001F600'));
+}
+
+TEST(ShapedRunCacheTest, HitsOnlyOnSameTextAndStyle) {
+    ShapedRunCache cache;
+    std::u32string text = U"=> hello";
+    cache.insert(text.data(), text.size(), 0, makeGlyphs(7));
+
+    const auto* hit = cache.find(text.data(), text.size(), 0);
+    ASSERT_NE(hit, nullptr);
+    EXPECT_EQ((*hit)[0].glyphIndex, 7u);
+
+    EXPECT_EQ(cache.find(text.data(), text.size(), 1), nullptr);
+    EXPECT_EQ(cache.find(text.data(), text.size() - 1, 0), nullptr);
+    std::u32string other = U"=> hellO";
+    EXPECT_EQ(cache.find(other.data(), other.size(), 0), nullptr);
+    EXPECT_EQ(cache.getHits(), 1u);
+    EXPECT_EQ(cache.getMisses(), 3u);
+}
+
+TEST(ShapedRunCacheTest, EvictsLeastRecentlyUsed) {
+    ShapedRunCache cache(2);
+    std::u32string a = U"a", b = U"b", c = U"c";
+    cache.insert(a.data(), 1, 0, makeGlyphs(1));
+    cache.insert(b.data(), 1, 0, makeGlyphs(2));
+    ASSERT_NE(cache.find(a.data(), 1, 0), nullptr); // "b" is now the oldest
+    cache.insert(c.data(), 1, 0, makeGlyphs(3));
+
+    EXPECT_EQ(cache.size(), 2u);
+    EXPECT_NE(cache.find(a.data(), 1, 0), nullptr);
+    EXPECT_EQ(cache.find(b.data(), 1, 0), nullptr);
+    EXPECT_NE(cache.find(c.data(), 1, 0), nullptr);
+
+    cache.clear();
+    EXPECT_EQ(cache.size(), 0u);
+    EXPECT_EQ(cache.find(a.data(), 1, 0), nullptr);
+}